@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADAPTIVE_SAMPLER_H__
+#define __ADAPTIVE_SAMPLER_H__
+
+/* Intervals in seconds, the sampler speeds up to min_interval on activity and slows down to max_interval */
+typedef struct {
+	double min_interval;
+	double max_interval;
+	double backoff; /* Factor applied to the interval after each quiet sample, above 1 */
+} adaptive_sampler_config_s;
+
+typedef struct __adaptive_sampler_s adaptive_sampler;
+
+/* Takes one sample, returns 1 if it saw activity, 0 if not, a negative value on error */
+typedef int (*adaptive_sampler_cb)(void *data);
+
+/**
+ * @brief Starts sampling at the fastest rate.
+ * @param[in] config The rates, copied
+ * @param[in] cb Called for every sample
+ * @param[in] data The user data passed to the callback
+ * @return The sampler, or NULL on error
+ */
+adaptive_sampler *adaptive_sampler_start(const adaptive_sampler_config_s *config, adaptive_sampler_cb cb, void *data);
+
+/**
+ * @brief Stops sampling.
+ * @param[in] sampler The sampler, invalid after this call
+ */
+void adaptive_sampler_stop(adaptive_sampler *sampler);
+
+/**
+ * @brief Reports activity seen outside a sample, like an edge or an asynchronous result.
+ * @param[in] sampler The sampler
+ * @see The next sample comes after the fastest interval at the latest.
+ */
+void adaptive_sampler_poke(adaptive_sampler *sampler);
+
+/**
+ * @brief Moves the fastest rate, for a source that cannot deliver new values that often.
+ * @param[in] sampler The sampler
+ * @param[in] min_interval The new fastest interval, the slowest one is raised to it if needed
+ * @return 0 on success, otherwise a negative error value
+ */
+int adaptive_sampler_set_min_interval(adaptive_sampler *sampler, double min_interval);
+
+/**
+ * @brief Gets the interval the sampler currently runs at.
+ * @param[in] sampler The sampler
+ * @return The interval in seconds, or a negative value on error
+ */
+double adaptive_sampler_get_interval(const adaptive_sampler *sampler);
+
+#endif /* __ADAPTIVE_SAMPLER_H__ */
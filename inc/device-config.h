@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEVICE_CONFIG_H__
+#define __DEVICE_CONFIG_H__
+
+/*
+ * The "ledsw" object of the device definition, every key is optional:
+ *
+ *   "ledsw": {
+ *     "i2c_bus": 1,
+ *     "pins": { "sw": 20, "led1": 5, "led2": 26 },
+ *     "intervals": { "sensor": 1.0, "illuminance": 1.0, "sw_min": 0.02, "illuminance_min": 0.25,
+ *                    "notify_illuminance": 1.0, "notify_door": 0.1 },
+ *     "backoff": 2.0,
+ *     "uris": { "illuminance": "/capability/illuminanceMeasurement/main/0", "door": "/capability/doorControl/main/0" },
+ *     "lamp": { "chip": 0, "channel": 0, "period_ns": 1000000, "target_lux": 300 }
+ *   }
+ *
+ * Pins are below PIN_MAX and all differ, intervals are above zero except the illuminance one.
+ * A definition breaking any of this is rejected as a whole, the defaults are used instead.
+ */
+
+typedef enum {
+	DEVICE_CONFIG_PIN_SW = 0,
+	DEVICE_CONFIG_PIN_LED_1,
+	DEVICE_CONFIG_PIN_LED_2,
+	DEVICE_CONFIG_PIN_MAX,
+} device_config_pin_e;
+
+/* In seconds */
+typedef enum {
+	DEVICE_CONFIG_INTERVAL_SENSOR = 0,
+	DEVICE_CONFIG_INTERVAL_ILLUMINANCE, /* Zero leaves the illuminance sensor alone */
+	DEVICE_CONFIG_INTERVAL_SW_MIN,
+	DEVICE_CONFIG_INTERVAL_ILLUMINANCE_MIN,
+	DEVICE_CONFIG_INTERVAL_NOTIFY_ILLUMINANCE,
+	DEVICE_CONFIG_INTERVAL_NOTIFY_DOOR,
+	DEVICE_CONFIG_INTERVAL_MAX,
+} device_config_interval_e;
+
+/* The dimmable LED, a target_lux of zero leaves it off */
+typedef enum {
+	DEVICE_CONFIG_LAMP_CHIP = 0,
+	DEVICE_CONFIG_LAMP_CHANNEL,
+	DEVICE_CONFIG_LAMP_PERIOD_NS,
+	DEVICE_CONFIG_LAMP_TARGET_LUX,
+	DEVICE_CONFIG_LAMP_MAX,
+} device_config_lamp_e;
+
+typedef enum {
+	DEVICE_CONFIG_URI_ILLUMINANCE = 0,
+	DEVICE_CONFIG_URI_DOOR,
+	DEVICE_CONFIG_URI_MAX,
+} device_config_uri_e;
+
+/* The values used for the keys the definition leaves out */
+typedef struct {
+	int pins[DEVICE_CONFIG_PIN_MAX];
+	int i2c_bus;
+	double intervals[DEVICE_CONFIG_INTERVAL_MAX];
+	double backoff;
+	const char *uris[DEVICE_CONFIG_URI_MAX];
+	int lamp[DEVICE_CONFIG_LAMP_MAX];
+} device_config_s;
+
+/**
+ * @brief Loads the configuration, mapping the cached image if it is still up to date.
+ * @param[in] source The device definition, compiled into a new image only when it or the defaults changed
+ * @param[in] cache The image file, replaced as a whole
+ * @param[in] defaults The values for the missing keys, copied, its strings must stay valid
+ * @return 0 on success, otherwise a negative error value
+ * @see The defaults alone are used if neither the image nor the definition can be read.
+ */
+extern int device_config_load(const char *source, const char *cache, const device_config_s *defaults);
+
+/**
+ * @brief Releases the image, the strings from device_config_get_uri() are invalid afterwards.
+ */
+extern void device_config_unload(void);
+
+extern int device_config_get_pin(device_config_pin_e pin);
+extern int device_config_get_i2c_bus(void);
+extern double device_config_get_interval(device_config_interval_e interval);
+extern double device_config_get_backoff(void);
+extern const char *device_config_get_uri(device_config_uri_e uri);
+extern int device_config_get_lamp(device_config_lamp_e lamp);
+
+#endif /* __DEVICE_CONFIG_H__ */
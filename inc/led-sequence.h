@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LED_SEQUENCE_H__
+#define __LED_SEQUENCE_H__
+
+/* A pin_num below zero makes the step a plain delay */
+typedef struct {
+	int pin_num;
+	int value;
+	unsigned int duration_ms;
+} led_step_s;
+
+typedef struct __led_sequence_s led_sequence;
+
+/* @a seq is already released when this is called and only identifies the sequence */
+typedef void (*led_sequence_done_cb)(led_sequence *seq, void *data);
+
+/**
+ * @brief Plays a list of LED steps from the main loop without blocking it.
+ * @param[in] steps The steps, which must stay valid while the sequence plays
+ * @param[in] count The number of steps
+ * @param[in] repeat How many times to play the steps, 0 to repeat until stopped
+ * @param[in] cb Called once the last repetition has finished, may be NULL
+ * @param[in] data The user data passed to the callback
+ * @return The sequence handle, or NULL on error or if the steps took no time and are already done
+ * @see A sequence that is still driving one of the pins used by @a steps is stopped first.
+ */
+led_sequence *led_sequence_play(const led_step_s *steps, unsigned int count, unsigned int repeat, led_sequence_done_cb cb, void *data);
+
+/**
+ * @brief Stops a sequence, leaving its pins at the last written level.
+ * @param[in] seq The sequence handle, invalid after this call
+ */
+void led_sequence_stop(led_sequence *seq);
+
+/**
+ * @brief Stops every playing sequence.
+ */
+void led_sequence_stop_all(void);
+
+#endif /* __LED_SEQUENCE_H__ */
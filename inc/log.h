@@ -26,29 +26,53 @@
 #endif
 #define LOG_TAG "TT"
 
+/* Numeric copies of the dlog priorities, so they can be compared by the preprocessor */
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_INFO 4
+#define LOG_LEVEL_WARN 5
+#define LOG_LEVEL_ERROR 6
+
+/* Levels below this one are compiled out, their arguments are still type checked but never evaluated */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/* Levels below this one are skipped at run time for the price of one compare */
+extern int log_runtime_level;
+
+extern void log_write(log_priority prio, const char *tag, const char *func, int line, const char *fmt, ...) __attribute__((format(printf, 5, 6)));
+extern void log_set_level(int level);
+extern int log_start(void);
+extern void log_stop(void);
+
+#define __LOG(level, tag, fmt, arg...) do { \
+	if (LOG_COMPILE_LEVEL <= (level) && (level) >= log_runtime_level) \
+		log_write((log_priority) (level), tag, __func__, __LINE__, fmt, ##arg); \
+} while (0)
+
 #if !defined(_D)
-#define _D(fmt, arg...) dlog_print(DLOG_DEBUG, LOG_TAG, "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define _D(fmt, arg...) __LOG(LOG_LEVEL_DEBUG, LOG_TAG, fmt, ##arg)
 #endif
 
 #if !defined(_D2)
-#define _D2(fmt, arg...) dlog_print(DLOG_DEBUG, "SW", "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define _D2(fmt, arg...) __LOG(LOG_LEVEL_DEBUG, "SW", fmt, ##arg)
 #endif
 
 
 #if !defined(DBG)
-#define DBG(fmt, arg...) dlog_print(DLOG_DEBUG, LOG_TAG, "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define DBG(fmt, arg...) __LOG(LOG_LEVEL_DEBUG, LOG_TAG, fmt, ##arg)
 #endif
 
 #if !defined(_I)
-#define _I(fmt, arg...) dlog_print(DLOG_INFO, LOG_TAG, "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define _I(fmt, arg...) __LOG(LOG_LEVEL_INFO, LOG_TAG, fmt, ##arg)
 #endif
 
 #if !defined(_W)
-#define _W(fmt, arg...) dlog_print(DLOG_WARN, LOG_TAG, "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define _W(fmt, arg...) __LOG(LOG_LEVEL_WARN, LOG_TAG, fmt, ##arg)
 #endif
 
 #if !defined(_E)
-#define _E(fmt, arg...) dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] " fmt "\n", __func__, __LINE__, ##arg)
+#define _E(fmt, arg...) __LOG(LOG_LEVEL_ERROR, LOG_TAG, fmt, ##arg)
 #endif
 
 #define retvm_if(expr, val, fmt, arg...) do { \
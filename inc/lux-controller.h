@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LUX_CONTROLLER_H__
+#define __LUX_CONTROLLER_H__
+
+/* Integer math only for the soft-float build, lux in 1/16 steps and duty cycles in 1/65536 */
+#define LUX_CONTROLLER_DUTY_MAX 65536
+
+typedef struct {
+	unsigned int target_lux_q4;
+	unsigned int kp_q8; /* Duty change per 1/16 lux the error moved since the last reading, in 1/256 */
+	unsigned int ki_q8; /* Duty change per 1/16 lux of error held for a second, in 1/256 */
+	unsigned int threshold; /* Smallest duty change worth a write */
+} lux_controller_config_s;
+
+typedef struct __lux_controller_s lux_controller;
+
+/**
+ * @brief Creates a PI controller driving a light toward a target illuminance, starting switched off.
+ * @param[in] config The target and the gains, copied
+ * @return The controller, or NULL on error
+ */
+lux_controller *lux_controller_new(const lux_controller_config_s *config);
+
+/**
+ * @brief Frees a controller.
+ * @param[in] ctl The controller, invalid after this call
+ */
+void lux_controller_free(lux_controller *ctl);
+
+/**
+ * @brief Moves the duty cycle from one reading.
+ * @param[in] ctl The controller
+ * @param[in] lux_q4 The measured illuminance in 1/16 lux
+ * @param[in] time_ms When the reading was taken in milliseconds, any clock that may wrap
+ * @param[out] duty The duty cycle to write, only set when 1 is returned
+ * @return 1 if the duty cycle moved past the threshold since the last one handed out, 0 if not, a negative value on error
+ * @see The first reading only sets the starting point, fully on and fully off are handed out even when closer than the threshold.
+ */
+int lux_controller_update(lux_controller *ctl, unsigned int lux_q4, unsigned int time_ms, unsigned int *duty);
+
+#endif /* __LUX_CONTROLLER_H__ */
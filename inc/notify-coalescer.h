@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NOTIFY_COALESCER_H__
+#define __NOTIFY_COALESCER_H__
+
+/* Returned by the send callback when nobody can be notified yet, the notification is dropped */
+#define NOTIFY_COALESCER_SKIPPED 1
+
+/* Sends the notification of a URI, returns 0 on success, NOTIFY_COALESCER_SKIPPED or a negative error value */
+typedef int (*notify_coalescer_send_cb)(const char *uri, void *data);
+
+typedef struct {
+	unsigned int marked;
+	unsigned int sent;
+	unsigned int suppressed; /* Marks folded into a notification that was already pending */
+	unsigned int skipped; /* Dropped by the send callback, they do not hold back the next one */
+	unsigned int failed;
+} notify_coalescer_stats_s;
+
+/**
+ * @brief Sets up the coalescer.
+ * @param[in] cb Sends one notification
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, otherwise a negative error value
+ */
+int notify_coalescer_init(notify_coalescer_send_cb cb, void *data);
+
+/**
+ * @brief Drops the pending notifications and every URI.
+ */
+void notify_coalescer_fini(void);
+
+/**
+ * @brief Registers a URI.
+ * @param[in] uri The resource URI, copied
+ * @param[in] min_interval The shortest time in seconds between two notifications of the URI
+ * @return 0 on success, otherwise a negative error value
+ */
+int notify_coalescer_add_uri(const char *uri, double min_interval);
+
+/**
+ * @brief Marks a URI dirty, it is notified once the loop iteration is over.
+ * @param[in] uri The resource URI
+ * @return 0 on success, otherwise a negative error value
+ * @see A URI notified less than its minimum interval ago stays dirty until the interval is over.
+ */
+int notify_coalescer_mark(const char *uri);
+
+/**
+ * @brief Gets the counters of a URI, or of all of them.
+ * @param[in] uri The resource URI, NULL for the sum over every URI
+ * @param[out] stats The counters
+ * @return 0 on success, otherwise a negative error value
+ */
+int notify_coalescer_get_stats(const char *uri, notify_coalescer_stats_s *stats);
+
+#endif /* __NOTIFY_COALESCER_H__ */
@@ -23,6 +23,12 @@
 
 #include "resource_internal.h"
 #include "resource/resource_sw_sensor.h"
+#include "resource/resource_sw_gesture.h"
 #include "resource/resource_led.h"
+#include "resource/resource_pwm_led.h"
+#include "resource/resource_illuminance_sensor.h"
+#include "resource/resource_io_worker.h"
+#include "resource/resource_metrics.h"
+#include "resource/resource_prewarm.h"
 
 #endif /* __POSITION_FINDER_RESOURCE_H__ */
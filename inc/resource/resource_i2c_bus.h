@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_I2C_BUS_H__
+#define __POSITION_FINDER_RESOURCE_I2C_BUS_H__
+
+typedef enum {
+	RESOURCE_I2C_OP_WRITE = 0,
+	RESOURCE_I2C_OP_READ,
+	RESOURCE_I2C_OP_DELAY, /* Leaves the bus to other devices while this one converts */
+} resource_i2c_op_e;
+
+typedef struct {
+	resource_i2c_op_e type;
+	unsigned char *buf; /* Bytes to write or room for the bytes read, kept by the caller until done */
+	unsigned int len;
+	double delay; /* Seconds, for RESOURCE_I2C_OP_DELAY */
+} resource_i2c_op_s;
+
+typedef struct _resource_i2c_device_s resource_i2c_device;
+
+typedef void (*resource_i2c_done_cb)(int result, void *data);
+
+/**
+ * @brief Gets the shared handle of a slave device, opening it on first use.
+ * @param[in] bus The i2c bus number
+ * @param[in] address The slave address
+ * @return The device on success, otherwise NULL
+ * @see Every successful call must be paired with resource_i2c_bus_put().
+ */
+extern resource_i2c_device *resource_i2c_bus_get(int bus, int address);
+
+/**
+ * @brief Drops a reference to a device, closing it and its queue with the last one.
+ * @param[in] device The device
+ */
+extern void resource_i2c_bus_put(resource_i2c_device *device);
+
+/**
+ * @brief Counts the reads and writes of a device in the I/O metrics of a resource.
+ * @param[in] device The device
+ * @param[in] id The metrics id, see resource_metrics.h
+ */
+extern void resource_i2c_bus_set_metrics(resource_i2c_device *device, int id);
+
+/**
+ * @brief Queues a transaction, run from the main loop when the device is ready.
+ * @param[in] device The device
+ * @param[in] ops The operations, copied
+ * @param[in] count The number of operations
+ * @param[in] cb Called with 0 or a negative error once the transaction ends, may be NULL
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, otherwise a negative error value
+ * @see Devices on a bus take turns one transaction at a time, ready transactions run back to back.
+ */
+extern int resource_i2c_bus_submit(resource_i2c_device *device, const resource_i2c_op_s *ops, unsigned int count, resource_i2c_done_cb cb, void *data);
+
+/**
+ * @brief Runs a transaction without delays right away.
+ * @param[in] device The device
+ * @param[in] ops The operations
+ * @param[in] count The number of operations
+ * @return 0 on success, otherwise a negative error value
+ * @see Fails if the device has queued work, so it never cuts into a transaction.
+ */
+extern int resource_i2c_bus_run(resource_i2c_device *device, const resource_i2c_op_s *ops, unsigned int count);
+
+/**
+ * @brief Drops every queued transaction of a device without calling the callbacks.
+ * @param[in] device The device
+ */
+extern void resource_i2c_bus_cancel(resource_i2c_device *device);
+
+#endif /* __POSITION_FINDER_RESOURCE_I2C_BUS_H__ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Contact: Jin Yoon <jinny.yoon@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_ILLUMINANCE_SENSOR_H__
+#define __POSITION_FINDER_RESOURCE_ILLUMINANCE_SENSOR_H__
+
+typedef enum {
+	RESOURCE_ILLUMINANCE_MODE_CONTINUOUS = 0, /* Keeps converting, a result is always ready */
+	RESOURCE_ILLUMINANCE_MODE_ONE_TIME, /* Converts once and powers down until the next request */
+} resource_illuminance_mode_e;
+
+/* Each range trades conversion time against resolution and ceiling */
+typedef enum {
+	RESOURCE_ILLUMINANCE_RANGE_AUTO = 0, /* Follow the light level, only valid as a request */
+	RESOURCE_ILLUMINANCE_RANGE_DARK, /* 0.14 lx steps up to ~7400 lx, ~440 ms */
+	RESOURCE_ILLUMINANCE_RANGE_NORMAL, /* 1 lx steps up to ~54600 lx, ~120 ms */
+	RESOURCE_ILLUMINANCE_RANGE_BRIGHT, /* 8.9 lx steps up to ~121000 lx, ~7 ms */
+} resource_illuminance_range_e;
+
+typedef struct {
+	double lux;
+	unsigned int lux_q4; /* The same in 1/16 lux, computed without floating point */
+	double timestamp; /* ecore_time_get() when the result was read */
+	resource_illuminance_range_e range; /* The range the result was measured in */
+} resource_illuminance_sample_s;
+
+/* Returned while an asynchronous read is pending, the caller simply tries again later */
+#define RESOURCE_ILLUMINANCE_BUSY (-2)
+
+typedef void (*resource_illuminance_cb)(const resource_illuminance_sample_s *sample, void *data);
+
+/**
+ * @brief Reads the value of i2c connected illuminance sensor(GY30).
+ * @param[in] i2c_bus The i2c bus number that the slave device is connected
+ * @param[out] out_value The value read by the illuminance sensor
+ * @return 0 on success, RESOURCE_ILLUMINANCE_BUSY while an asynchronous read is pending, otherwise a negative error value
+ * @see Also RESOURCE_ILLUMINANCE_BUSY until a conversion in the current range had time to finish, after opening or a range change.
+ */
+extern int resource_read_illuminance_sensor(int i2c_bus, uint32_t *out_value);
+
+/**
+ * @brief Starts a conversion and delivers the result from the main loop once it is due.
+ * @param[in] i2c_bus The i2c bus number that the slave device is connected
+ * @param[in] mode Continuous, or one time to let the sensor power down between samples
+ * @param[in] cb The callback receiving the sample, or NULL on a read error
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, RESOURCE_ILLUMINANCE_BUSY while the previous request is pending, otherwise a negative error value
+ * @see Only one request can be pending at a time.
+ */
+extern int resource_read_illuminance_sensor_async(int i2c_bus, resource_illuminance_mode_e mode, resource_illuminance_cb cb, void *data);
+
+/**
+ * @brief Fixes the measurement range, or lets it follow the readings.
+ * @param[in] range A fixed range, or RESOURCE_ILLUMINANCE_RANGE_AUTO
+ * @return 0 on success, otherwise a negative error value
+ * @see In auto mode the range moves up near saturation and down when the reading fits a darker range twice over.
+ */
+extern int resource_set_illuminance_sensor_range(resource_illuminance_range_e range);
+
+/**
+ * @brief Gets the range the next conversion will use.
+ * @return The active range, never RESOURCE_ILLUMINANCE_RANGE_AUTO
+ */
+extern resource_illuminance_range_e resource_get_illuminance_sensor_range(void);
+
+/**
+ * @brief Gets how long a conversion can take in the range the next one will use.
+ * @return The worst case conversion time in seconds, reading faster only gets the same result again
+ */
+extern double resource_get_illuminance_sensor_conversion_time(void);
+
+/**
+ * @brief Drops the pending asynchronous request, its callback is not called.
+ */
+extern void resource_cancel_illuminance_sensor_async(void);
+
+/**
+ * @brief Opens the illuminance sensor ahead of its first read.
+ * @param[in] i2c_bus The i2c bus number that the slave device is connected
+ * @return 0 on success, otherwise a negative error value
+ * @see Goes through the i2c bus manager, which belongs to one thread at a time.
+ */
+extern int resource_open_illuminance_sensor(int i2c_bus);
+
+/**
+ * @brief Releases the i2c handle of the illuminance sensor.
+ */
+extern void resource_close_illuminance_sensor(void);
+
+#endif /* __POSITION_FINDER_RESOURCE_ILLUMINANCE_SENSOR_H__ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_IO_WORKER_H__
+#define __POSITION_FINDER_RESOURCE_IO_WORKER_H__
+
+/* Runs on the worker thread, makes the blocking peripheral calls */
+typedef int (*resource_io_work_cb)(void *data);
+
+/* Runs on the main loop with the value returned by the work */
+typedef void (*resource_io_done_cb)(int result, void *data);
+
+typedef struct {
+	unsigned int submitted;
+	unsigned int completed;
+	unsigned int depth; /* Submitted and not completed yet */
+	unsigned int max_depth;
+	unsigned int last_service_usec; /* Time spent in the work itself */
+	unsigned int max_service_usec;
+	unsigned long long total_service_usec;
+	unsigned int max_wait_usec; /* Time queued before the worker picked the work up */
+} resource_io_stats_s;
+
+/**
+ * @brief Starts the peripheral I/O worker thread.
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_io_worker_start(void);
+
+/**
+ * @brief Stops the worker once it ran everything queued, and runs the remaining completions.
+ * @see Call it before closing the resources the queued work uses.
+ */
+extern void resource_io_worker_stop(void);
+
+/**
+ * @brief Checks whether the worker thread is running.
+ * @return 1 if it is, otherwise 0
+ */
+extern int resource_io_worker_running(void);
+
+/**
+ * @brief Queues work for the worker, from the main loop only.
+ * @param[in] work The work, run in submission order
+ * @param[in] done The completion, may be NULL
+ * @param[in] data The user data passed to both
+ * @return 0 on success, otherwise a negative error value if the worker is not running or its queue is full
+ * @see Without a worker callers run the work themselves. With a full queue they must wait for room, not run work beside the worker on a handle it may be using.
+ */
+extern int resource_io_submit(resource_io_work_cb work, resource_io_done_cb done, void *data);
+
+/**
+ * @brief Gets the queue depth and service time counters.
+ * @param[out] stats The counters
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_io_get_stats(resource_io_stats_s *stats);
+
+#endif /* __POSITION_FINDER_RESOURCE_IO_WORKER_H__ */
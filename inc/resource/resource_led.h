@@ -19,8 +19,69 @@
 #ifndef __POSITION_FINDER_RESOURCE_LED_H__
 #define __POSITION_FINDER_RESOURCE_LED_H__
 
+#include <stdint.h>
+
+typedef struct {
+	unsigned int batches;
+	unsigned int last_latency_usec;
+	unsigned int max_latency_usec;
+	unsigned long long total_latency_usec;
+} resource_led_batch_stats_s;
+
+/**
+ * @brief Drives an LED pin, skipping the gpio write if the pin already has that level.
+ * @param[in] pin_num The number of the gpio pin connected to the LED
+ * @param[in] write_value The level to write (zero or non-zero)
+ * @return 0 on success, otherwise a negative error value
+ * @see With the I/O worker running the write is only queued, a failure shows up in the log and forces the next write.
+ */
 extern int resource_write_led(int pin_num, int write_value);
 
+/**
+ * @brief Drives an LED pin, always issuing the gpio write.
+ * @param[in] pin_num The number of the gpio pin connected to the LED
+ * @param[in] write_value The level to write (zero or non-zero)
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_write_led_force(int pin_num, int write_value);
+
+/**
+ * @brief Gets how many writes reached the gpio and how many the shadow level skipped.
+ * @param[in] pin_num The number of the gpio pin connected to the LED
+ * @param[out] issued The number of gpio writes issued, may be NULL
+ * @param[out] saved The number of redundant writes skipped, may be NULL
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_get_led_write_stats(int pin_num, unsigned int *issued, unsigned int *saved);
+
+/**
+ * @brief Drives several LED pins as one batch.
+ * @param[in] pin_mask The gpio pins to drive, bit N standing for pin N
+ * @param[in] values The levels to write, bit N being the level of pin N
+ * @return 0 on success, otherwise a negative error value
+ * @see Pins that already have the requested level are skipped like in resource_write_led().
+ */
+extern int resource_write_leds(uint64_t pin_mask, uint64_t values);
+
+/**
+ * @brief Gets how many batches were written and how long the writes took.
+ * @param[out] stats The batch counters and latencies
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_get_led_batch_stats(resource_led_batch_stats_s *stats);
+
+/**
+ * @brief Opens the gpio pin connected to the LED as a low output ahead of its first write.
+ * @param[in] pin_num The number of the gpio pin connected to the LED
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_open_led(int pin_num);
+
+/**
+ * @brief Does the LED write still waiting for room in the I/O queue and releases the gpio handle.
+ * @param[in] pin_num The number of the gpio pin connected to the LED
+ * @see Refused while the I/O worker runs, call resource_io_worker_stop() first.
+ */
 extern void resource_close_led(int pin_num);
 
 #endif /* __POSITION_FINDER_RESOURCE_LED_H__ */
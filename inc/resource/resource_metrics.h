@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_METRICS_H__
+#define __POSITION_FINDER_RESOURCE_METRICS_H__
+
+#include "resource_internal.h"
+
+/* Kept for every id of the resource table */
+#define RESOURCE_METRICS_MAX RESOURCE_ID_MAX
+
+/* Bucket 0 counts calls under 1 usec, bucket n the ones under 2^n usec, the last one everything slower */
+#define RESOURCE_METRICS_BUCKETS 16
+
+typedef enum {
+	RESOURCE_METRICS_OPEN = 0,
+	RESOURCE_METRICS_READ,
+	RESOURCE_METRICS_WRITE,
+	RESOURCE_METRICS_OP_MAX,
+} resource_metrics_op_e;
+
+typedef struct {
+	unsigned int opens; /* Open attempts */
+	unsigned int reopens; /* Open attempts after the first one */
+	unsigned int reads;
+	unsigned int writes;
+	unsigned int errors; /* Failed opens, reads and writes */
+	unsigned long long total_usec[RESOURCE_METRICS_OP_MAX];
+	unsigned int latency[RESOURCE_METRICS_OP_MAX][RESOURCE_METRICS_BUCKETS];
+} resource_metrics_s;
+
+/**
+ * @brief Gets the monotonic time to pass to resource_metrics_record() once the call is over.
+ * @return The time in microseconds
+ */
+extern unsigned long long resource_metrics_now(void);
+
+/**
+ * @brief Counts one peripheral call, from any thread without taking a lock.
+ * @param[in] id The resource id, the pin number for GPIO
+ * @param[in] op The kind of call
+ * @param[in] start The time from resource_metrics_now() taken before the call
+ * @param[in] failed Non zero if the call failed
+ */
+extern void resource_metrics_record(int id, resource_metrics_op_e op, unsigned long long start, int failed);
+
+/**
+ * @brief Gets a snapshot of the counters of a resource.
+ * @param[in] id The resource id, the pin number for GPIO
+ * @param[out] metrics The counters, each one read atomically but not all at the same instant
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_get_metrics(int id, resource_metrics_s *metrics);
+
+/* Reads a value kept outside the resource layer when a dump is written, a negative value is left out */
+typedef double (*resource_metrics_gauge_cb)(void *data);
+
+#define RESOURCE_METRICS_GAUGES_MAX 8
+
+/**
+ * @brief Adds a named value to the dumps, from the main loop.
+ * @param[in] name The JSON key, kept as is and not copied
+ * @param[in] cb Called on the main loop for every dump
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, otherwise a negative error value
+ * @see An existing name is replaced.
+ */
+extern int resource_metrics_add_gauge(const char *name, resource_metrics_gauge_cb cb, void *data);
+
+/**
+ * @brief Removes a named value from the dumps, before its user data goes away.
+ * @param[in] name The JSON key given to resource_metrics_add_gauge()
+ */
+extern void resource_metrics_remove_gauge(const char *name);
+
+/**
+ * @brief Writes the counters of every resource used so far as JSON.
+ * @param[in] path The file, replaced as a whole
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_metrics_dump(const char *path);
+
+/**
+ * @brief Dumps the counters periodically from the main loop.
+ * @param[in] path The file, copied
+ * @param[in] interval The time in seconds between two dumps
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_metrics_dump_start(const char *path, double interval);
+
+/**
+ * @brief Stops the periodic dumps after a last one.
+ */
+extern void resource_metrics_dump_stop(void);
+
+#endif /* __POSITION_FINDER_RESOURCE_METRICS_H__ */
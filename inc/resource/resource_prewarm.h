@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_PREWARM_H__
+#define __POSITION_FINDER_RESOURCE_PREWARM_H__
+
+#include "resource_internal.h"
+
+typedef struct {
+	const resource_driver_s *driver; /* Opens the resource with its open hook */
+	int id; /* The pin number, or the resource id of a bus device */
+	int bus; /* The bus number of a bus device */
+	int result; /* Filled in, 0 once the resource is open */
+	unsigned int open_usec; /* Filled in, the time the open took */
+} resource_prewarm_s;
+
+/**
+ * @brief Opens and configures resources before their first use, each pin on a thread of its own.
+ * @param[in,out] items The resources, no pin twice, their results and open times are filled in
+ * @param[in] count The number of resources
+ * @return The number of resources that failed to open, otherwise a negative error value
+ * @see Call it from the main loop before the I/O worker and the timers use the resources.
+ */
+extern int resource_prewarm(resource_prewarm_s *items, unsigned int count);
+
+#endif /* __POSITION_FINDER_RESOURCE_PREWARM_H__ */
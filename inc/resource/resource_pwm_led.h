@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_PWM_LED_H__
+#define __POSITION_FINDER_RESOURCE_PWM_LED_H__
+
+/* Duty cycles are in 1/65536 of the period, this one is fully on */
+#define RESOURCE_PWM_DUTY_MAX 65536
+
+/**
+ * @brief Opens the dimmable LED and starts it switched off.
+ * @param[in] chip The PWM chip
+ * @param[in] channel The PWM channel of the chip
+ * @param[in] period_ns The PWM period in nanoseconds
+ * @return 0 on success, otherwise a negative error value
+ * @see There is one dimmable LED, it gets the resource id RESOURCE_ID_PWM_LED.
+ */
+extern int resource_open_pwm_led(int chip, int channel, unsigned int period_ns);
+
+/**
+ * @brief Sets the brightness of the dimmable LED, the write goes through the I/O worker.
+ * @param[in] duty The duty cycle, from 0 to RESOURCE_PWM_DUTY_MAX
+ * @return 0 on success, otherwise a negative error value
+ * @see Writing the duty cycle already set costs nothing.
+ */
+extern int resource_write_pwm_led(unsigned int duty);
+
+/**
+ * @brief Switches the dimmable LED off and releases its PWM handle.
+ */
+extern void resource_close_pwm_led(void);
+
+#endif /* __POSITION_FINDER_RESOURCE_PWM_LED_H__ */
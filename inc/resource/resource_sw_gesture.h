@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __POSITION_FINDER_RESOURCE_SW_GESTURE_H__
+#define __POSITION_FINDER_RESOURCE_SW_GESTURE_H__
+
+typedef enum {
+	RESOURCE_SW_EVENT_PRESS = 0,
+	RESOURCE_SW_EVENT_RELEASE,
+	RESOURCE_SW_EVENT_LONG_PRESS,
+	RESOURCE_SW_EVENT_DOUBLE_CLICK,
+} resource_sw_event_e;
+
+typedef struct {
+	resource_sw_event_e type;
+	int pin_num;
+	double timestamp; /* ecore_time_get() of the edge that started the event */
+	double duration; /* How long the switch has been held, for release and long press */
+} resource_sw_event_s;
+
+typedef void (*resource_sw_event_cb)(const resource_sw_event_s *event, void *data);
+
+typedef struct {
+	unsigned int settle_ms; /* A level must stay put this long to count */
+	unsigned int long_press_ms; /* 0 disables long press */
+	unsigned int double_click_ms; /* 0 disables double click */
+	uint32_t active_level; /* The level read while the switch is pressed */
+} resource_sw_gesture_config_s;
+
+/**
+ * @brief Starts debouncing the raw levels of a switch pin.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @param[in] config The settle window and gesture timings, NULL for the defaults
+ * @param[in] cb The callback receiving the clean events
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, otherwise a negative error value
+ * @see The engine does not touch the gpio, raw levels come in through resource_sw_gesture_feed().
+ */
+extern int resource_sw_gesture_start(int pin_num, const resource_sw_gesture_config_s *config, resource_sw_event_cb cb, void *data);
+
+/**
+ * @brief Feeds a raw level read from the switch, from a polling timer or an edge callback.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @param[in] level The raw level of the gpio
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_sw_gesture_feed(int pin_num, uint32_t level);
+
+/**
+ * @brief Stops debouncing a switch pin and drops its pending timers.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ */
+extern void resource_sw_gesture_stop(int pin_num);
+
+#endif /* __POSITION_FINDER_RESOURCE_SW_GESTURE_H__ */
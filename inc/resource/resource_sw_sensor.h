@@ -31,10 +31,53 @@
  */
 extern int resource_read_sw_sensor(int pin_num, uint32_t *out_value);
 
+/**
+ * @brief Reads several switches in one pass.
+ * @param[in] pin_mask The gpio pins to read, bit N standing for pin N
+ * @param[out] out_mask The levels read, bit N set if pin N is non-zero
+ * @return 0 on success, otherwise a negative error value
+ * @see Pins that are not open yet are all opened before the first read.
+ */
+extern int resource_read_sw_sensors(uint64_t pin_mask, uint64_t *out_mask);
+
+/**
+ * @brief Registers a callback invoked on every edge (rising and falling) of the switch.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @param[in] cb The callback, called from the main loop with the level read after the edge
+ * @param[in] data The user data passed to the callback
+ * @return 0 on success, otherwise a negative error value
+ * @see If the gpio pin is not open, creates gpio handle before registering the callback.
+ * @see While the I/O worker runs the level is read there, the callback comes with the completion.
+ */
+extern int resource_set_sw_sensor_interrupted_cb(int pin_num, resource_read_cb cb, void *data);
+
+/**
+ * @brief Reads the level once and hands it to the edge callback, as if an edge came.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @return 0 on success, otherwise a negative error value
+ * @see Needs the callback of resource_set_sw_sensor_interrupted_cb(), gets the level the switch had before its first edge.
+ */
+extern int resource_refresh_sw_sensor(int pin_num);
+
+/**
+ * @brief Unregisters the edge callback and puts the switch back into plain read mode.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_unset_sw_sensor_interrupted_cb(int pin_num);
+
+/**
+ * @brief Opens the gpio pin connected to the switch as an input ahead of its first read.
+ * @param[in] pin_num The number of the gpio pin connected to the switch
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_open_sw_sensor(int pin_num);
+
 /**
  * @brief Releases the gpio handle and changes the gpio pin state to the close(0).
  * @param[in] pin_num The number of the gpio pin connected to the infrared motion sensor
+ * @see Refused while the I/O worker runs, call resource_io_worker_stop() first.
  */
-extern void resource_close_sw_sensor(void);
+extern void resource_close_sw_sensor(int pin_num);
 
 #endif /* __POSITION_FINDER_RESOURCE_INFRARED_MOTION_SENSOR_H__ */
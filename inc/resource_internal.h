@@ -19,17 +19,40 @@
 #ifndef __POSITION_FINDER_RESOURCE_INTERNAL_H__
 #define __POSITION_FINDER_RESOURCE_INTERNAL_H__
 
+#include <stdint.h>
 #include <peripheral_io.h>
 
 
 #define PIN_MAX 40
 
-struct _resource_s {
-	int opened;
-	peripheral_gpio_h sensor_h;
-	void (*close) (int);
+/* GPIO resources use their pin number as id, the others come after the pins */
+enum {
+	RESOURCE_ID_ILLUMINANCE = PIN_MAX,
+	RESOURCE_ID_PWM_LED,
+	RESOURCE_ID_MAX,
 };
-typedef struct _resource_s resource_s;
+
+typedef enum {
+	RESOURCE_TYPE_GPIO_IN = 0,
+	RESOURCE_TYPE_GPIO_OUT,
+	RESOURCE_TYPE_I2C,
+	RESOURCE_TYPE_PWM,
+} resource_type_e;
+
+/* One per driver, an open resource points at the driver that opened it. Hooks a driver lacks are NULL. */
+typedef struct {
+	resource_type_e type;
+	const char *name;
+	int (*open)(int id, int bus); /* Opens and configures the resource, bus is only used by bus devices */
+	int (*read)(int id, uint32_t *out_value);
+	int (*write)(int id, int value);
+	void (*close)(int id); /* Releases the resource and calls resource_set_closed() */
+} resource_driver_s;
+
+extern const resource_driver_s resource_sw_sensor_driver;
+extern const resource_driver_s resource_led_driver;
+extern const resource_driver_s resource_illuminance_driver;
+extern const resource_driver_s resource_pwm_led_driver;
 
 typedef void (*resource_read_cb)(double value, void *data);
 
@@ -40,7 +63,62 @@ struct _resource_read_cb_s {
 };
 typedef struct _resource_read_cb_s resource_read_s;
 
-extern resource_s *resource_get_info(int pin_num);
+struct _resource_s {
+	int opened;
+	peripheral_gpio_h sensor_h;
+	const resource_driver_s *driver;
+	resource_read_s *resource_read_info;
+	int value; /* Last level written to an output pin, -1 if unknown */
+	unsigned int writes_issued;
+	unsigned int writes_saved;
+};
+typedef struct _resource_s resource_s;
+
+typedef void (*resource_foreach_cb)(int id, resource_s *info, void *data);
+
+/**
+ * @brief Returns the state of a resource.
+ * @param[in] id The resource id
+ * @return The state, NULL if the id is out of range
+ */
+extern resource_s *resource_get_info(int id);
+
+/**
+ * @brief Records a resource as open by a driver.
+ * @param[in] id The resource id
+ * @param[in] driver The driver, closes the resource in resource_close_all()
+ */
+extern void resource_set_opened(int id, const resource_driver_s *driver);
+
+/**
+ * @brief Records a resource as closed, from the driver's close.
+ * @param[in] id The resource id
+ */
+extern void resource_set_closed(int id);
+
+/**
+ * @brief Calls a function for every open resource, in id order.
+ * @param[in] cb The function, may close the resource it is given
+ * @param[in] data The user data passed to the function
+ */
+extern void resource_foreach_opened(resource_foreach_cb cb, void *data);
+
+/**
+ * @brief Reads an open resource through its driver.
+ * @param[in] id The resource id
+ * @param[out] out_value The value read
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_read(int id, uint32_t *out_value);
+
+/**
+ * @brief Writes an open resource through its driver.
+ * @param[in] id The resource id
+ * @param[in] value The value, its meaning is up to the driver
+ * @return 0 on success, otherwise a negative error value
+ */
+extern int resource_write(int id, int value);
+
 extern void resource_close_all(void);
 
 #endif /* __POSITION_FINDER_RESOURCE_INTERNAL_H__ */
@@ -32,6 +32,13 @@ typedef enum {
 
 typedef struct __sensor_data_s sensor_data;
 
+typedef struct {
+	unsigned int count;
+	double min;
+	double max;
+	double mean;
+} sensor_data_window_s;
+
 sensor_data *sensor_data_new(sensor_data_type_e type);
 void sensor_data_free(sensor_data *data);
 
@@ -47,4 +54,27 @@ int sensor_data_get_bool(sensor_data *data, bool *value);
 int sensor_data_get_double(sensor_data *data, double *value);
 int sensor_data_get_string(sensor_data *data, const char **value);
 
+/*
+ * String values are kept in preallocated slots (64 bytes unless reserved
+ * otherwise), so setting one only allocates when a longer value grows them.
+ * A pointer from sensor_data_get_string() stays readable until the data is
+ * freed but may be rewritten by later sets; take a stable snapshot with
+ * acquire and hand it back with release.
+ */
+int sensor_data_string_reserve(sensor_data *data, unsigned int capacity);
+int sensor_data_acquire_string(sensor_data *data, const char **value);
+int sensor_data_release_string(sensor_data *data, const char *value);
+
+/* Bumped every time the stored value changes, so readers can skip unchanged values */
+unsigned int sensor_data_get_version(sensor_data *data);
+
+/*
+ * Optional sample history: a ring of (CLOCK_MONOTONIC seconds, value) pairs
+ * allocated once by sensor_data_history_enable(), 16 bytes per entry.
+ * Every set of a numeric value appends one sample; queries allocate nothing.
+ */
+int sensor_data_history_enable(sensor_data *data, unsigned int capacity);
+int sensor_data_history_window(sensor_data *data, double since, sensor_data_window_s *window);
+int sensor_data_history_last(sensor_data *data, unsigned int n, double *timestamps, double *values, unsigned int *count);
+
 #endif /* __SENSOR_DATA_H__ */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TRACING_H__
+#define __TRACING_H__
+
+/* Spans go to ttrace where it exists, otherwise into a Chrome trace JSON file in the app data directory */
+#define TRACING_FILE_DEFAULT "ledsw-trace.json"
+
+extern int tracing_enabled;
+/* Spans the calling thread has open, an end without a begin is skipped */
+extern __thread int tracing_depth;
+
+extern void tracing_begin(const char *name);
+extern void tracing_end(void);
+
+#ifdef TRACING_DISABLE
+#define TRACE_BEGIN(name) do { } while (0)
+#define TRACE_END() do { } while (0)
+#else
+/* Costs two predicted branches while tracing is off, spans nested in a recorded one are counted */
+#define TRACE_BEGIN(name) do { \
+	if (__builtin_expect(__atomic_load_n(&tracing_enabled, __ATOMIC_RELAXED) || tracing_depth, 0)) \
+		tracing_begin(name); \
+} while (0)
+
+#define TRACE_END() do { \
+	if (__builtin_expect(tracing_depth, 0)) \
+		tracing_end(); \
+} while (0)
+#endif
+
+/**
+ * @brief Reads the initial state from $LEDSW_TRACE and the output file from $LEDSW_TRACE_FILE.
+ * @see Without $LEDSW_TRACE_FILE, the file is TRACING_FILE_DEFAULT in the app data directory.
+ * @return 0 on success, otherwise a negative error value
+ */
+int tracing_init(void);
+
+/**
+ * @brief Turns the spans on or off, spans already open are still closed and only recorded ones end.
+ * @param[in] enabled 1 to record spans, 0 to stop
+ * @return 0 on success, otherwise a negative error value
+ */
+int tracing_set_enabled(int enabled);
+
+/**
+ * @brief Stops tracing and completes the trace file.
+ */
+void tracing_fini(void);
+
+#endif /* __TRACING_H__ */
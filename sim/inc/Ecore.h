@@ -0,0 +1,55 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_ECORE_H__
+#define __SIM_ECORE_H__
+
+/* Host stand-in for the parts of Ecore the service uses, the loop itself is single threaded */
+
+typedef unsigned char Eina_Bool;
+#define EINA_TRUE ((Eina_Bool) 1)
+#define EINA_FALSE ((Eina_Bool) 0)
+
+#define ECORE_CALLBACK_CANCEL EINA_FALSE
+#define ECORE_CALLBACK_RENEW EINA_TRUE
+
+typedef Eina_Bool (*Ecore_Task_Cb)(void *data);
+typedef void (*Ecore_Cb)(void *data);
+
+typedef struct _Ecore_Timer Ecore_Timer;
+typedef struct _Ecore_Timer Ecore_Job;
+typedef struct _Ecore_Timer Ecore_Idle_Enterer;
+
+double ecore_time_get(void);
+double ecore_loop_time_get(void);
+
+Ecore_Timer *ecore_timer_add(double in, Ecore_Task_Cb func, const void *data);
+void *ecore_timer_del(Ecore_Timer *timer);
+void ecore_timer_interval_set(Ecore_Timer *timer, double in);
+double ecore_timer_interval_get(const Ecore_Timer *timer);
+void ecore_timer_reset(Ecore_Timer *timer);
+
+Ecore_Job *ecore_job_add(Ecore_Cb func, const void *data);
+void *ecore_job_del(Ecore_Job *job);
+
+Ecore_Idle_Enterer *ecore_idle_enterer_add(Ecore_Task_Cb func, const void *data);
+void *ecore_idle_enterer_del(Ecore_Idle_Enterer *idle_enterer);
+
+void ecore_main_loop_begin(void);
+void ecore_main_loop_quit(void);
+
+/* The only call that may come from another thread, runs func on the next loop iteration */
+void ecore_main_loop_thread_safe_call_async(Ecore_Cb callback, void *data);
+
+#endif /* __SIM_ECORE_H__ */
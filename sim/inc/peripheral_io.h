@@ -0,0 +1,85 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_PERIPHERAL_IO_H__
+#define __SIM_PERIPHERAL_IO_H__
+
+/* Host stand-in for the subset of Tizen capi-system-peripheral-io used by src/resource */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <tizen.h>
+
+typedef enum {
+	PERIPHERAL_ERROR_NONE = TIZEN_ERROR_NONE,
+	PERIPHERAL_ERROR_IO_ERROR = TIZEN_ERROR_IO_ERROR,
+	PERIPHERAL_ERROR_NO_DEVICE = TIZEN_ERROR_NO_SUCH_DEVICE,
+	PERIPHERAL_ERROR_TRY_AGAIN = TIZEN_ERROR_TRY_AGAIN,
+	PERIPHERAL_ERROR_OUT_OF_MEMORY = TIZEN_ERROR_OUT_OF_MEMORY,
+	PERIPHERAL_ERROR_PERMISSION_DENIED = TIZEN_ERROR_PERMISSION_DENIED,
+	PERIPHERAL_ERROR_RESOURCE_BUSY = TIZEN_ERROR_RESOURCE_BUSY,
+	PERIPHERAL_ERROR_INVALID_PARAMETER = TIZEN_ERROR_INVALID_PARAMETER,
+	PERIPHERAL_ERROR_NOT_SUPPORTED = TIZEN_ERROR_NOT_SUPPORTED,
+	PERIPHERAL_ERROR_UNKNOWN = TIZEN_ERROR_UNKNOWN,
+} peripheral_error_e;
+
+typedef enum {
+	PERIPHERAL_GPIO_DIRECTION_IN = 0,
+	PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_HIGH,
+	PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_LOW,
+} peripheral_gpio_direction_e;
+
+typedef enum {
+	PERIPHERAL_GPIO_EDGE_NONE = 0,
+	PERIPHERAL_GPIO_EDGE_RISING,
+	PERIPHERAL_GPIO_EDGE_FALLING,
+	PERIPHERAL_GPIO_EDGE_BOTH,
+} peripheral_gpio_edge_e;
+
+typedef struct _peripheral_gpio_s *peripheral_gpio_h;
+typedef void (*peripheral_gpio_interrupted_cb)(peripheral_gpio_h gpio, peripheral_error_e error, void *user_data);
+
+int peripheral_gpio_open(int gpio_pin, peripheral_gpio_h *gpio);
+int peripheral_gpio_close(peripheral_gpio_h gpio);
+int peripheral_gpio_set_direction(peripheral_gpio_h gpio, peripheral_gpio_direction_e direction);
+int peripheral_gpio_set_edge_mode(peripheral_gpio_h gpio, peripheral_gpio_edge_e edge);
+int peripheral_gpio_set_interrupted_cb(peripheral_gpio_h gpio, peripheral_gpio_interrupted_cb callback, void *user_data);
+int peripheral_gpio_unset_interrupted_cb(peripheral_gpio_h gpio);
+int peripheral_gpio_read(peripheral_gpio_h gpio, uint32_t *value);
+int peripheral_gpio_write(peripheral_gpio_h gpio, uint32_t value);
+
+typedef struct _peripheral_i2c_s *peripheral_i2c_h;
+
+int peripheral_i2c_open(int bus, int address, peripheral_i2c_h *i2c);
+int peripheral_i2c_close(peripheral_i2c_h i2c);
+int peripheral_i2c_read(peripheral_i2c_h i2c, uint8_t *data, uint32_t length);
+int peripheral_i2c_write(peripheral_i2c_h i2c, uint8_t *data, uint32_t length);
+
+typedef enum {
+	PERIPHERAL_PWM_POLARITY_ACTIVE_HIGH = 0,
+	PERIPHERAL_PWM_POLARITY_ACTIVE_LOW,
+} peripheral_pwm_polarity_e;
+
+typedef struct _peripheral_pwm_s *peripheral_pwm_h;
+
+int peripheral_pwm_open(int chip, int pin, peripheral_pwm_h *pwm);
+int peripheral_pwm_close(peripheral_pwm_h pwm);
+int peripheral_pwm_set_period(peripheral_pwm_h pwm, uint32_t period_ns);
+int peripheral_pwm_set_duty_cycle(peripheral_pwm_h pwm, uint32_t duty_cycle_ns);
+int peripheral_pwm_set_polarity(peripheral_pwm_h pwm, peripheral_pwm_polarity_e polarity);
+int peripheral_pwm_set_enabled(peripheral_pwm_h pwm, bool enable);
+
+#endif /* __SIM_PERIPHERAL_IO_H__ */
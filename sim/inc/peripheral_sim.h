@@ -0,0 +1,122 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_PERIPHERAL_SIM_H__
+#define __SIM_PERIPHERAL_SIM_H__
+
+#include <stdint.h>
+
+/* Times are seconds on the ecore_time_get() clock relative to peripheral_sim_epoch() */
+
+typedef void (*peripheral_sim_write_cb)(int pin_num, uint32_t value, double timestamp, void *data);
+
+/**
+ * @brief Gets the ecore_time_get() value that script times are relative to.
+ * @return The epoch, fixed by the first call into the simulator
+ */
+double peripheral_sim_epoch(void);
+
+/**
+ * @brief Schedules a level change on an input pin.
+ * @param[in] pin_num The gpio pin number
+ * @param[in] at When the level changes, relative to the epoch
+ * @param[in] level The new level
+ * @return 0 on success, otherwise a negative error value
+ */
+int peripheral_sim_gpio_schedule(int pin_num, double at, uint32_t level);
+
+/**
+ * @brief Changes the level of an input pin now and fires its edge callback.
+ * @param[in] pin_num The gpio pin number
+ * @param[in] level The new level
+ * @return 0 on success, otherwise a negative error value
+ */
+int peripheral_sim_gpio_set_level(int pin_num, uint32_t level);
+
+/**
+ * @brief Schedules a change of the light level seen by the GY30 model.
+ * @param[in] at When the light changes, relative to the epoch
+ * @param[in] lux The new illuminance
+ * @return 0 on success, otherwise a negative error value
+ */
+int peripheral_sim_lux_schedule(double at, double lux);
+
+/**
+ * @brief Sets how much light the lamp on the open PWM channel adds to what the GY30 model sees.
+ * @param[in] lux The illuminance added at full duty, scaled down with the duty cycle
+ */
+void peripheral_sim_set_lamp_lux(double lux);
+
+/**
+ * @brief Loads a waveform script.
+ * @param[in] path The script, one "gpio <pin> <sec> <level>", "lux <sec> <lux>" or "lamp <lux>" per line, '#' comments
+ * @return 0 on success, otherwise a negative error value
+ */
+int peripheral_sim_load_script(const char *path);
+
+/**
+ * @brief Makes every gpio or i2c call spin for a while, to model a slow backend.
+ * @param[in] gpio_usec The extra time of each gpio call
+ * @param[in] i2c_usec The extra time of each i2c call
+ */
+void peripheral_sim_set_latency(unsigned int gpio_usec, unsigned int i2c_usec);
+
+/**
+ * @brief Registers a callback called on every gpio write, right after it is recorded.
+ * @param[in] cb The callback, NULL to unset
+ * @param[in] data The user data passed to the callback
+ */
+void peripheral_sim_set_write_cb(peripheral_sim_write_cb cb, void *data);
+
+/**
+ * @brief Writes the recorded output timeline as "time,pin,value" CSV lines.
+ * @param[in] path The output file
+ * @return The number of records written, otherwise a negative error value
+ */
+int peripheral_sim_dump_timeline(const char *path);
+
+/**
+ * @brief Gets when the next scripted input is due, used by the main loop to sleep.
+ * @return The absolute ecore_time_get() time, or a negative value if nothing is scheduled
+ */
+double peripheral_sim_next_event(void);
+
+/**
+ * @brief Applies the scripted inputs that are due and fires their edge callbacks.
+ * @param[in] now The current ecore_time_get() time
+ */
+void peripheral_sim_dispatch(double now);
+
+/**
+ * @brief Starts a latency benchmark: schedules random edges and matches them with the LED writes.
+ * @param[in] path The JSON result file written by peripheral_sim_bench_finish()
+ * @return How long the run needs in seconds, otherwise a negative error value
+ * @see $LEDSW_SIM_BENCH_PIN, _LEDS ("led1,led2"), _EDGES, _SEED and _MODE tune the run.
+ */
+double peripheral_sim_bench_start(const char *path);
+
+/**
+ * @brief Records how late a periodic timer fired, called by the host main loop.
+ * @param[in] interval The interval of the timer
+ * @param[in] lateness How long after its deadline the timer ran
+ */
+void peripheral_sim_bench_timer_fired(double interval, double lateness);
+
+/**
+ * @brief Writes the benchmark results, if a benchmark was started.
+ * @return 0 on success, otherwise a negative error value
+ */
+int peripheral_sim_bench_finish(void);
+
+#endif /* __SIM_PERIPHERAL_SIM_H__ */
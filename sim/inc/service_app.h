@@ -0,0 +1,51 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_SERVICE_APP_H__
+#define __SIM_SERVICE_APP_H__
+
+#include <stdbool.h>
+
+typedef struct app_control_s *app_control_h;
+
+typedef enum {
+	APP_CONTROL_ERROR_NONE = 0,
+	APP_CONTROL_ERROR_INVALID_PARAMETER = -22,
+	APP_CONTROL_ERROR_KEY_NOT_FOUND = -126,
+} app_control_error_e;
+
+/* $LEDSW_SIM_DATA with a trailing slash, the current directory by default */
+char *app_get_data_path(void);
+
+/* $LEDSW_SIM_RES with a trailing slash, sim/res by default */
+char *app_get_resource_path(void);
+
+/* The launch request carries the "key=value" pairs of $LEDSW_SIM_EXTRA, space separated */
+int app_control_get_extra_data(app_control_h app_control, const char *key, char **value);
+
+typedef bool (*service_app_create_cb)(void *user_data);
+typedef void (*service_app_terminate_cb)(void *user_data);
+typedef void (*service_app_control_cb)(app_control_h app_control, void *user_data);
+
+typedef struct {
+	service_app_create_cb create;
+	service_app_terminate_cb terminate;
+	service_app_control_cb app_control;
+} service_app_lifecycle_callback_s;
+
+/* Runs create, app_control and the Ecore loop until service_app_exit() or $LEDSW_SIM_DURATION seconds */
+int service_app_main(int argc, char **argv, service_app_lifecycle_callback_s *callback, void *user_data);
+void service_app_exit(void);
+
+#endif /* __SIM_SERVICE_APP_H__ */
@@ -0,0 +1,37 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_TIZEN_H__
+#define __SIM_TIZEN_H__
+
+#include <errno.h>
+
+#define TIZEN_ERROR_MIN_PLATFORM_ERROR (-1073741824)
+
+typedef enum {
+	TIZEN_ERROR_NONE = 0,
+	TIZEN_ERROR_UNKNOWN = TIZEN_ERROR_MIN_PLATFORM_ERROR,
+	TIZEN_ERROR_IO_ERROR = -EIO,
+	TIZEN_ERROR_NO_SUCH_DEVICE = -ENODEV,
+	TIZEN_ERROR_TRY_AGAIN = -EAGAIN,
+	TIZEN_ERROR_OUT_OF_MEMORY = -ENOMEM,
+	TIZEN_ERROR_PERMISSION_DENIED = -EACCES,
+	TIZEN_ERROR_RESOURCE_BUSY = -EBUSY,
+	TIZEN_ERROR_INVALID_PARAMETER = -EINVAL,
+	TIZEN_ERROR_NOT_SUPPORTED = TIZEN_ERROR_MIN_PLATFORM_ERROR + 2,
+} tizen_error_e;
+
+const char *get_error_message(int err);
+
+#endif /* __SIM_TIZEN_H__ */
@@ -0,0 +1,253 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Ecore.h>
+#include <peripheral_io.h>
+
+#include "peripheral_sim.h"
+
+/*
+ * Switch-to-LED latency benchmark.
+ * Random press/release edges are scheduled on the switch pin. Each edge expects the
+ * first transition of the sequence ledsw plays for it: a press turns both LEDs on, a
+ * release turns the first LED off. The first write making that transition, after the
+ * edge and before the next one, is the edge's response. Edges whose LEDs already show
+ * the transition expect no write and are counted apart, the others without a response
+ * are misses.
+ */
+
+#define BENCH_EDGES_DEFAULT 40
+#define BENCH_PIN_DEFAULT 20
+#define BENCH_LED_1_DEFAULT 5
+#define BENCH_LED_2_DEFAULT 26
+
+typedef struct {
+	double time;
+	uint64_t expect_mask; /* The LED pins the edge drives */
+	uint64_t expect_values;
+	int expected; /* The LEDs did not show the transition yet when the edge came */
+	int answered;
+} bench_edge_s;
+
+typedef struct {
+	double *values;
+	unsigned int count;
+	unsigned int size;
+} bench_series_s;
+
+static struct {
+	int started;
+	char *path;
+	const char *mode;
+	int pin_num;
+	uint64_t led_mask;
+	uint64_t led_levels; /* As last written */
+
+	bench_edge_s *edges;
+	unsigned int edge_count;
+	unsigned int passed;
+	double last_latency;
+
+	bench_series_s latency;
+	bench_series_s jitter; /* Change of the latency from one answered edge to the next */
+	bench_series_s timer_lateness;
+} bench;
+
+static void __series_add(bench_series_s *series, double value)
+{
+	if (series->count == series->size) {
+		unsigned int size = series->size ? series->size * 2 : 256;
+		double *values = realloc(series->values, size * sizeof(double));
+		if (!values)
+			return;
+		series->values = values;
+		series->size = size;
+	}
+
+	series->values[series->count++] = value;
+}
+
+static int __compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static double __percentile(const bench_series_s *series, double p)
+{
+	unsigned int index = 0;
+
+	if (!series->count)
+		return 0.0;
+
+	index = (unsigned int) (p * (series->count - 1) + 0.5);
+	return series->values[index];
+}
+
+static void __series_print(FILE *fp, const char *name, bench_series_s *series)
+{
+	qsort(series->values, series->count, sizeof(double), __compare_double);
+
+	fprintf(fp, "  \"%s\": { \"samples\": %u, \"p50_usec\": %.1f, \"p99_usec\": %.1f, \"max_usec\": %.1f }",
+			name, series->count,
+			__percentile(series, 0.50) * 1e6,
+			__percentile(series, 0.99) * 1e6,
+			series->count ? series->values[series->count - 1] * 1e6 : 0.0);
+}
+
+/* Decides whether the edges up to timestamp expect a write, against the levels they found */
+static void __bench_pass_edges(double timestamp)
+{
+	bench_edge_s *edge = NULL;
+
+	while (bench.passed < bench.edge_count && bench.edges[bench.passed].time <= timestamp) {
+		edge = &bench.edges[bench.passed++];
+		edge->expected = ((bench.led_levels & edge->expect_mask) != edge->expect_values);
+	}
+}
+
+static void __bench_write_cb(int pin_num, uint32_t value, double timestamp, void *data)
+{
+	bench_edge_s *edge = NULL;
+	uint64_t bit = 0;
+	double latency = 0.0;
+
+	if (pin_num < 0 || !(bench.led_mask & (1ULL << pin_num)))
+		return;
+
+	bit = 1ULL << pin_num;
+	__bench_pass_edges(timestamp);
+	bench.led_levels = value ? (bench.led_levels | bit) : (bench.led_levels & ~bit);
+
+	if (!bench.passed)
+		return;
+
+	/* Only the newest edge can be answered, older unanswered ones stay misses */
+	edge = &bench.edges[bench.passed - 1];
+	if (!edge->expected || edge->answered)
+		return;
+	if (!(edge->expect_mask & bit) || (edge->expect_values & bit) != (value ? bit : 0))
+		return;
+
+	edge->answered = 1;
+	latency = timestamp - edge->time;
+	__series_add(&bench.latency, latency);
+	if (bench.latency.count > 1)
+		__series_add(&bench.jitter, latency > bench.last_latency ? latency - bench.last_latency : bench.last_latency - latency);
+	bench.last_latency = latency;
+}
+
+double peripheral_sim_bench_start(const char *path)
+{
+	const char *env = NULL;
+	unsigned int edges = BENCH_EDGES_DEFAULT;
+	unsigned int seed = 1;
+	unsigned int i = 0;
+	double at = 1.0;
+	int led_1 = BENCH_LED_1_DEFAULT;
+	int led_2 = BENCH_LED_2_DEFAULT;
+
+	if (!path)
+		return -1.0;
+
+	bench.path = strdup(path);
+	bench.pin_num = (env = getenv("LEDSW_SIM_BENCH_PIN")) ? atoi(env) : BENCH_PIN_DEFAULT;
+	if ((env = getenv("LEDSW_SIM_BENCH_LEDS")))
+		sscanf(env, "%d,%d", &led_1, &led_2);
+	bench.led_mask = (1ULL << led_1) | (1ULL << led_2);
+	bench.mode = (env = getenv("LEDSW_SIM_BENCH_MODE")) ? env : "default";
+	if ((env = getenv("LEDSW_SIM_BENCH_EDGES")))
+		edges = (unsigned int) atoi(env);
+	if ((env = getenv("LEDSW_SIM_BENCH_SEED")))
+		seed = (unsigned int) atoi(env);
+
+	bench.edges = calloc(edges ? edges : 1, sizeof(bench_edge_s));
+	if (!bench.path || !bench.edges)
+		return -1.0;
+
+	/* Held 150-450 ms, released 900-1500 ms, long enough for the release blink to finish */
+	srand(seed);
+	for (i = 0; i < edges; i++) {
+		double hold = (i % 2 == 0) ? 0.150 + (rand() % 300) / 1000.0 : 0.900 + (rand() % 600) / 1000.0;
+
+		bench.edges[i].time = peripheral_sim_epoch() + at;
+		if (i % 2 == 0) {
+			bench.edges[i].expect_mask = bench.led_mask;
+			bench.edges[i].expect_values = bench.led_mask;
+		} else {
+			bench.edges[i].expect_mask = 1ULL << led_1;
+			bench.edges[i].expect_values = 0;
+		}
+		if (peripheral_sim_gpio_schedule(bench.pin_num, at, (i % 2 == 0)))
+			return -1.0;
+		at += hold;
+	}
+	bench.edge_count = edges;
+
+	peripheral_sim_set_write_cb(__bench_write_cb, NULL);
+	bench.started = 1;
+
+	return at + 1.0;
+}
+
+/* Every periodic timer counts, in polling mode that is the sampling timer */
+void peripheral_sim_bench_timer_fired(double interval, double lateness)
+{
+	if (!bench.started)
+		return;
+
+	__series_add(&bench.timer_lateness, lateness < 0.0 ? -lateness : lateness);
+}
+
+int peripheral_sim_bench_finish(void)
+{
+	FILE *fp = NULL;
+	unsigned int misses = 0;
+	unsigned int unchanged = 0;
+	unsigned int i = 0;
+
+	if (!bench.started)
+		return 0;
+
+	__bench_pass_edges(bench.edge_count ? bench.edges[bench.edge_count - 1].time : 0.0);
+	for (i = 0; i < bench.edge_count; i++) {
+		if (!bench.edges[i].expected)
+			unchanged++;
+		else if (!bench.edges[i].answered)
+			misses++;
+	}
+
+	fp = fopen(bench.path, "w");
+	if (!fp) {
+		fprintf(stderr, "sim: cannot write %s\n", bench.path);
+		return -1;
+	}
+
+	fprintf(fp, "{\n  \"mode\": \"%s\",\n  \"edges\": %u,\n  \"unchanged\": %u,\n  \"misses\": %u,\n",
+			bench.mode, bench.edge_count, unchanged, misses);
+	__series_print(fp, "latency", &bench.latency);
+	fprintf(fp, ",\n");
+	__series_print(fp, "jitter", &bench.jitter);
+	fprintf(fp, ",\n");
+	__series_print(fp, "timer_lateness", &bench.timer_lateness);
+	fprintf(fp, "\n}\n");
+	fclose(fp);
+
+	return 0;
+}
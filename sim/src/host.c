@@ -0,0 +1,513 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dlog.h>
+#include <tizen.h>
+#include <Ecore.h>
+#include <service_app.h>
+
+#include "peripheral_sim.h"
+
+/* Host replacements for dlog, the Tizen error strings, Ecore and service_app */
+
+typedef enum {
+	SIM_TASK_TIMER = 0,
+	SIM_TASK_JOB,
+	SIM_TASK_IDLE_ENTERER,
+} sim_task_type_e;
+
+struct _Ecore_Timer {
+	sim_task_type_e type;
+	double interval;
+	double deadline;
+	Ecore_Task_Cb func;
+	Ecore_Cb job_func;
+	void *data;
+	int deleted;
+	struct _Ecore_Timer *next;
+};
+
+typedef struct _sim_async_call_s {
+	Ecore_Cb func;
+	void *data;
+	struct _sim_async_call_s *next;
+} sim_async_call_s;
+
+static struct _Ecore_Timer *g_tasks = NULL;
+static struct {
+	pthread_mutex_t lock;
+	sim_async_call_s *head;
+	sim_async_call_s *tail;
+	int pipe[2]; /* Written once per batch of calls to wake the loop up */
+} g_async = { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, { -1, -1 } };
+static double g_loop_time = 0.0;
+static int g_quit = 0;
+static int g_log_level = -1;
+
+int dlog_vprint(log_priority prio, const char *tag, const char *fmt, va_list ap)
+{
+	static const char prio_char[] = "??VDIWEFS";
+	int level = __atomic_load_n(&g_log_level, __ATOMIC_RELAXED);
+
+	/* The app logs from its drainer thread too, whoever comes first reads the level */
+	if (level < 0) {
+		const char *env = getenv("LEDSW_SIM_LOG");
+		level = env ? atoi(env) : DLOG_WARN;
+		__atomic_store_n(&g_log_level, level, __ATOMIC_RELAXED);
+	}
+
+	if ((int) prio < level)
+		return 0;
+
+	fprintf(stderr, "%.6f %c/%s: ", ecore_time_get() - peripheral_sim_epoch(), prio_char[prio % 9], tag);
+	return vfprintf(stderr, fmt, ap);
+}
+
+int dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+{
+	va_list ap;
+	int ret = 0;
+
+	va_start(ap, fmt);
+	ret = dlog_vprint(prio, tag, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+const char *get_error_message(int err)
+{
+	switch (err) {
+	case TIZEN_ERROR_NONE:
+		return "Successful";
+	case TIZEN_ERROR_IO_ERROR:
+		return "IO error";
+	case TIZEN_ERROR_NO_SUCH_DEVICE:
+		return "No such device";
+	case TIZEN_ERROR_TRY_AGAIN:
+		return "Try again";
+	case TIZEN_ERROR_OUT_OF_MEMORY:
+		return "Out of memory";
+	case TIZEN_ERROR_PERMISSION_DENIED:
+		return "Permission denied";
+	case TIZEN_ERROR_RESOURCE_BUSY:
+		return "Device or resource busy";
+	case TIZEN_ERROR_INVALID_PARAMETER:
+		return "Invalid parameter";
+	case TIZEN_ERROR_NOT_SUPPORTED:
+		return "Not supported";
+	default:
+		return "Unknown error";
+	}
+}
+
+double ecore_time_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+double ecore_loop_time_get(void)
+{
+	return g_loop_time;
+}
+
+static struct _Ecore_Timer *__task_add(sim_task_type_e type, double in, const void *data)
+{
+	struct _Ecore_Timer *task = calloc(1, sizeof(struct _Ecore_Timer));
+
+	if (!task)
+		return NULL;
+
+	task->type = type;
+	task->interval = in;
+	task->deadline = ecore_time_get() + in;
+	task->data = (void *) data;
+
+	/* Appended, so tasks with the same deadline run in the order they were added */
+	if (!g_tasks) {
+		g_tasks = task;
+	} else {
+		struct _Ecore_Timer *last = g_tasks;
+		while (last->next)
+			last = last->next;
+		last->next = task;
+	}
+
+	return task;
+}
+
+static void *__task_del(struct _Ecore_Timer *task)
+{
+	if (!task || task->deleted)
+		return NULL;
+
+	task->deleted = 1;
+	return task->data;
+}
+
+Ecore_Timer *ecore_timer_add(double in, Ecore_Task_Cb func, const void *data)
+{
+	struct _Ecore_Timer *timer = NULL;
+
+	if (!func || in < 0.0)
+		return NULL;
+
+	timer = __task_add(SIM_TASK_TIMER, in, data);
+	if (timer)
+		timer->func = func;
+
+	return timer;
+}
+
+void *ecore_timer_del(Ecore_Timer *timer)
+{
+	return __task_del(timer);
+}
+
+void ecore_timer_interval_set(Ecore_Timer *timer, double in)
+{
+	if (!timer || in < 0.0)
+		return;
+
+	timer->interval = in;
+}
+
+double ecore_timer_interval_get(const Ecore_Timer *timer)
+{
+	return timer ? timer->interval : -1.0;
+}
+
+void ecore_timer_reset(Ecore_Timer *timer)
+{
+	if (!timer)
+		return;
+
+	timer->deadline = ecore_time_get() + timer->interval;
+}
+
+Ecore_Job *ecore_job_add(Ecore_Cb func, const void *data)
+{
+	struct _Ecore_Timer *job = NULL;
+
+	if (!func)
+		return NULL;
+
+	job = __task_add(SIM_TASK_JOB, 0.0, data);
+	if (job)
+		job->job_func = func;
+
+	return job;
+}
+
+void *ecore_job_del(Ecore_Job *job)
+{
+	return __task_del(job);
+}
+
+Ecore_Idle_Enterer *ecore_idle_enterer_add(Ecore_Task_Cb func, const void *data)
+{
+	struct _Ecore_Timer *idle_enterer = NULL;
+
+	if (!func)
+		return NULL;
+
+	idle_enterer = __task_add(SIM_TASK_IDLE_ENTERER, 0.0, data);
+	if (idle_enterer)
+		idle_enterer->func = func;
+
+	return idle_enterer;
+}
+
+void *ecore_idle_enterer_del(Ecore_Idle_Enterer *idle_enterer)
+{
+	return __task_del(idle_enterer);
+}
+
+static void __tasks_collect(void)
+{
+	struct _Ecore_Timer **link = &g_tasks;
+
+	while (*link) {
+		struct _Ecore_Timer *task = *link;
+		if (task->deleted) {
+			*link = task->next;
+			free(task);
+		} else {
+			link = &task->next;
+		}
+	}
+}
+
+/* Runs one pass over the tasks of the given type that are due, returns how many ran */
+static int __tasks_run(sim_task_type_e type, double now)
+{
+	struct _Ecore_Timer *task = NULL;
+	struct _Ecore_Timer *last = NULL;
+	int count = 0;
+
+	/* Tasks added while running wait for the next pass */
+	for (last = g_tasks; last && last->next; last = last->next)
+		;
+
+	for (task = g_tasks; task; task = task->next) {
+		if (!task->deleted && task->type == type && (type != SIM_TASK_TIMER || task->deadline <= now)) {
+			count++;
+			if (type == SIM_TASK_JOB) {
+				task->deleted = 1;
+				task->job_func(task->data);
+			} else if (!task->func(task->data)) {
+				task->deleted = 1;
+			} else if (type == SIM_TASK_TIMER && !task->deleted) {
+				peripheral_sim_bench_timer_fired(task->interval, now - task->deadline);
+				task->deadline += task->interval;
+				if (task->deadline < now)
+					task->deadline = now + task->interval;
+			}
+		}
+		if (task == last)
+			break;
+	}
+
+	return count;
+}
+
+void ecore_main_loop_thread_safe_call_async(Ecore_Cb callback, void *data)
+{
+	sim_async_call_s *call = NULL;
+	int wake = 0;
+
+	if (!callback)
+		return;
+
+	call = calloc(1, sizeof(sim_async_call_s));
+	if (!call)
+		return;
+	call->func = callback;
+	call->data = data;
+
+	pthread_mutex_lock(&g_async.lock);
+	if (g_async.tail) {
+		g_async.tail->next = call;
+	} else {
+		g_async.head = call;
+		wake = 1;
+	}
+	g_async.tail = call;
+	pthread_mutex_unlock(&g_async.lock);
+
+	/* A full pipe already has a wakeup pending */
+	if (wake && g_async.pipe[1] >= 0 && write(g_async.pipe[1], "", 1) < 0)
+		return;
+}
+
+static void __async_run(void)
+{
+	sim_async_call_s *call = NULL;
+	char buf[64];
+
+	pthread_mutex_lock(&g_async.lock);
+	call = g_async.head;
+	g_async.head = NULL;
+	g_async.tail = NULL;
+	while (g_async.pipe[0] >= 0 && read(g_async.pipe[0], buf, sizeof(buf)) > 0)
+		;
+	pthread_mutex_unlock(&g_async.lock);
+
+	while (call) {
+		sim_async_call_s *next = call->next;
+		call->func(call->data);
+		free(call);
+		call = next;
+	}
+}
+
+static double __next_deadline(void)
+{
+	struct _Ecore_Timer *task = NULL;
+	double next = peripheral_sim_next_event();
+
+	for (task = g_tasks; task; task = task->next) {
+		if (task->deleted)
+			continue;
+		if (task->type == SIM_TASK_JOB)
+			return 0.0;
+		if (task->type == SIM_TASK_TIMER && (next < 0.0 || task->deadline < next))
+			next = task->deadline;
+	}
+
+	return next;
+}
+
+void ecore_main_loop_begin(void)
+{
+	g_quit = 0;
+
+	if (g_async.pipe[0] < 0 && pipe2(g_async.pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+		g_async.pipe[0] = g_async.pipe[1] = -1;
+
+	while (!g_quit) {
+		double next = 0.0;
+		double now = ecore_time_get();
+
+		g_loop_time = now;
+		__async_run();
+		peripheral_sim_dispatch(now);
+		__tasks_run(SIM_TASK_JOB, now);
+		__tasks_run(SIM_TASK_TIMER, now);
+		__tasks_collect();
+
+		if (g_quit)
+			break;
+
+		__tasks_run(SIM_TASK_IDLE_ENTERER, now);
+		__tasks_collect();
+
+		next = __next_deadline();
+		now = ecore_time_get();
+		if (next < 0.0) {
+			/* Nothing can ever happen again */
+			break;
+		} else if (next > now) {
+			struct pollfd pfd = { g_async.pipe[0], POLLIN, 0 };
+			struct timespec ts;
+			double wait = next - now;
+
+			ts.tv_sec = (time_t) wait;
+			ts.tv_nsec = (long) ((wait - ts.tv_sec) * 1000000000.0);
+			ppoll(&pfd, pfd.fd >= 0 ? 1 : 0, &ts, NULL);
+		}
+	}
+}
+
+void ecore_main_loop_quit(void)
+{
+	g_quit = 1;
+}
+
+void service_app_exit(void)
+{
+	ecore_main_loop_quit();
+}
+
+static Eina_Bool __duration_expired(void *data)
+{
+	service_app_exit();
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static char *__env_path(const char *name, const char *fallback)
+{
+	const char *env = getenv(name);
+	char *path = NULL;
+
+	if (!env || !*env)
+		return strdup(fallback);
+
+	if (asprintf(&path, "%s%s", env, env[strlen(env) - 1] == '/' ? "" : "/") < 0)
+		return NULL;
+
+	return path;
+}
+
+char *app_get_data_path(void)
+{
+	return __env_path("LEDSW_SIM_DATA", "./");
+}
+
+char *app_get_resource_path(void)
+{
+	return __env_path("LEDSW_SIM_RES", "res/");
+}
+
+struct app_control_s {
+	const char *extra;
+};
+
+int app_control_get_extra_data(app_control_h app_control, const char *key, char **value)
+{
+	const char *p = NULL;
+	size_t key_len = 0;
+
+	if (!app_control || !key || !value)
+		return APP_CONTROL_ERROR_INVALID_PARAMETER;
+
+	key_len = strlen(key);
+	for (p = app_control->extra; p && *p; p += strcspn(p, " "), p += strspn(p, " ")) {
+		if (!strncmp(p, key, key_len) && p[key_len] == '=') {
+			p += key_len + 1;
+			*value = strndup(p, strcspn(p, " "));
+			return *value ? APP_CONTROL_ERROR_NONE : -ENOMEM;
+		}
+	}
+
+	return APP_CONTROL_ERROR_KEY_NOT_FOUND;
+}
+
+int service_app_main(int argc, char **argv, service_app_lifecycle_callback_s *callback, void *user_data)
+{
+	const char *script = getenv("LEDSW_SIM_SCRIPT");
+	const char *duration = getenv("LEDSW_SIM_DURATION");
+	const char *timeline = getenv("LEDSW_SIM_TIMELINE");
+	const char *bench = getenv("LEDSW_SIM_BENCH");
+	double run_time = duration ? atof(duration) : 10.0;
+
+	if (!callback || !callback->create)
+		return TIZEN_ERROR_INVALID_PARAMETER;
+
+	peripheral_sim_epoch();
+
+	if (script && peripheral_sim_load_script(script))
+		return TIZEN_ERROR_INVALID_PARAMETER;
+
+	if (bench) {
+		run_time = peripheral_sim_bench_start(bench);
+		if (run_time < 0.0)
+			return TIZEN_ERROR_INVALID_PARAMETER;
+	}
+
+	ecore_timer_add(run_time, __duration_expired, NULL);
+
+	if (!callback->create(user_data))
+		return TIZEN_ERROR_UNKNOWN;
+
+	if (callback->app_control) {
+		struct app_control_s app_control = { getenv("LEDSW_SIM_EXTRA") };
+		callback->app_control(&app_control, user_data);
+	}
+
+	ecore_main_loop_begin();
+
+	if (callback->terminate)
+		callback->terminate(user_data);
+
+	if (bench)
+		peripheral_sim_bench_finish();
+
+	if (timeline)
+		fprintf(stderr, "sim: %d writes recorded to %s\n", peripheral_sim_dump_timeline(timeline), timeline);
+
+	return TIZEN_ERROR_NONE;
+}
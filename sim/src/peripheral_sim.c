@@ -0,0 +1,799 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <Ecore.h>
+#include <peripheral_io.h>
+
+#include "peripheral_sim.h"
+
+#define SIM_PIN_MAX 64
+
+/* GY30 (BH1750) */
+#define GY30_ADDR 0x23
+#define GY30_MTREG_DEFAULT 69
+
+typedef enum {
+	SIM_EVENT_GPIO = 0,
+	SIM_EVENT_LUX,
+} sim_event_type_e;
+
+typedef struct {
+	sim_event_type_e type;
+	double at;
+	int pin_num;
+	uint32_t level;
+	double lux;
+} sim_event_s;
+
+typedef struct {
+	double at;
+	int pin_num;
+	uint32_t value;
+} sim_record_s;
+
+struct _peripheral_gpio_s {
+	int pin_num;
+	peripheral_gpio_direction_e direction;
+	peripheral_gpio_edge_e edge;
+	peripheral_gpio_interrupted_cb cb;
+	void *cb_data;
+};
+
+struct _peripheral_i2c_s {
+	int bus;
+	int address;
+};
+
+struct _peripheral_pwm_s {
+	int chip;
+	int pin;
+	uint32_t period_ns;
+	uint32_t duty_ns;
+	peripheral_pwm_polarity_e polarity;
+	bool enabled;
+};
+
+static struct {
+	int initialized;
+	double epoch;
+
+	struct _peripheral_gpio_s *gpio[SIM_PIN_MAX];
+	uint32_t level[SIM_PIN_MAX];
+
+	sim_event_s *events;
+	unsigned int event_count;
+	unsigned int event_size;
+
+	sim_record_s *records;
+	unsigned int record_count;
+	unsigned int record_size;
+
+	unsigned int gpio_latency_usec;
+	unsigned int i2c_latency_usec;
+
+	peripheral_sim_write_cb write_cb;
+	void *write_cb_data;
+
+	double lux;
+
+	/* One lamp, driven by whichever PWM channel is open */
+	struct _peripheral_pwm_s *pwm;
+	double lamp_lux;
+} sim;
+
+/* The resource drivers call in from the I/O worker as well, edge callbacks run unlocked */
+static pthread_mutex_t g_sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define SIM_LOCKED(call) ({ \
+	int __ret; \
+	pthread_mutex_lock(&g_sim_lock); \
+	__ret = (call); \
+	pthread_mutex_unlock(&g_sim_lock); \
+	__ret; })
+
+/* The GY30 model: mode register, measurement time and the last finished conversion */
+static struct {
+	int powered;
+	uint8_t mode;
+	uint8_t mtreg;
+	double started;
+	uint16_t result;
+} gy30 = { 0, 0, GY30_MTREG_DEFAULT, 0.0, 0 };
+
+static void __sim_init(void)
+{
+	if (sim.initialized)
+		return;
+
+	sim.initialized = 1;
+	sim.epoch = ecore_time_get();
+}
+
+double peripheral_sim_epoch(void)
+{
+	__sim_init();
+	return sim.epoch;
+}
+
+static void __sim_spin(unsigned int usec)
+{
+	double until = 0.0;
+
+	if (!usec)
+		return;
+
+	until = ecore_time_get() + usec / 1000000.0;
+	while (ecore_time_get() < until)
+		;
+}
+
+static int __sim_add_event(const sim_event_s *event)
+{
+	unsigned int i = 0;
+
+	__sim_init();
+
+	if (sim.event_count == sim.event_size) {
+		unsigned int size = sim.event_size ? sim.event_size * 2 : 64;
+		sim_event_s *events = realloc(sim.events, size * sizeof(sim_event_s));
+		if (!events)
+			return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+		sim.events = events;
+		sim.event_size = size;
+	}
+
+	/* Kept sorted by time, events at the same time stay in insertion order */
+	i = sim.event_count;
+	while (i > 0 && sim.events[i - 1].at > event->at) {
+		sim.events[i] = sim.events[i - 1];
+		i--;
+	}
+	sim.events[i] = *event;
+	sim.event_count++;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_sim_gpio_schedule(int pin_num, double at, uint32_t level)
+{
+	sim_event_s event = { SIM_EVENT_GPIO, 0.0, pin_num, !!level, 0.0 };
+
+	if (pin_num < 0 || pin_num >= SIM_PIN_MAX)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	event.at = peripheral_sim_epoch() + at;
+	return __sim_add_event(&event);
+}
+
+int peripheral_sim_lux_schedule(double at, double lux)
+{
+	sim_event_s event = { SIM_EVENT_LUX, 0.0, -1, 0, lux };
+
+	if (lux < 0.0)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	event.at = peripheral_sim_epoch() + at;
+	return __sim_add_event(&event);
+}
+
+int peripheral_sim_gpio_set_level(int pin_num, uint32_t level)
+{
+	struct _peripheral_gpio_s *gpio = NULL;
+	uint32_t old = 0;
+	int fire = 0;
+
+	if (pin_num < 0 || pin_num >= SIM_PIN_MAX)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_init();
+
+	level = !!level;
+	pthread_mutex_lock(&g_sim_lock);
+	old = sim.level[pin_num];
+	sim.level[pin_num] = level;
+	gpio = sim.gpio[pin_num];
+	pthread_mutex_unlock(&g_sim_lock);
+
+	/* Handles and callbacks only change on the main loop, which is running this */
+	if (!gpio || gpio->direction != PERIPHERAL_GPIO_DIRECTION_IN || old == level || !gpio->cb)
+		return PERIPHERAL_ERROR_NONE;
+
+	switch (gpio->edge) {
+	case PERIPHERAL_GPIO_EDGE_RISING:
+		fire = level;
+		break;
+	case PERIPHERAL_GPIO_EDGE_FALLING:
+		fire = !level;
+		break;
+	case PERIPHERAL_GPIO_EDGE_BOTH:
+		fire = 1;
+		break;
+	default:
+		break;
+	}
+
+	if (fire)
+		gpio->cb(gpio, PERIPHERAL_ERROR_NONE, gpio->cb_data);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+int peripheral_sim_load_script(const char *path)
+{
+	FILE *fp = NULL;
+	char line[256];
+	unsigned int line_num = 0;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	if (!path)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "sim: cannot open script %s\n", path);
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char kind[16] = { 0, };
+		int pin_num = 0;
+		unsigned int level = 0;
+		double at = 0.0;
+		double lux = 0.0;
+
+		line_num++;
+		if (sscanf(line, "%15s", kind) != 1 || kind[0] == '#')
+			continue;
+
+		if (!strcmp(kind, "gpio") && sscanf(line, "%*s %d %lf %u", &pin_num, &at, &level) == 3) {
+			ret = peripheral_sim_gpio_schedule(pin_num, at, level);
+		} else if (!strcmp(kind, "lux") && sscanf(line, "%*s %lf %lf", &at, &lux) == 2) {
+			ret = peripheral_sim_lux_schedule(at, lux);
+		} else if (!strcmp(kind, "lamp") && sscanf(line, "%*s %lf", &lux) == 1) {
+			peripheral_sim_set_lamp_lux(lux);
+		} else {
+			fprintf(stderr, "sim: %s:%u: cannot parse \"%s\"\n", path, line_num, kind);
+			ret = PERIPHERAL_ERROR_INVALID_PARAMETER;
+		}
+
+		if (ret != PERIPHERAL_ERROR_NONE)
+			break;
+	}
+
+	fclose(fp);
+	return ret;
+}
+
+void peripheral_sim_set_lamp_lux(double lux)
+{
+	pthread_mutex_lock(&g_sim_lock);
+	sim.lamp_lux = lux > 0.0 ? lux : 0.0;
+	pthread_mutex_unlock(&g_sim_lock);
+}
+
+void peripheral_sim_set_latency(unsigned int gpio_usec, unsigned int i2c_usec)
+{
+	sim.gpio_latency_usec = gpio_usec;
+	sim.i2c_latency_usec = i2c_usec;
+}
+
+void peripheral_sim_set_write_cb(peripheral_sim_write_cb cb, void *data)
+{
+	sim.write_cb = cb;
+	sim.write_cb_data = data;
+}
+
+int peripheral_sim_dump_timeline(const char *path)
+{
+	FILE *fp = NULL;
+	unsigned int i = 0;
+
+	if (!path)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	fp = fopen(path, "w");
+	if (!fp)
+		return PERIPHERAL_ERROR_IO_ERROR;
+
+	fprintf(fp, "time,pin,value\n");
+	for (i = 0; i < sim.record_count; i++)
+		fprintf(fp, "%.6f,%d,%u\n", sim.records[i].at - sim.epoch, sim.records[i].pin_num, sim.records[i].value);
+
+	fclose(fp);
+	return (int) sim.record_count;
+}
+
+double peripheral_sim_next_event(void)
+{
+	if (!sim.event_count)
+		return -1.0;
+
+	return sim.events[0].at;
+}
+
+void peripheral_sim_dispatch(double now)
+{
+	while (sim.event_count && sim.events[0].at <= now) {
+		sim_event_s event = sim.events[0];
+
+		sim.event_count--;
+		memmove(&sim.events[0], &sim.events[1], sim.event_count * sizeof(sim_event_s));
+
+		if (event.type == SIM_EVENT_GPIO) {
+			peripheral_sim_gpio_set_level(event.pin_num, event.level);
+		} else {
+			pthread_mutex_lock(&g_sim_lock);
+			sim.lux = event.lux;
+			pthread_mutex_unlock(&g_sim_lock);
+		}
+	}
+}
+
+/* GPIO */
+
+static int __gpio_open(int gpio_pin, peripheral_gpio_h *gpio)
+{
+	struct _peripheral_gpio_s *handle = NULL;
+
+	if (gpio_pin < 0 || gpio_pin >= SIM_PIN_MAX || !gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_init();
+	__sim_spin(sim.gpio_latency_usec);
+
+	if (sim.gpio[gpio_pin])
+		return PERIPHERAL_ERROR_RESOURCE_BUSY;
+
+	handle = calloc(1, sizeof(struct _peripheral_gpio_s));
+	if (!handle)
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+
+	handle->pin_num = gpio_pin;
+	handle->direction = PERIPHERAL_GPIO_DIRECTION_IN;
+	sim.gpio[gpio_pin] = handle;
+	*gpio = handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_close(peripheral_gpio_h gpio)
+{
+	if (!gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	sim.gpio[gpio->pin_num] = NULL;
+	free(gpio);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_set_direction(peripheral_gpio_h gpio, peripheral_gpio_direction_e direction)
+{
+	if (!gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.gpio_latency_usec);
+
+	gpio->direction = direction;
+	if (direction == PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_HIGH)
+		sim.level[gpio->pin_num] = 1;
+	else if (direction == PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_LOW)
+		sim.level[gpio->pin_num] = 0;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_set_edge_mode(peripheral_gpio_h gpio, peripheral_gpio_edge_e edge)
+{
+	if (!gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+	if (gpio->direction != PERIPHERAL_GPIO_DIRECTION_IN)
+		return PERIPHERAL_ERROR_IO_ERROR;
+
+	gpio->edge = edge;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_set_interrupted_cb(peripheral_gpio_h gpio, peripheral_gpio_interrupted_cb callback, void *user_data)
+{
+	if (!gpio || !callback)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	gpio->cb = callback;
+	gpio->cb_data = user_data;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_unset_interrupted_cb(peripheral_gpio_h gpio)
+{
+	if (!gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	gpio->cb = NULL;
+	gpio->cb_data = NULL;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_read(peripheral_gpio_h gpio, uint32_t *value)
+{
+	if (!gpio || !value)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.gpio_latency_usec);
+
+	*value = sim.level[gpio->pin_num];
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __gpio_write(peripheral_gpio_h gpio, uint32_t value)
+{
+	sim_record_s *record = NULL;
+
+	if (!gpio)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+	if (gpio->direction == PERIPHERAL_GPIO_DIRECTION_IN)
+		return PERIPHERAL_ERROR_IO_ERROR;
+
+	__sim_spin(sim.gpio_latency_usec);
+
+	value = !!value;
+	sim.level[gpio->pin_num] = value;
+
+	if (sim.record_count == sim.record_size) {
+		unsigned int size = sim.record_size ? sim.record_size * 2 : 1024;
+		sim_record_s *records = realloc(sim.records, size * sizeof(sim_record_s));
+		if (!records)
+			return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+		sim.records = records;
+		sim.record_size = size;
+	}
+
+	record = &sim.records[sim.record_count++];
+	record->at = ecore_time_get();
+	record->pin_num = gpio->pin_num;
+	record->value = value;
+
+	if (sim.write_cb)
+		sim.write_cb(gpio->pin_num, value, record->at, sim.write_cb_data);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+/* I2C */
+
+static double __gy30_conversion_time(void)
+{
+	double base = ((gy30.mode & 0x03) == 0x03) ? 0.016 : 0.120;
+
+	return base * gy30.mtreg / GY30_MTREG_DEFAULT;
+}
+
+/* The light the lamp adds right now, following its duty cycle */
+static double __lamp_lux(void)
+{
+	const struct _peripheral_pwm_s *pwm = sim.pwm;
+	double on = 0.0;
+
+	if (!pwm || !pwm->enabled || !pwm->period_ns)
+		return 0.0;
+
+	on = (double) pwm->duty_ns / pwm->period_ns;
+	if (pwm->polarity == PERIPHERAL_PWM_POLARITY_ACTIVE_LOW)
+		on = 1.0 - on;
+
+	return sim.lamp_lux * on;
+}
+
+static void __gy30_update(double now)
+{
+	double counts = 0.0;
+
+	if (!gy30.powered || !gy30.mode || now - gy30.started < __gy30_conversion_time())
+		return;
+
+	counts = (sim.lux + __lamp_lux()) * 1.2 * gy30.mtreg / GY30_MTREG_DEFAULT;
+	if ((gy30.mode & 0x03) == 0x01)
+		counts *= 2.0;
+	gy30.result = counts > 65535.0 ? 65535 : (uint16_t) counts;
+
+	if (gy30.mode & 0x20) {
+		/* One time modes power down after a single conversion */
+		gy30.powered = 0;
+		gy30.mode = 0;
+	} else {
+		gy30.started = now;
+	}
+}
+
+static int __gy30_write(uint8_t opcode)
+{
+	double now = ecore_time_get();
+
+	if (opcode == 0x00) {
+		gy30.powered = 0;
+		gy30.mode = 0;
+	} else if (opcode == 0x01) {
+		gy30.powered = 1;
+	} else if (opcode == 0x07) {
+		if (!gy30.powered)
+			return PERIPHERAL_ERROR_IO_ERROR;
+		gy30.result = 0;
+	} else if ((opcode & 0xf8) == 0x40) {
+		gy30.mtreg = (gy30.mtreg & 0x1f) | ((opcode & 0x07) << 5);
+	} else if ((opcode & 0xe0) == 0x60) {
+		gy30.mtreg = (gy30.mtreg & 0xe0) | (opcode & 0x1f);
+	} else if (opcode == 0x10 || opcode == 0x11 || opcode == 0x13
+			|| opcode == 0x20 || opcode == 0x21 || opcode == 0x23) {
+		gy30.powered = 1;
+		gy30.mode = opcode;
+		gy30.started = now;
+	} else {
+		return PERIPHERAL_ERROR_IO_ERROR;
+	}
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __i2c_open(int bus, int address, peripheral_i2c_h *i2c)
+{
+	struct _peripheral_i2c_s *handle = NULL;
+
+	if (bus < 0 || address < 0 || address > 0x7f || !i2c)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_init();
+	__sim_spin(sim.i2c_latency_usec);
+
+	handle = calloc(1, sizeof(struct _peripheral_i2c_s));
+	if (!handle)
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+
+	handle->bus = bus;
+	handle->address = address;
+	*i2c = handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __i2c_close(peripheral_i2c_h i2c)
+{
+	if (!i2c)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	free(i2c);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __i2c_read(peripheral_i2c_h i2c, uint8_t *data, uint32_t length)
+{
+	uint32_t i = 0;
+
+	if (!i2c || !data || !length)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.i2c_latency_usec);
+
+	/* Only the GY30 answers, anything else NAKs */
+	if (i2c->address != GY30_ADDR)
+		return PERIPHERAL_ERROR_IO_ERROR;
+
+	__gy30_update(ecore_time_get());
+
+	for (i = 0; i < length; i++)
+		data[i] = (i % 2) ? (gy30.result & 0xff) : (gy30.result >> 8);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __i2c_write(peripheral_i2c_h i2c, uint8_t *data, uint32_t length)
+{
+	uint32_t i = 0;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	if (!i2c || !data || !length)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.i2c_latency_usec);
+
+	if (i2c->address != GY30_ADDR)
+		return PERIPHERAL_ERROR_IO_ERROR;
+
+	for (i = 0; i < length && ret == PERIPHERAL_ERROR_NONE; i++)
+		ret = __gy30_write(data[i]);
+
+	return ret;
+}
+
+/* PWM */
+
+static int __pwm_open(int chip, int pin, peripheral_pwm_h *pwm)
+{
+	struct _peripheral_pwm_s *handle = NULL;
+
+	if (chip < 0 || pin < 0 || !pwm)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_init();
+	__sim_spin(sim.gpio_latency_usec);
+
+	if (sim.pwm)
+		return PERIPHERAL_ERROR_RESOURCE_BUSY;
+
+	handle = calloc(1, sizeof(struct _peripheral_pwm_s));
+	if (!handle)
+		return PERIPHERAL_ERROR_OUT_OF_MEMORY;
+
+	handle->chip = chip;
+	handle->pin = pin;
+	sim.pwm = handle;
+	*pwm = handle;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __pwm_close(peripheral_pwm_h pwm)
+{
+	if (!pwm)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	if (sim.pwm == pwm)
+		sim.pwm = NULL;
+	free(pwm);
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __pwm_set_period(peripheral_pwm_h pwm, uint32_t period_ns)
+{
+	/* Like sysfs, the period cannot go below the duty cycle */
+	if (!pwm || !period_ns || period_ns < pwm->duty_ns)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.gpio_latency_usec);
+	pwm->period_ns = period_ns;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __pwm_set_duty_cycle(peripheral_pwm_h pwm, uint32_t duty_cycle_ns)
+{
+	if (!pwm || duty_cycle_ns > pwm->period_ns)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	__sim_spin(sim.gpio_latency_usec);
+	pwm->duty_ns = duty_cycle_ns;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __pwm_set_polarity(peripheral_pwm_h pwm, peripheral_pwm_polarity_e polarity)
+{
+	if (!pwm || polarity > PERIPHERAL_PWM_POLARITY_ACTIVE_LOW)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	pwm->polarity = polarity;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+static int __pwm_set_enabled(peripheral_pwm_h pwm, bool enable)
+{
+	if (!pwm)
+		return PERIPHERAL_ERROR_INVALID_PARAMETER;
+
+	pwm->enabled = enable;
+
+	return PERIPHERAL_ERROR_NONE;
+}
+
+/* Entry points, serialized against the main loop and the I/O worker */
+
+int peripheral_gpio_open(int gpio_pin, peripheral_gpio_h *gpio)
+{
+	return SIM_LOCKED(__gpio_open(gpio_pin, gpio));
+}
+
+int peripheral_gpio_close(peripheral_gpio_h gpio)
+{
+	return SIM_LOCKED(__gpio_close(gpio));
+}
+
+int peripheral_gpio_set_direction(peripheral_gpio_h gpio, peripheral_gpio_direction_e direction)
+{
+	return SIM_LOCKED(__gpio_set_direction(gpio, direction));
+}
+
+int peripheral_gpio_set_edge_mode(peripheral_gpio_h gpio, peripheral_gpio_edge_e edge)
+{
+	return SIM_LOCKED(__gpio_set_edge_mode(gpio, edge));
+}
+
+int peripheral_gpio_set_interrupted_cb(peripheral_gpio_h gpio, peripheral_gpio_interrupted_cb callback, void *user_data)
+{
+	return SIM_LOCKED(__gpio_set_interrupted_cb(gpio, callback, user_data));
+}
+
+int peripheral_gpio_unset_interrupted_cb(peripheral_gpio_h gpio)
+{
+	return SIM_LOCKED(__gpio_unset_interrupted_cb(gpio));
+}
+
+int peripheral_gpio_read(peripheral_gpio_h gpio, uint32_t *value)
+{
+	return SIM_LOCKED(__gpio_read(gpio, value));
+}
+
+int peripheral_gpio_write(peripheral_gpio_h gpio, uint32_t value)
+{
+	return SIM_LOCKED(__gpio_write(gpio, value));
+}
+
+int peripheral_i2c_open(int bus, int address, peripheral_i2c_h *i2c)
+{
+	return SIM_LOCKED(__i2c_open(bus, address, i2c));
+}
+
+int peripheral_i2c_close(peripheral_i2c_h i2c)
+{
+	return SIM_LOCKED(__i2c_close(i2c));
+}
+
+int peripheral_i2c_read(peripheral_i2c_h i2c, uint8_t *data, uint32_t length)
+{
+	return SIM_LOCKED(__i2c_read(i2c, data, length));
+}
+
+int peripheral_i2c_write(peripheral_i2c_h i2c, uint8_t *data, uint32_t length)
+{
+	return SIM_LOCKED(__i2c_write(i2c, data, length));
+}
+
+int peripheral_pwm_open(int chip, int pin, peripheral_pwm_h *pwm)
+{
+	return SIM_LOCKED(__pwm_open(chip, pin, pwm));
+}
+
+int peripheral_pwm_close(peripheral_pwm_h pwm)
+{
+	return SIM_LOCKED(__pwm_close(pwm));
+}
+
+int peripheral_pwm_set_period(peripheral_pwm_h pwm, uint32_t period_ns)
+{
+	return SIM_LOCKED(__pwm_set_period(pwm, period_ns));
+}
+
+int peripheral_pwm_set_duty_cycle(peripheral_pwm_h pwm, uint32_t duty_cycle_ns)
+{
+	return SIM_LOCKED(__pwm_set_duty_cycle(pwm, duty_cycle_ns));
+}
+
+int peripheral_pwm_set_polarity(peripheral_pwm_h pwm, peripheral_pwm_polarity_e polarity)
+{
+	return SIM_LOCKED(__pwm_set_polarity(pwm, polarity));
+}
+
+int peripheral_pwm_set_enabled(peripheral_pwm_h pwm, bool enable)
+{
+	return SIM_LOCKED(__pwm_set_enabled(pwm, enable));
+}
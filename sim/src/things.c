@@ -0,0 +1,288 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <dlog.h>
+
+#include "st_things.h"
+
+/*
+ * Host stand-in for the things stack.
+ * Notifications are counted and logged. With $LEDSW_SIM_THINGS_GET set to a period in seconds,
+ * a thread of its own sends GET requests like the cloud would, for every "uri?key1;key2"
+ * listed in $LEDSW_SIM_THINGS_URIS.
+ */
+
+#define THINGS_TAG "THINGS"
+#define THINGS_URI_MAX 8
+
+typedef struct {
+	char *uri;
+	char *keys; /* ';' separated, with a leading and a trailing ';' for lookups */
+} things_target_s;
+
+static struct {
+	int initialized;
+	int started;
+	int stopping;
+	pthread_t thread;
+	st_things_get_request_cb get_cb;
+	st_things_set_request_cb set_cb;
+	double get_period;
+	things_target_s targets[THINGS_URI_MAX];
+	unsigned int target_count;
+	unsigned int notifications;
+	unsigned int gets;
+	unsigned int gets_failed;
+} things;
+
+static bool __has_property_key(st_things_get_request_message_s *req_msg, const char *key)
+{
+	char pattern[64];
+
+	snprintf(pattern, sizeof(pattern), ";%s;", key);
+	return strstr(req_msg->property_key, pattern) != NULL;
+}
+
+static bool __get_query_value(st_things_get_request_message_s *req_msg, const char *key, char **value)
+{
+	return false;
+}
+
+static bool __set_str_value(st_things_representation_s *rep, const char *key, const char *value)
+{
+	dlog_print(DLOG_INFO, THINGS_TAG, "GET %s : %s = %s\n", (char *) rep->payload, key, value);
+	return true;
+}
+
+static bool __set_int_value(st_things_representation_s *rep, const char *key, int64_t value)
+{
+	dlog_print(DLOG_INFO, THINGS_TAG, "GET %s : %s = %lld\n", (char *) rep->payload, key, (long long) value);
+	return true;
+}
+
+static bool __set_double_value(st_things_representation_s *rep, const char *key, double value)
+{
+	dlog_print(DLOG_INFO, THINGS_TAG, "GET %s : %s = %f\n", (char *) rep->payload, key, value);
+	return true;
+}
+
+static bool __set_bool_value(st_things_representation_s *rep, const char *key, bool value)
+{
+	dlog_print(DLOG_INFO, THINGS_TAG, "GET %s : %s = %s\n", (char *) rep->payload, key, value ? "true" : "false");
+	return true;
+}
+
+static void *__get_thread(void *data)
+{
+	struct timespec period;
+
+	period.tv_sec = (time_t) things.get_period;
+	period.tv_nsec = (long) ((things.get_period - period.tv_sec) * 1000000000.0);
+
+	while (!__atomic_load_n(&things.stopping, __ATOMIC_ACQUIRE)) {
+		unsigned int i = 0;
+
+		nanosleep(&period, NULL);
+
+		for (i = 0; i < things.target_count && things.get_cb; i++) {
+			st_things_get_request_message_s req_msg = { 0, };
+			st_things_representation_s rep = { 0, };
+
+			req_msg.resource_uri = things.targets[i].uri;
+			req_msg.property_key = things.targets[i].keys;
+			req_msg.get_query_value = __get_query_value;
+			req_msg.has_property_key = __has_property_key;
+
+			rep.payload = things.targets[i].uri;
+			rep.set_str_value = __set_str_value;
+			rep.set_int_value = __set_int_value;
+			rep.set_double_value = __set_double_value;
+			rep.set_bool_value = __set_bool_value;
+
+			__atomic_add_fetch(&things.gets, 1, __ATOMIC_RELAXED);
+			if (!things.get_cb(&req_msg, &rep))
+				__atomic_add_fetch(&things.gets_failed, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+static void __load_targets(void)
+{
+	const char *env = getenv("LEDSW_SIM_THINGS_URIS");
+	char *list = NULL;
+	char *save = NULL;
+	char *item = NULL;
+
+	if (!env)
+		return;
+
+	list = strdup(env);
+	if (!list)
+		return;
+
+	for (item = strtok_r(list, " ", &save); item && things.target_count < THINGS_URI_MAX; item = strtok_r(NULL, " ", &save)) {
+		things_target_s *target = &things.targets[things.target_count];
+		char *keys = strchr(item, '?');
+		size_t size = 0;
+
+		if (keys)
+			*keys++ = '\0';
+		else
+			keys = "";
+
+		size = strlen(keys) + 3;
+		target->uri = strdup(item);
+		target->keys = malloc(size);
+		if (!target->uri || !target->keys) {
+			free(target->uri);
+			free(target->keys);
+			break;
+		}
+		snprintf(target->keys, size, ";%s;", keys);
+		things.target_count++;
+	}
+
+	free(list);
+}
+
+int st_things_set_configuration_prefix_path(const char *ro_path, const char *rw_path)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_initialize(const char *json_path, bool *easysetup_complete)
+{
+	const char *env = getenv("LEDSW_SIM_THINGS_GET");
+
+	if (!json_path)
+		return ST_THINGS_ERROR_INVALID_PARAMETER;
+	if (things.initialized)
+		return ST_THINGS_ERROR_STACK_ALREADY_INITIALIZED;
+
+	things.initialized = 1;
+	things.get_period = env ? atof(env) : 0.0;
+	__load_targets();
+
+	if (easysetup_complete)
+		*easysetup_complete = true;
+
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_deinitialize(void)
+{
+	unsigned int i = 0;
+
+	if (!things.initialized)
+		return ST_THINGS_ERROR_STACK_NOT_INITIALIZED;
+	if (things.started)
+		return ST_THINGS_ERROR_STACK_RUNNING;
+
+	fprintf(stderr, "things: %u notifications, %u get requests, %u failed\n",
+			things.notifications, things.gets, things.gets_failed);
+
+	for (i = 0; i < things.target_count; i++) {
+		free(things.targets[i].uri);
+		free(things.targets[i].keys);
+	}
+	memset(&things, 0, sizeof(things));
+
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_register_request_cb(st_things_get_request_cb get_cb, st_things_set_request_cb set_cb)
+{
+	if (!things.initialized)
+		return ST_THINGS_ERROR_STACK_NOT_INITIALIZED;
+
+	things.get_cb = get_cb;
+	things.set_cb = set_cb;
+
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_start(void)
+{
+	if (!things.initialized)
+		return ST_THINGS_ERROR_STACK_NOT_INITIALIZED;
+	if (things.started)
+		return ST_THINGS_ERROR_STACK_RUNNING;
+
+	things.stopping = 0;
+	if (things.get_period > 0.0 && pthread_create(&things.thread, NULL, __get_thread, NULL))
+		return ST_THINGS_ERROR_OPERATION_FAILED;
+
+	things.started = 1;
+
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_stop(void)
+{
+	if (!things.started)
+		return ST_THINGS_ERROR_STACK_NOT_STARTED;
+
+	if (things.get_period > 0.0) {
+		__atomic_store_n(&things.stopping, 1, __ATOMIC_RELEASE);
+		pthread_join(things.thread, NULL);
+	}
+	things.started = 0;
+
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_register_reset_cb(st_things_reset_confirm_cb confirm_cb, st_things_reset_result_cb result_cb)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_reset(void)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_register_pin_handling_cb(st_things_pin_generated_cb generated_cb, st_things_pin_display_close_cb close_cb)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_register_user_confirm_cb(st_things_user_confirm_cb confirm_cb)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_register_things_status_change_cb(st_things_status_change_cb status_cb)
+{
+	return ST_THINGS_ERROR_NONE;
+}
+
+int st_things_notify_observers(const char *resource_uri)
+{
+	if (!resource_uri)
+		return ST_THINGS_ERROR_INVALID_PARAMETER;
+	if (!things.started)
+		return ST_THINGS_ERROR_STACK_NOT_STARTED;
+
+	things.notifications++;
+	dlog_print(DLOG_INFO, THINGS_TAG, "notify %s\n", resource_uri);
+
+	return ST_THINGS_ERROR_NONE;
+}
@@ -0,0 +1,401 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlog.h>
+#include <tizen.h>
+#include <Ecore.h>
+
+#include "test.h"
+
+/* Test replacements for dlog, Ecore and the app paths, time only moves through test_clock_advance() */
+
+#define TEST_CLOCK_START 1000.0
+
+typedef enum {
+	FAKE_TASK_TIMER = 0,
+	FAKE_TASK_JOB,
+	FAKE_TASK_IDLE_ENTERER,
+} fake_task_type_e;
+
+struct _Ecore_Timer {
+	fake_task_type_e type;
+	double interval;
+	double deadline;
+	Ecore_Task_Cb func;
+	Ecore_Cb job_func;
+	void *data;
+	int deleted;
+	struct _Ecore_Timer *next;
+};
+
+typedef struct _fake_async_call_s {
+	Ecore_Cb func;
+	void *data;
+	struct _fake_async_call_s *next;
+} fake_async_call_s;
+
+int test_failures = 0;
+
+static struct _Ecore_Timer *g_tasks = NULL;
+static double g_now = TEST_CLOCK_START;
+static int g_fail_adds = 0;
+static struct {
+	pthread_mutex_t lock;
+	fake_async_call_s *head;
+	fake_async_call_s **tail;
+} g_async = { PTHREAD_MUTEX_INITIALIZER, NULL, &g_async.head };
+
+static test_dlog_cb g_dlog_cb = NULL;
+static void *g_dlog_cb_data = NULL;
+
+void test_dlog_capture(test_dlog_cb cb, void *data)
+{
+	g_dlog_cb_data = data;
+	__atomic_store_n(&g_dlog_cb, cb, __ATOMIC_RELEASE);
+}
+
+int dlog_vprint(log_priority prio, const char *tag, const char *fmt, va_list ap)
+{
+	const char *env = getenv("LEDSW_TEST_LOG");
+	int level = env ? atoi(env) : DLOG_SILENT;
+	test_dlog_cb cb = __atomic_load_n(&g_dlog_cb, __ATOMIC_ACQUIRE);
+	char line[1024];
+
+	vsnprintf(line, sizeof(line), fmt, ap);
+	if (cb)
+		cb(prio, tag, line, g_dlog_cb_data);
+
+	if ((int) prio < level)
+		return 0;
+
+	fprintf(stderr, "    %s: %s", tag, line);
+	return 0;
+}
+
+int dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+{
+	va_list ap;
+	int ret = 0;
+
+	va_start(ap, fmt);
+	ret = dlog_vprint(prio, tag, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+const char *get_error_message(int err)
+{
+	return err ? "Error" : "Successful";
+}
+
+char *app_get_data_path(void)
+{
+	const char *env = getenv("LEDSW_TEST_DATA");
+	char *path = NULL;
+
+	if (asprintf(&path, "%s/", env && *env ? env : ".") < 0)
+		return NULL;
+
+	return path;
+}
+
+char *app_get_resource_path(void)
+{
+	return app_get_data_path();
+}
+
+double ecore_time_get(void)
+{
+	return g_now;
+}
+
+double ecore_loop_time_get(void)
+{
+	return g_now;
+}
+
+static struct _Ecore_Timer *__task_add(fake_task_type_e type, double in, const void *data)
+{
+	struct _Ecore_Timer *task = calloc(1, sizeof(struct _Ecore_Timer));
+	struct _Ecore_Timer **link = &g_tasks;
+
+	if (g_fail_adds > 0) {
+		g_fail_adds--;
+		free(task);
+		return NULL;
+	}
+
+	if (!task)
+		return NULL;
+
+	task->type = type;
+	task->interval = in;
+	task->deadline = g_now + in;
+	task->data = (void *) data;
+
+	while (*link)
+		link = &(*link)->next;
+	*link = task;
+
+	return task;
+}
+
+static void *__task_del(struct _Ecore_Timer *task)
+{
+	if (!task || task->deleted)
+		return NULL;
+
+	task->deleted = 1;
+	return task->data;
+}
+
+Ecore_Timer *ecore_timer_add(double in, Ecore_Task_Cb func, const void *data)
+{
+	struct _Ecore_Timer *timer = NULL;
+
+	if (!func || in < 0.0)
+		return NULL;
+
+	timer = __task_add(FAKE_TASK_TIMER, in, data);
+	if (timer)
+		timer->func = func;
+
+	return timer;
+}
+
+void *ecore_timer_del(Ecore_Timer *timer)
+{
+	return __task_del(timer);
+}
+
+void ecore_timer_interval_set(Ecore_Timer *timer, double in)
+{
+	if (timer && in >= 0.0)
+		timer->interval = in;
+}
+
+double ecore_timer_interval_get(const Ecore_Timer *timer)
+{
+	return timer ? timer->interval : -1.0;
+}
+
+void ecore_timer_reset(Ecore_Timer *timer)
+{
+	if (timer)
+		timer->deadline = g_now + timer->interval;
+}
+
+Ecore_Job *ecore_job_add(Ecore_Cb func, const void *data)
+{
+	struct _Ecore_Timer *job = NULL;
+
+	if (!func)
+		return NULL;
+
+	job = __task_add(FAKE_TASK_JOB, 0.0, data);
+	if (job)
+		job->job_func = func;
+
+	return job;
+}
+
+void *ecore_job_del(Ecore_Job *job)
+{
+	return __task_del(job);
+}
+
+Ecore_Idle_Enterer *ecore_idle_enterer_add(Ecore_Task_Cb func, const void *data)
+{
+	struct _Ecore_Timer *idle_enterer = NULL;
+
+	if (!func)
+		return NULL;
+
+	idle_enterer = __task_add(FAKE_TASK_IDLE_ENTERER, 0.0, data);
+	if (idle_enterer)
+		idle_enterer->func = func;
+
+	return idle_enterer;
+}
+
+void *ecore_idle_enterer_del(Ecore_Idle_Enterer *idle_enterer)
+{
+	return __task_del(idle_enterer);
+}
+
+void ecore_main_loop_begin(void)
+{
+}
+
+void ecore_main_loop_quit(void)
+{
+}
+
+void ecore_main_loop_thread_safe_call_async(Ecore_Cb callback, void *data)
+{
+	fake_async_call_s *call = NULL;
+
+	if (!callback)
+		return;
+
+	call = calloc(1, sizeof(fake_async_call_s));
+	if (!call)
+		return;
+	call->func = callback;
+	call->data = data;
+
+	pthread_mutex_lock(&g_async.lock);
+	*g_async.tail = call;
+	g_async.tail = &call->next;
+	pthread_mutex_unlock(&g_async.lock);
+}
+
+static void __tasks_collect(void)
+{
+	struct _Ecore_Timer **link = &g_tasks;
+
+	while (*link) {
+		struct _Ecore_Timer *task = *link;
+		if (task->deleted) {
+			*link = task->next;
+			free(task);
+		} else {
+			link = &task->next;
+		}
+	}
+}
+
+static void __task_run(struct _Ecore_Timer *task)
+{
+	if (task->type == FAKE_TASK_JOB) {
+		task->deleted = 1;
+		task->job_func(task->data);
+	} else if (!task->func(task->data)) {
+		task->deleted = 1;
+	} else if (task->type == FAKE_TASK_TIMER && !task->deleted) {
+		task->deadline += task->interval;
+		if (task->deadline < g_now)
+			task->deadline = g_now + task->interval;
+	}
+}
+
+/* Runs the tasks of the type that exist now, those added meanwhile wait for the next pass */
+static void __tasks_run(fake_task_type_e type)
+{
+	struct _Ecore_Timer *task = NULL;
+	struct _Ecore_Timer *last = g_tasks;
+
+	while (last && last->next)
+		last = last->next;
+
+	for (task = g_tasks; task; task = task->next) {
+		if (!task->deleted && task->type == type)
+			__task_run(task);
+		if (task == last)
+			break;
+	}
+}
+
+static void __async_run(void)
+{
+	fake_async_call_s *call = NULL;
+
+	pthread_mutex_lock(&g_async.lock);
+	call = g_async.head;
+	g_async.head = NULL;
+	g_async.tail = &g_async.head;
+	pthread_mutex_unlock(&g_async.lock);
+
+	while (call) {
+		fake_async_call_s *next = call->next;
+		call->func(call->data);
+		free(call);
+		call = next;
+	}
+}
+
+void test_loop_iterate(void)
+{
+	__async_run();
+	__tasks_run(FAKE_TASK_JOB);
+	__tasks_collect();
+	__tasks_run(FAKE_TASK_IDLE_ENTERER);
+	__tasks_collect();
+}
+
+void test_loop_reset(void)
+{
+	struct _Ecore_Timer *task = NULL;
+
+	for (task = g_tasks; task; task = task->next)
+		task->deleted = 1;
+	__tasks_collect();
+
+	pthread_mutex_lock(&g_async.lock);
+	while (g_async.head) {
+		fake_async_call_s *next = g_async.head->next;
+		free(g_async.head);
+		g_async.head = next;
+	}
+	g_async.tail = &g_async.head;
+	pthread_mutex_unlock(&g_async.lock);
+
+	g_now = TEST_CLOCK_START;
+	g_fail_adds = 0;
+}
+
+void test_ecore_fail_adds(int count)
+{
+	g_fail_adds = count;
+}
+
+double test_clock_now(void)
+{
+	return g_now;
+}
+
+void test_clock_advance(double seconds)
+{
+	double target = g_now + seconds;
+
+	test_loop_iterate();
+
+	for (;;) {
+		struct _Ecore_Timer *task = NULL;
+		struct _Ecore_Timer *due = NULL;
+
+		for (task = g_tasks; task; task = task->next) {
+			if (!task->deleted && task->type == FAKE_TASK_TIMER && task->deadline <= target
+					&& (!due || task->deadline < due->deadline))
+				due = task;
+		}
+		if (!due)
+			break;
+
+		if (due->deadline > g_now)
+			g_now = due->deadline;
+		__task_run(due);
+		__tasks_collect();
+		test_loop_iterate();
+	}
+
+	g_now = target;
+	test_loop_iterate();
+}
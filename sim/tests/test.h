@@ -0,0 +1,104 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SIM_TEST_H__
+#define __SIM_TEST_H__
+
+#include <stdio.h>
+#include <math.h>
+
+/* Host assertion tests, linked against fake_host.c whose Ecore runs on a virtual clock */
+
+extern int test_failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_INT(actual, expected) do { \
+	long long __a = (long long) (actual); \
+	long long __e = (long long) (expected); \
+	if (__a != __e) { \
+		fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, __a, __e); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_NEAR(actual, expected, eps) do { \
+	double __a = (actual); \
+	double __e = (expected); \
+	if (!(fabs(__a - __e) <= (eps))) { \
+		fprintf(stderr, "%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, #actual, __a, __e); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_STR(actual, expected) do { \
+	const char *__a = (actual); \
+	const char *__e = (expected); \
+	if (!__a || strcmp(__a, __e)) { \
+		fprintf(stderr, "%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, __a ? __a : "(null)", __e); \
+		test_failures++; \
+	} \
+} while (0)
+
+#define TEST_RUN(test) do { \
+	int __before = test_failures; \
+	test_loop_reset(); \
+	test(); \
+	fprintf(stderr, "%s %s\n", test_failures == __before ? "  ok  " : "  FAIL", #test); \
+} while (0)
+
+#define TEST_EXIT() (test_failures ? 1 : 0)
+
+/**
+ * @brief Drops every pending timer, job, idle enterer and async call and rewinds the clock to 1000 s.
+ */
+extern void test_loop_reset(void);
+
+/**
+ * @brief Returns the virtual time ecore_time_get() reports.
+ */
+extern double test_clock_now(void);
+
+/**
+ * @brief Moves the clock forward, running every timer that falls due in deadline order.
+ * @param[in] seconds How far to move, the jobs and idle enterers run after each timer and at the end
+ */
+extern void test_clock_advance(double seconds);
+
+/**
+ * @brief Runs one loop iteration without moving the clock, for jobs, async calls and idle enterers.
+ */
+extern void test_loop_iterate(void);
+
+typedef void (*test_dlog_cb)(int prio, const char *tag, const char *line, void *data);
+
+/**
+ * @brief Hands every dlog line to a callback too, on whichever thread logged it.
+ * @param[in] cb The callback, NULL stops capturing
+ * @param[in] data The data passed to cb
+ */
+extern void test_dlog_capture(test_dlog_cb cb, void *data);
+
+/**
+ * @brief Makes the next timer, job or idle enterer additions fail, like Ecore out of memory.
+ * @param[in] count How many additions fail
+ */
+extern void test_ecore_fail_adds(int count);
+
+#endif /* __SIM_TEST_H__ */
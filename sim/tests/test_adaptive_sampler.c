@@ -0,0 +1,185 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "adaptive-sampler.h"
+#include "test.h"
+
+#define TICKS_MAX 16
+
+static const adaptive_sampler_config_s g_config = { 0.1, 0.8, 2.0 };
+
+/* The samples taken, in seconds since the sampler started */
+static struct {
+	int count;
+	double at[TICKS_MAX];
+	int activity; /* What the next samples report */
+	double start;
+} g_ticks;
+
+static int __sample_cb(void *data)
+{
+	if (g_ticks.count < TICKS_MAX)
+		g_ticks.at[g_ticks.count] = test_clock_now() - g_ticks.start;
+	g_ticks.count++;
+
+	return g_ticks.activity;
+}
+
+static adaptive_sampler *__start(const adaptive_sampler_config_s *config)
+{
+	memset(&g_ticks, 0, sizeof(g_ticks));
+	g_ticks.start = test_clock_now();
+
+	return adaptive_sampler_start(config, __sample_cb, NULL);
+}
+
+/* Quiet samples until the slowest rate, the last one was just taken */
+static void __back_off(adaptive_sampler *sampler)
+{
+	test_clock_advance(1.5);
+	CHECK_INT(g_ticks.count, 4);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.8, 1e-9);
+	g_ticks.count = 0;
+	g_ticks.start = test_clock_now();
+}
+
+static void test_backs_off_to_the_slowest_rate(void)
+{
+	adaptive_sampler *sampler = __start(&g_config);
+
+	CHECK(sampler != NULL);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.1, 1e-9);
+
+	/* Doubles after each quiet sample, up to the slowest interval and no further */
+	test_clock_advance(2.35);
+	CHECK_INT(g_ticks.count, 5);
+	CHECK_NEAR(g_ticks.at[0], 0.1, 1e-9);
+	CHECK_NEAR(g_ticks.at[1], 0.3, 1e-9);
+	CHECK_NEAR(g_ticks.at[2], 0.7, 1e-9);
+	CHECK_NEAR(g_ticks.at[3], 1.5, 1e-9);
+	CHECK_NEAR(g_ticks.at[4], 2.3, 1e-9);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.8, 1e-9);
+
+	adaptive_sampler_stop(sampler);
+	test_clock_advance(2.0);
+	CHECK_INT(g_ticks.count, 5);
+}
+
+static void test_activity_snaps_to_the_fastest_rate(void)
+{
+	adaptive_sampler *sampler = __start(&g_config);
+
+	__back_off(sampler);
+
+	/* One busy sample is enough, the quiet ones after it start backing off again */
+	g_ticks.activity = 1;
+	test_clock_advance(0.85);
+	CHECK_INT(g_ticks.count, 1);
+	CHECK_NEAR(g_ticks.at[0], 0.8, 1e-9);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.1, 1e-9);
+
+	g_ticks.activity = 0;
+	test_clock_advance(0.3);
+	CHECK_INT(g_ticks.count, 3);
+	CHECK_NEAR(g_ticks.at[1], 0.9, 1e-9);
+	CHECK_NEAR(g_ticks.at[2], 1.1, 1e-9);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.4, 1e-9);
+
+	adaptive_sampler_stop(sampler);
+}
+
+static void test_poke_cuts_a_long_wait_short(void)
+{
+	adaptive_sampler *sampler = __start(&g_config);
+
+	__back_off(sampler);
+
+	/* The next sample comes after the fastest interval, not the rest of the slow one */
+	test_clock_advance(0.3);
+	adaptive_sampler_poke(sampler);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.1, 1e-9);
+	g_ticks.activity = 1;
+	test_clock_advance(0.15);
+	CHECK_INT(g_ticks.count, 1);
+	CHECK_NEAR(g_ticks.at[0], 0.4, 1e-9);
+
+	/* Already at the fastest rate, a poke does not push the next sample back */
+	test_clock_advance(0.13);
+	CHECK_INT(g_ticks.count, 2);
+	adaptive_sampler_poke(sampler);
+	test_clock_advance(0.09);
+	CHECK_INT(g_ticks.count, 3);
+	CHECK_NEAR(g_ticks.at[2], 0.6, 1e-9);
+
+	adaptive_sampler_stop(sampler);
+}
+
+static void test_min_interval_moves(void)
+{
+	adaptive_sampler *sampler = __start(&g_config);
+	adaptive_sampler_config_s config = g_config;
+
+	/* The interval follows a slower fastest rate, the timer armed before still fires once */
+	CHECK_INT(adaptive_sampler_set_min_interval(sampler, 0.5), 0);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.5, 1e-9);
+	test_clock_advance(0.15);
+	CHECK_INT(g_ticks.count, 1);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.8, 1e-9);
+
+	/* Activity goes no faster than it */
+	g_ticks.activity = 1;
+	test_clock_advance(1.3);
+	CHECK_INT(g_ticks.count, 3);
+	CHECK_NEAR(g_ticks.at[1], 0.9, 1e-9);
+	CHECK_NEAR(g_ticks.at[2], 1.4, 1e-9);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.5, 1e-9);
+
+	/* Past the slowest rate, that one is raised too */
+	CHECK_INT(adaptive_sampler_set_min_interval(sampler, 1.0), 0);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 1.0, 1e-9);
+	g_ticks.activity = 0;
+	test_clock_advance(2.0);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 1.0, 1e-9);
+
+	/* And back, the slowest rate keeps what it was raised to */
+	CHECK_INT(adaptive_sampler_set_min_interval(sampler, 0.1), 0);
+	adaptive_sampler_poke(sampler);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 0.1, 1e-9);
+	test_clock_advance(2.0);
+	CHECK_NEAR(adaptive_sampler_get_interval(sampler), 1.0, 1e-9);
+
+	CHECK(adaptive_sampler_set_min_interval(sampler, 0.0) < 0);
+	CHECK(adaptive_sampler_set_min_interval(NULL, 0.1) < 0);
+	CHECK(adaptive_sampler_get_interval(NULL) < 0.0);
+	adaptive_sampler_stop(sampler);
+
+	config.backoff = 0.5;
+	CHECK(adaptive_sampler_start(&config, __sample_cb, NULL) == NULL);
+	config = g_config;
+	config.max_interval = 0.05;
+	CHECK(adaptive_sampler_start(&config, __sample_cb, NULL) == NULL);
+	CHECK(adaptive_sampler_start(&g_config, NULL, NULL) == NULL);
+}
+
+int main(void)
+{
+	TEST_RUN(test_backs_off_to_the_slowest_rate);
+	TEST_RUN(test_activity_snaps_to_the_fastest_rate);
+	TEST_RUN(test_poke_cuts_a_long_wait_short);
+	TEST_RUN(test_min_interval_moves);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,160 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "device-config.h"
+#include "test.h"
+
+static const device_config_s g_defaults = {
+	{ 20, 5, 26 },
+	1,
+	{ 1.0, 1.0, 0.02, 0.25, 1.0, 0.1 },
+	2.0,
+	{ "/capability/a", "/capability/b" },
+	{ 0, 0, 1000000, 0 },
+};
+
+static char g_source[PATH_MAX];
+static char g_cache[PATH_MAX];
+
+static void __paths(void)
+{
+	const char *dir = getenv("LEDSW_TEST_DATA");
+
+	if (!dir || !*dir)
+		dir = ".";
+	snprintf(g_source, sizeof(g_source), "%s/device_def.json", dir);
+	snprintf(g_cache, sizeof(g_cache), "%s/device_config.bin", dir);
+}
+
+static int __load(const char *json, const char *cache)
+{
+	FILE *fp = fopen(g_source, "w");
+
+	if (!fp)
+		return -1;
+	fputs(json, fp);
+	fclose(fp);
+
+	if (cache)
+		unlink(cache);
+
+	return device_config_load(g_source, cache, &g_defaults);
+}
+
+static void __check_defaults(void)
+{
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_SW), 20);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_1), 5);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_2), 26);
+	CHECK_NEAR(device_config_get_interval(DEVICE_CONFIG_INTERVAL_SENSOR), 1.0, 1e-9);
+	CHECK_NEAR(device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE), 1.0, 1e-9);
+}
+
+static void test_values_and_defaults(void)
+{
+	CHECK_INT(__load("{ \"ledsw\": { \"i2c_bus\": 2, \"pins\": { \"sw\": 4, \"led2\": 17 },"
+			" \"intervals\": { \"illuminance\": 0, \"sw_min\": 0.05 },"
+			" \"uris\": { \"door\": \"/capability/door\" }, \"other\": [1, {\"x\": null}] } }", NULL), 0);
+
+	CHECK_INT(device_config_get_i2c_bus(), 2);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_SW), 4);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_1), 5);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_2), 17);
+
+	/* Zero leaves the illuminance sensor off */
+	CHECK_NEAR(device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE), 0.0, 1e-9);
+	CHECK_NEAR(device_config_get_interval(DEVICE_CONFIG_INTERVAL_SW_MIN), 0.05, 1e-9);
+	CHECK_NEAR(device_config_get_interval(DEVICE_CONFIG_INTERVAL_SENSOR), 1.0, 1e-9);
+	CHECK_STR(device_config_get_uri(DEVICE_CONFIG_URI_ILLUMINANCE), "/capability/a");
+	CHECK_STR(device_config_get_uri(DEVICE_CONFIG_URI_DOOR), "/capability/door");
+
+	device_config_unload();
+}
+
+static void test_bad_pins_fall_back(void)
+{
+	/* Past the last gpio */
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"sw\": 40 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"led1\": -1 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	/* Both LEDs on one pin */
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"led2\": 5 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	/* The switch moved onto a default LED pin */
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"sw\": 26 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	/* Swapped pins are fine */
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"led1\": 26, \"led2\": 5 } } }", NULL), 0);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_1), 26);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_LED_2), 5);
+	device_config_unload();
+}
+
+static void test_bad_intervals_fall_back(void)
+{
+	/* The sampler would refuse to start */
+	CHECK_INT(__load("{ \"ledsw\": { \"intervals\": { \"sensor\": 0, \"illuminance\": 0 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	CHECK_INT(__load("{ \"ledsw\": { \"intervals\": { \"notify_door\": -0.5 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+
+	CHECK_INT(__load("{ \"ledsw\": { \"intervals\": { \"illuminance\": -1 } } }", NULL), 0);
+	__check_defaults();
+	device_config_unload();
+}
+
+static void test_cached_image(void)
+{
+	CHECK_INT(__load("{ \"ledsw\": { \"pins\": { \"sw\": 6 }, \"uris\": { \"illuminance\": \"/lux\" } } }", g_cache), 0);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_SW), 6);
+	device_config_unload();
+	CHECK(access(g_cache, R_OK) == 0);
+
+	/* The second load maps the image written by the first */
+	CHECK_INT(device_config_load(g_source, g_cache, &g_defaults), 0);
+	CHECK_INT(device_config_get_pin(DEVICE_CONFIG_PIN_SW), 6);
+	CHECK_STR(device_config_get_uri(DEVICE_CONFIG_URI_ILLUMINANCE), "/lux");
+	CHECK_STR(device_config_get_uri(DEVICE_CONFIG_URI_DOOR), "/capability/b");
+	device_config_unload();
+}
+
+int main(void)
+{
+	__paths();
+
+	TEST_RUN(test_values_and_defaults);
+	TEST_RUN(test_bad_pins_fall_back);
+	TEST_RUN(test_bad_intervals_fall_back);
+	TEST_RUN(test_cached_image);
+
+	return TEST_EXIT();
+}
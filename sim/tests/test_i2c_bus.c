@@ -0,0 +1,247 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "resource/resource_i2c_bus.h"
+#include "resource/resource_io_worker.h"
+#include "test.h"
+
+/* The GY30 model answers at this address on any bus, so two buses make two devices */
+#define GY30_ADDR 0x23
+#define BUS_A 1
+#define BUS_B 2
+#define DONE_MAX 8
+
+static struct {
+	int count;
+	int order[DONE_MAX]; /* The data of each completion, in the order they came */
+	int results[DONE_MAX];
+	double at[DONE_MAX];
+} g_done;
+
+static sem_t g_blocker;
+static unsigned char g_power_on = 0x01;
+static unsigned char g_buf[2][2];
+
+static void __done_cb(int result, void *data)
+{
+	if (g_done.count < DONE_MAX) {
+		g_done.order[g_done.count] = (int) (long) data;
+		g_done.results[g_done.count] = result;
+		g_done.at[g_done.count] = test_clock_now();
+	}
+	g_done.count++;
+}
+
+static int __block_work(void *data)
+{
+	sem_wait(&g_blocker);
+	return 0;
+}
+
+/* Lets the worker run and the main loop take its completions back */
+static void __wait_worker(int *flag)
+{
+	struct timespec pause = { 0, 1000000 };
+	int i = 0;
+
+	for (i = 0; i < 2000 && !__atomic_load_n(flag, __ATOMIC_ACQUIRE); i++) {
+		nanosleep(&pause, NULL);
+		test_loop_iterate();
+	}
+	test_loop_iterate();
+}
+
+static int g_drained;
+
+static void __drained_cb(int result, void *data)
+{
+	__atomic_store_n(&g_drained, 1, __ATOMIC_RELEASE);
+}
+
+static int __nop_work(void *data)
+{
+	return 0;
+}
+
+/* Waits until everything queued on the worker so far came back */
+static void __drain_worker(void)
+{
+	g_drained = 0;
+	CHECK_INT(resource_io_submit(__nop_work, __drained_cb, NULL), 0);
+	__wait_worker(&g_drained);
+	CHECK_INT(g_drained, 1);
+}
+
+static int __submit_power_on(resource_i2c_device *device, int id)
+{
+	resource_i2c_op_s op = { RESOURCE_I2C_OP_WRITE, &g_power_on, 1, 0.0 };
+
+	return resource_i2c_bus_submit(device, &op, 1, __done_cb, (void *) (long) id);
+}
+
+/* Parks the worker, then lets the dispatch hand it the first step of @a device */
+static void __park_step(resource_i2c_device *device, int id)
+{
+	resource_io_stats_s stats;
+
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	CHECK_INT(__submit_power_on(device, id), 0);
+	test_loop_iterate();
+
+	resource_io_get_stats(&stats);
+	CHECK_INT(stats.depth, 2);
+}
+
+static void test_cancel_with_a_step_on_the_worker(void)
+{
+	resource_i2c_device *device = resource_i2c_bus_get(BUS_A, GY30_ADDR);
+
+	memset(&g_done, 0, sizeof(g_done));
+	CHECK(device != NULL);
+	CHECK_INT(resource_io_worker_start(), 0);
+
+	__park_step(device, 1);
+	CHECK_INT(__submit_power_on(device, 2), 0);
+
+	/* Neither completes, the one on the worker comes back cancelled */
+	resource_i2c_bus_cancel(device);
+	sem_post(&g_blocker);
+	__drain_worker();
+	CHECK_INT(g_done.count, 0);
+
+	/* The device takes new work once the cancelled step is back */
+	CHECK_INT(__submit_power_on(device, 3), 0);
+	test_loop_iterate();
+	__drain_worker();
+	CHECK_INT(g_done.count, 1);
+	CHECK_INT(g_done.order[0], 3);
+	CHECK_INT(g_done.results[0], 0);
+
+	resource_i2c_bus_put(device);
+	resource_io_worker_stop();
+}
+
+static void test_get_back_while_the_cancelled_step_runs(void)
+{
+	resource_i2c_device *device = resource_i2c_bus_get(BUS_A, GY30_ADDR);
+	resource_i2c_device *again = NULL;
+
+	memset(&g_done, 0, sizeof(g_done));
+	CHECK_INT(resource_io_worker_start(), 0);
+
+	/* Released with its step on the worker, it stays linked until the step comes back */
+	__park_step(device, 1);
+	resource_i2c_bus_put(device);
+	again = resource_i2c_bus_get(BUS_A, GY30_ADDR);
+	CHECK(again == device);
+
+	/* Work queued behind the cancelled step runs once it is back, the device is not freed under it */
+	CHECK_INT(__submit_power_on(again, 2), 0);
+	sem_post(&g_blocker);
+	__drain_worker();
+	test_loop_iterate();
+	__drain_worker();
+	CHECK_INT(g_done.count, 1);
+	CHECK_INT(g_done.order[0], 2);
+	CHECK_INT(g_done.results[0], 0);
+
+	resource_i2c_bus_put(again);
+	resource_io_worker_stop();
+}
+
+static void test_full_queue_waits_for_room(void)
+{
+	resource_i2c_device *device = resource_i2c_bus_get(BUS_A, GY30_ADDR);
+	int i = 0;
+
+	memset(&g_done, 0, sizeof(g_done));
+	CHECK_INT(resource_io_worker_start(), 0);
+
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	while (resource_io_submit(__nop_work, NULL, NULL) == 0)
+		;
+
+	/* The step does not run here beside the worker, it waits */
+	CHECK_INT(__submit_power_on(device, 1), 0);
+	for (i = 0; i < 3; i++)
+		test_loop_iterate();
+	CHECK_INT(g_done.count, 0);
+
+	/* Queued once the worker made room, without another submit */
+	sem_post(&g_blocker);
+	__wait_worker(&g_done.count);
+	CHECK_INT(g_done.count, 1);
+	CHECK_INT(g_done.results[0], 0);
+
+	resource_i2c_bus_put(device);
+	resource_io_worker_stop();
+}
+
+static void test_devices_interleave_around_a_delay(void)
+{
+	resource_i2c_device *a = resource_i2c_bus_get(BUS_A, GY30_ADDR);
+	resource_i2c_device *b = resource_i2c_bus_get(BUS_B, GY30_ADDR);
+	resource_i2c_op_s slow[] = {
+		{ RESOURCE_I2C_OP_WRITE, &g_power_on, 1, 0.0 },
+		{ RESOURCE_I2C_OP_DELAY, NULL, 0, 0.1 },
+		{ RESOURCE_I2C_OP_READ, g_buf[0], 2, 0.0 },
+	};
+	resource_i2c_op_s fast[] = {
+		{ RESOURCE_I2C_OP_WRITE, &g_power_on, 1, 0.0 },
+		{ RESOURCE_I2C_OP_READ, g_buf[1], 2, 0.0 },
+	};
+	double start = test_clock_now();
+
+	memset(&g_done, 0, sizeof(g_done));
+
+	/* Without the worker the steps run inline, on the virtual clock */
+	CHECK_INT(resource_i2c_bus_submit(a, slow, 3, __done_cb, (void *) 1), 0);
+	CHECK_INT(resource_i2c_bus_submit(a, fast, 2, __done_cb, (void *) 2), 0);
+	CHECK_INT(resource_i2c_bus_submit(b, fast, 2, __done_cb, (void *) 3), 0);
+
+	/* The other device uses the bus while the first converts, its own queue waits behind the delay */
+	test_clock_advance(0.05);
+	CHECK_INT(g_done.count, 1);
+	CHECK_INT(g_done.order[0], 3);
+
+	/* Nothing runs directly while a device has queued work */
+	CHECK(resource_i2c_bus_run(a, fast, 2) < 0);
+
+	test_clock_advance(0.1);
+	CHECK_INT(g_done.count, 3);
+	CHECK_INT(g_done.order[1], 1);
+	CHECK_INT(g_done.order[2], 2);
+	CHECK_NEAR(g_done.at[1] - start, 0.1, 1e-9);
+	CHECK_NEAR(g_done.at[2] - start, 0.1, 1e-9);
+	CHECK_INT(g_done.results[1], 0);
+
+	resource_i2c_bus_put(a);
+	resource_i2c_bus_put(b);
+}
+
+int main(void)
+{
+	sem_init(&g_blocker, 0, 0);
+
+	TEST_RUN(test_cancel_with_a_step_on_the_worker);
+	TEST_RUN(test_get_back_while_the_cancelled_step_runs);
+	TEST_RUN(test_full_queue_waits_for_room);
+	TEST_RUN(test_devices_interleave_around_a_delay);
+
+	return TEST_EXIT();
+}
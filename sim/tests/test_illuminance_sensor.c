@@ -0,0 +1,167 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "peripheral_sim.h"
+#include "resource.h"
+#include "test.h"
+
+#define I2C_BUS 1
+
+/* Runs against the GY30 model of peripheral_sim, the bus dispatches inline on the virtual clock */
+
+typedef struct {
+	int count;
+	resource_illuminance_sample_s last;
+} samples_s;
+
+static void __sample_cb(const resource_illuminance_sample_s *sample, void *data)
+{
+	samples_s *samples = data;
+
+	samples->count++;
+	if (sample)
+		samples->last = *sample;
+}
+
+static void __set_lux(double lux)
+{
+	peripheral_sim_lux_schedule(test_clock_now() - peripheral_sim_epoch(), lux);
+	peripheral_sim_dispatch(test_clock_now());
+}
+
+/* One continuous read, returns the range the result was measured in */
+static resource_illuminance_range_e __read(double *lux)
+{
+	samples_s samples;
+
+	memset(&samples, 0, sizeof(samples));
+	CHECK_INT(resource_read_illuminance_sensor_async(I2C_BUS, RESOURCE_ILLUMINANCE_MODE_CONTINUOUS, __sample_cb, &samples), 0);
+	test_clock_advance(1.0);
+	CHECK_INT(samples.count, 1);
+
+	*lux = samples.last.lux;
+	return samples.last.range;
+}
+
+static void test_auto_range_follows_the_light(void)
+{
+	double lux = 0.0;
+
+	CHECK_INT(resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_AUTO), 0);
+	CHECK_INT(resource_open_illuminance_sensor(I2C_BUS), 0);
+
+	/* Dim enough for the darker range twice over */
+	__set_lux(1000.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+	CHECK_NEAR(lux, 1000.0, 1.0);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_DARK);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_DARK);
+	CHECK_NEAR(lux, 1000.0, 0.5);
+
+	/* Saturates the dark range, the next one has room */
+	__set_lux(20000.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_DARK);
+	CHECK(lux < 20000.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+	CHECK_NEAR(lux, 20000.0, 1.0);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+
+	__set_lux(60000.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_BRIGHT);
+	CHECK_NEAR(lux, 60000.0, 10.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_BRIGHT);
+
+	/* And back down, one range per reading */
+	__set_lux(2000.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_BRIGHT);
+	CHECK_NEAR(lux, 2000.0, 10.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+	CHECK_NEAR(lux, 2000.0, 1.0);
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_DARK);
+	CHECK_NEAR(lux, 2000.0, 0.5);
+
+	resource_close_illuminance_sensor();
+}
+
+static void test_range_change_while_pending(void)
+{
+	samples_s samples;
+	double lux = 0.0;
+
+	memset(&samples, 0, sizeof(samples));
+	CHECK_INT(resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_NORMAL), 0);
+	__set_lux(1000.0);
+
+	CHECK_INT(resource_read_illuminance_sensor_async(I2C_BUS, RESOURCE_ILLUMINANCE_MODE_CONTINUOUS, __sample_cb, &samples), 0);
+	test_clock_advance(0.05);
+	CHECK_INT(resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_BRIGHT), 0);
+	test_clock_advance(1.0);
+
+	/* Scaled with the measurement time it was converted with */
+	CHECK_INT(samples.count, 1);
+	CHECK_INT(samples.last.range, RESOURCE_ILLUMINANCE_RANGE_NORMAL);
+	CHECK_NEAR(samples.last.lux, 1000.0, 1.0);
+
+	/* The fixed range holds whatever the reading */
+	CHECK_INT(__read(&lux), RESOURCE_ILLUMINANCE_RANGE_BRIGHT);
+	CHECK_NEAR(lux, 1000.0, 10.0);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_BRIGHT);
+
+	resource_close_illuminance_sensor();
+}
+
+static void test_sync_read_waits_for_the_new_range(void)
+{
+	uint32_t value = 0;
+
+	/* Auto ranging from the normal range */
+	CHECK_INT(resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_NORMAL), 0);
+	CHECK_INT(resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_AUTO), 0);
+	__set_lux(1000.0);
+
+	/* Nothing converted yet */
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), RESOURCE_ILLUMINANCE_BUSY);
+	test_clock_advance(0.2);
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), 0);
+	CHECK_INT(value, 1000);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_DARK);
+
+	/* The sensor still holds the count of the normal range, it must not be scaled as a dark one */
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), RESOURCE_ILLUMINANCE_BUSY);
+	test_clock_advance(0.2);
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), RESOURCE_ILLUMINANCE_BUSY);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_DARK);
+	test_clock_advance(0.5);
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), 0);
+	CHECK_NEAR(value, 1000, 1);
+	CHECK_INT(resource_get_illuminance_sensor_range(), RESOURCE_ILLUMINANCE_RANGE_DARK);
+
+	/* A running conversion is read right away */
+	CHECK_INT(resource_read_illuminance_sensor(I2C_BUS, &value), 0);
+
+	resource_close_illuminance_sensor();
+}
+
+int main(void)
+{
+	TEST_RUN(test_auto_range_follows_the_light);
+	TEST_RUN(test_range_change_while_pending);
+	TEST_RUN(test_sync_read_waits_for_the_new_range);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,174 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "peripheral_sim.h"
+#include "led-sequence.h"
+#include "resource/resource_led.h"
+#include "test.h"
+
+#define LED_A 5
+#define LED_B 6
+#define LED_C 13
+#define WRITES_MAX 32
+
+/* Without the I/O worker the writes run inline, on the virtual clock */
+static struct {
+	int pins[WRITES_MAX];
+	uint32_t values[WRITES_MAX];
+	int at_ms[WRITES_MAX]; /* Since the test started */
+	int count;
+	double start;
+} g_writes;
+
+static int g_done[2];
+
+static void __write_cb(int pin_num, uint32_t value, double timestamp, void *data)
+{
+	if (g_writes.count < WRITES_MAX) {
+		g_writes.pins[g_writes.count] = pin_num;
+		g_writes.values[g_writes.count] = value;
+		g_writes.at_ms[g_writes.count] = (int) ((test_clock_now() - g_writes.start) * 1000.0 + 0.5);
+	}
+	g_writes.count++;
+}
+
+static void __done_cb(led_sequence *seq, void *data)
+{
+	g_done[(int) (long) data]++;
+}
+
+/* Starts every pin low, so the shadow levels do not skip the first writes */
+static void __writes_reset(void)
+{
+	resource_write_leds((1ULL << LED_A) | (1ULL << LED_B) | (1ULL << LED_C), 0);
+	memset(&g_writes, 0, sizeof(g_writes));
+	memset(g_done, 0, sizeof(g_done));
+	g_writes.start = test_clock_now();
+}
+
+static void __check_write(int index, int pin_num, uint32_t value, int at_ms)
+{
+	CHECK_INT(g_writes.pins[index], pin_num);
+	CHECK_INT(g_writes.values[index], value);
+	CHECK_INT(g_writes.at_ms[index], at_ms);
+}
+
+static void test_patterns_on_different_pins_play_together(void)
+{
+	static const led_step_s blink_a[] = { { LED_A, 1, 100 }, { LED_A, 0, 100 } };
+	static const led_step_s blink_b[] = { { LED_B, 1, 150 }, { LED_B, 0, 150 } };
+
+	__writes_reset();
+
+	CHECK(led_sequence_play(blink_a, 2, 2, __done_cb, (void *) 0) != NULL);
+	CHECK(led_sequence_play(blink_b, 2, 1, __done_cb, (void *) 1) != NULL);
+	test_clock_advance(1.0);
+
+	/* Neither waits for the other, the writes interleave on the clock */
+	CHECK_INT(g_writes.count, 6);
+	__check_write(0, LED_A, 1, 0);
+	__check_write(1, LED_B, 1, 0);
+	__check_write(2, LED_A, 0, 100);
+	__check_write(3, LED_B, 0, 150);
+	__check_write(4, LED_A, 1, 200);
+	__check_write(5, LED_A, 0, 300);
+	CHECK_INT(g_done[0], 1);
+	CHECK_INT(g_done[1], 1);
+}
+
+static void test_play_preempts_only_the_owner_of_its_pins(void)
+{
+	static const led_step_s blink_a[] = { { LED_A, 1, 100 }, { LED_A, 0, 100 } };
+	static const led_step_s blink_b[] = { { LED_B, 1, 100 }, { LED_B, 0, 100 } };
+	static const led_step_s hold_bc[] = { { LED_B, 1, 0 }, { LED_C, 1, 500 } };
+	int i = 0;
+
+	__writes_reset();
+
+	CHECK(led_sequence_play(blink_a, 2, 0, __done_cb, (void *) 0) != NULL);
+	CHECK(led_sequence_play(blink_b, 2, 0, __done_cb, (void *) 1) != NULL);
+	test_clock_advance(0.15);
+
+	/* Shares LED_B only, the blink on LED_A keeps going */
+	CHECK(led_sequence_play(hold_bc, 2, 1, NULL, NULL) != NULL);
+	memset(&g_writes, 0, sizeof(g_writes));
+	g_writes.start = test_clock_now();
+	test_clock_advance(0.4);
+
+	CHECK_INT(g_writes.count, 4);
+	for (i = 0; i < g_writes.count && i < WRITES_MAX; i++)
+		CHECK_INT(g_writes.pins[i], LED_A);
+
+	/* A stopped sequence is not done, its callback stays silent */
+	CHECK_INT(g_done[0], 0);
+	CHECK_INT(g_done[1], 0);
+
+	led_sequence_stop_all();
+	memset(&g_writes, 0, sizeof(g_writes));
+	test_clock_advance(1.0);
+	CHECK_INT(g_writes.count, 0);
+}
+
+static void test_zero_duration_steps_go_out_as_one_batch(void)
+{
+	static const led_step_s steps[] = {
+		{ LED_A, 1, 0 }, { LED_B, 1, 0 }, { LED_C, 1, 100 },
+		{ -1, 0, 50 },
+		{ LED_A, 0, 0 }, { LED_B, 0, 0 }, { LED_C, 0, 0 },
+	};
+	static const led_step_s instant[] = { { LED_A, 1, 0 }, { LED_C, 1, 0 } };
+	resource_led_batch_stats_s before;
+	resource_led_batch_stats_s after;
+
+	__writes_reset();
+	resource_get_led_batch_stats(&before);
+
+	/* The step that waits goes out with the ones before it */
+	CHECK(led_sequence_play(steps, sizeof(steps) / sizeof(steps[0]), 1, __done_cb, (void *) 0) != NULL);
+	resource_get_led_batch_stats(&after);
+	CHECK_INT(after.batches - before.batches, 1);
+	CHECK_INT(g_writes.count, 3);
+
+	/* The delay step writes nothing, the trailing steps are the second batch */
+	test_clock_advance(0.12);
+	CHECK_INT(g_writes.count, 3);
+	test_clock_advance(0.05);
+	resource_get_led_batch_stats(&after);
+	CHECK_INT(after.batches - before.batches, 2);
+	CHECK_INT(g_writes.count, 6);
+	__check_write(3, LED_A, 0, 150);
+	__check_write(5, LED_C, 0, 150);
+	CHECK_INT(g_done[0], 1);
+
+	/* Taking no time at all, the whole list is written and done before play returns */
+	CHECK(led_sequence_play(instant, 2, 1, __done_cb, (void *) 1) == NULL);
+	resource_get_led_batch_stats(&after);
+	CHECK_INT(after.batches - before.batches, 3);
+	CHECK_INT(g_done[1], 1);
+	CHECK_INT(g_writes.count, 8);
+}
+
+int main(void)
+{
+	peripheral_sim_set_write_cb(__write_cb, NULL);
+
+	TEST_RUN(test_patterns_on_different_pins_play_together);
+	TEST_RUN(test_play_preempts_only_the_owner_of_its_pins);
+	TEST_RUN(test_zero_duration_steps_go_out_as_one_batch);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,206 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "test.h"
+
+#define TEST_TAG "TEST"
+#define TEST_THREADS 4
+#define TEST_THREAD_RECORDS 5000
+#define TEST_THREAD_BURST 32 /* Records between pauses, less than a ring */
+#define TEST_SHORT_THREADS 64
+
+static struct {
+	pthread_mutex_t mutex;
+	char last[256];
+	int lines;
+	int dropped;
+	int next[TEST_THREADS + TEST_SHORT_THREADS]; /* The sequence number expected next per thread */
+	int out_of_order;
+} g_capture = { PTHREAD_MUTEX_INITIALIZER, };
+
+static void __capture_cb(int prio, const char *tag, const char *line, void *data)
+{
+	unsigned int dropped = 0;
+	int thread = 0;
+	int seq = 0;
+
+	pthread_mutex_lock(&g_capture.mutex);
+	if (!strcmp(tag, TEST_TAG)) {
+		snprintf(g_capture.last, sizeof(g_capture.last), "%s", line);
+		g_capture.lines++;
+		if (sscanf(line, "[worker:1] t%d n%d", &thread, &seq) == 2) {
+			if (seq < g_capture.next[thread])
+				g_capture.out_of_order++;
+			g_capture.next[thread] = seq + 1;
+		}
+	} else if (sscanf(line, "[%*[^]]] %u log records dropped", &dropped) == 1) {
+		g_capture.dropped += dropped;
+	}
+	pthread_mutex_unlock(&g_capture.mutex);
+}
+
+static void __capture_start(void)
+{
+	pthread_mutex_lock(&g_capture.mutex);
+	memset(g_capture.last, 0, sizeof(g_capture.last));
+	memset(g_capture.next, 0, sizeof(g_capture.next));
+	g_capture.lines = 0;
+	g_capture.dropped = 0;
+	g_capture.out_of_order = 0;
+	pthread_mutex_unlock(&g_capture.mutex);
+
+	test_dlog_capture(__capture_cb, NULL);
+}
+
+static int __capture_lines(void)
+{
+	int lines = 0;
+
+	pthread_mutex_lock(&g_capture.mutex);
+	lines = g_capture.lines;
+	pthread_mutex_unlock(&g_capture.mutex);
+
+	return lines;
+}
+
+/* Real time, the drainer is a thread of its own */
+static int __wait_lines(int lines, double timeout)
+{
+	const struct timespec step = { 0, 1000 * 1000 };
+	double waited = 0.0;
+
+	while (__capture_lines() < lines && waited < timeout) {
+		nanosleep(&step, NULL);
+		waited += 0.001;
+	}
+
+	return __capture_lines();
+}
+
+static void test_prints_directly_without_drainer(void)
+{
+	__capture_start();
+
+	log_write(DLOG_INFO, TEST_TAG, "direct", 7, "value %d %s", 42, "x");
+	CHECK_INT(g_capture.lines, 1);
+	CHECK_STR(g_capture.last, "[direct:7] value 42 x\n");
+
+	test_dlog_capture(NULL, NULL);
+}
+
+static void test_drainer_wakes_for_a_record(void)
+{
+	__capture_start();
+	CHECK_INT(log_start(), 0);
+
+	log_write(DLOG_INFO, TEST_TAG, "ring", 12, "%d %lld %.2f %s %u", -3, 1LL << 40, 2.5, "lux", 7u);
+
+	/* Formatted by the drainer before anything stops it */
+	CHECK_INT(__wait_lines(1, 2.0), 1);
+	CHECK_STR(g_capture.last, "[ring:12] -3 1099511627776 2.50 lux 7\n");
+
+	log_stop();
+	CHECK_INT(g_capture.lines, 1);
+
+	test_dlog_capture(NULL, NULL);
+}
+
+static void *__worker(void *data)
+{
+	const struct timespec pause = { 0, 50 * 1000 };
+	int thread = (int) (long) data;
+	int i = 0;
+
+	for (i = 0; i < TEST_THREAD_RECORDS; i++) {
+		log_write(DLOG_INFO, TEST_TAG, "worker", 1, "t%d n%d", thread, i);
+		if (i % TEST_THREAD_BURST == 0)
+			nanosleep(&pause, NULL);
+	}
+
+	return NULL;
+}
+
+static void test_stop_keeps_records_in_flight(void)
+{
+	pthread_t threads[TEST_THREADS];
+	const struct timespec pause = { 0, 5 * 1000 * 1000 };
+	long i = 0;
+
+	__capture_start();
+	CHECK_INT(log_start(), 0);
+
+	for (i = 0; i < TEST_THREADS; i++)
+		CHECK_INT(pthread_create(&threads[i], NULL, __worker, (void *) i), 0);
+
+	/* Stopped while the workers still write, later records are printed directly */
+	nanosleep(&pause, NULL);
+	log_stop();
+
+	for (i = 0; i < TEST_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	/* Every record is either printed or counted as dropped, never lost */
+	CHECK_INT(g_capture.lines + g_capture.dropped, TEST_THREADS * TEST_THREAD_RECORDS);
+	CHECK_INT(g_capture.out_of_order, 0);
+
+	test_dlog_capture(NULL, NULL);
+}
+
+static void *__short_worker(void *data)
+{
+	int thread = (int) (long) data;
+
+	log_write(DLOG_INFO, TEST_TAG, "worker", 1, "t%d n%d", thread, 0);
+
+	return NULL;
+}
+
+static void test_exited_threads_are_drained(void)
+{
+	pthread_t thread;
+	long i = 0;
+
+	__capture_start();
+	CHECK_INT(log_start(), 0);
+
+	/* Each thread leaves its ring behind, the drainer frees it once empty */
+	for (i = TEST_THREADS; i < TEST_THREADS + TEST_SHORT_THREADS; i++) {
+		CHECK_INT(pthread_create(&thread, NULL, __short_worker, (void *) i), 0);
+		pthread_join(thread, NULL);
+	}
+
+	CHECK_INT(__wait_lines(TEST_SHORT_THREADS, 2.0), TEST_SHORT_THREADS);
+
+	log_stop();
+	CHECK_INT(g_capture.lines, TEST_SHORT_THREADS);
+	CHECK_INT(g_capture.dropped, 0);
+
+	test_dlog_capture(NULL, NULL);
+}
+
+int main(void)
+{
+	TEST_RUN(test_prints_directly_without_drainer);
+	TEST_RUN(test_drainer_wakes_for_a_record);
+	TEST_RUN(test_stop_keeps_records_in_flight);
+	TEST_RUN(test_exited_threads_are_drained);
+
+	return TEST_EXIT();
+}
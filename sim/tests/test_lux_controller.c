@@ -0,0 +1,165 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lux-controller.h"
+#include "test.h"
+
+#define TARGET_LUX 300
+
+/* The gains ledsw.c uses */
+static const lux_controller_config_s g_config = {
+	TARGET_LUX << 4, 256, 2560, LUX_CONTROLLER_DUTY_MAX / 100
+};
+
+/* Without a threshold or a proportional part, every reading shows the integral step */
+static const lux_controller_config_s g_integral_config = {
+	TARGET_LUX << 4, 0, 2560, 0
+};
+
+typedef struct {
+	lux_controller *ctl;
+	double lux; /* Added at full duty */
+	unsigned int duty;
+	unsigned int time_ms;
+} lamp_s;
+
+static unsigned int __lux_q4(const lamp_s *lamp, double daylight)
+{
+	return (unsigned int) ((daylight + lamp->lux * lamp->duty / LUX_CONTROLLER_DUTY_MAX) * 16);
+}
+
+/* Runs the loop against a lamp that adds its light right away */
+static void __run(lamp_s *lamp, double daylight, unsigned int step_ms, double seconds)
+{
+	unsigned int duty = 0;
+	unsigned int end = lamp->time_ms + (unsigned int) (seconds * 1000);
+
+	while ((int) (end - lamp->time_ms) > 0) {
+		lamp->time_ms += step_ms;
+		if (lux_controller_update(lamp->ctl, __lux_q4(lamp, daylight), lamp->time_ms, &duty) == 1)
+			lamp->duty = duty;
+	}
+}
+
+static void test_first_reading_only_starts(void)
+{
+	lux_controller *ctl = lux_controller_new(&g_integral_config);
+	unsigned int duty = 12345;
+
+	CHECK_INT(lux_controller_update(ctl, 100 << 4, 1000, &duty), 0);
+	CHECK_INT(duty, 12345);
+
+	/* 200 lux short for half a second, ki 2560 / 256 duty per 1/16 lux and second */
+	CHECK_INT(lux_controller_update(ctl, 100 << 4, 1500, &duty), 1);
+	CHECK_INT(duty, 200 * 16 * 10 / 2);
+
+	lux_controller_free(ctl);
+}
+
+static void test_integral_follows_elapsed_time(void)
+{
+	lux_controller *fast = lux_controller_new(&g_integral_config);
+	lux_controller *slow = lux_controller_new(&g_integral_config);
+	unsigned int fast_duty = 0;
+	unsigned int slow_duty = 0;
+	int i = 0;
+
+	lux_controller_update(fast, 250 << 4, 0, &fast_duty);
+	lux_controller_update(slow, 250 << 4, 0, &slow_duty);
+
+	/* Four quarter second readings add up to one reading a second later */
+	for (i = 1; i <= 4; i++)
+		CHECK_INT(lux_controller_update(fast, 250 << 4, i * 250, &fast_duty), 1);
+	CHECK_INT(lux_controller_update(slow, 250 << 4, 1000, &slow_duty), 1);
+	CHECK_INT(fast_duty, slow_duty);
+	CHECK_INT(slow_duty, 50 * 16 * 10);
+
+	lux_controller_free(fast);
+	lux_controller_free(slow);
+}
+
+static void test_long_gap_and_clock_wrap(void)
+{
+	lux_controller *ctl = lux_controller_new(&g_integral_config);
+	unsigned int duty = 0;
+
+	/* The millisecond clock wraps between the readings */
+	lux_controller_update(ctl, 290 << 4, 0xffffff9cU, &duty);
+	CHECK_INT(lux_controller_update(ctl, 290 << 4, 100, &duty), 1);
+	CHECK_INT(duty, 10 * 16 * 10 / 5);
+
+	/* A gap counts as one second at most */
+	CHECK_INT(lux_controller_update(ctl, 290 << 4, 60000, &duty), 1);
+	CHECK_INT(duty, 10 * 16 * 10 / 5 + 10 * 16 * 10);
+
+	lux_controller_free(ctl);
+}
+
+static void test_settles_at_any_pace(void)
+{
+	lamp_s lamp = { NULL, 400.0, 0, 0 };
+	unsigned int step_ms[] = { 250, 660, 1000 };
+	unsigned int i = 0;
+
+	for (i = 0; i < sizeof(step_ms) / sizeof(step_ms[0]); i++) {
+		lamp.ctl = lux_controller_new(&g_config);
+		lamp.duty = 0;
+
+		/* Daylight drops, the lamp makes up for it within the threshold */
+		__run(&lamp, 320.0, step_ms[i], 2.0);
+		CHECK_INT(lamp.duty, 0);
+		__run(&lamp, 150.0, step_ms[i], 4.0);
+		CHECK_NEAR(__lux_q4(&lamp, 150.0) / 16.0, TARGET_LUX, 6.0);
+		__run(&lamp, 40.0, step_ms[i], 4.0);
+		CHECK_NEAR(__lux_q4(&lamp, 40.0) / 16.0, TARGET_LUX, 6.0);
+
+		/* Bright enough alone, the lamp goes fully off */
+		__run(&lamp, 500.0, step_ms[i], 3.0);
+		CHECK_INT(lamp.duty, 0);
+
+		lux_controller_free(lamp.ctl);
+	}
+}
+
+static void test_no_windup(void)
+{
+	lamp_s lamp = { NULL, 200.0, 0, 0 };
+
+	lamp.ctl = lux_controller_new(&g_config);
+
+	/* The lamp alone cannot reach the target, it saturates and stays there */
+	__run(&lamp, 0.0, 250, 10.0);
+	CHECK_INT(lamp.duty, LUX_CONTROLLER_DUTY_MAX);
+
+	/* The first reading of daylight already turns it down, nothing piled up meanwhile */
+	__run(&lamp, 200.0, 250, 0.25);
+	CHECK(lamp.duty < LUX_CONTROLLER_DUTY_MAX);
+
+	/* The weak lamp makes the way back slow, but it gets there */
+	__run(&lamp, 200.0, 250, 10.0);
+	CHECK_NEAR(__lux_q4(&lamp, 200.0) / 16.0, TARGET_LUX, 6.0);
+
+	lux_controller_free(lamp.ctl);
+}
+
+int main(void)
+{
+	TEST_RUN(test_first_reading_only_starts);
+	TEST_RUN(test_integral_follows_elapsed_time);
+	TEST_RUN(test_long_gap_and_clock_wrap);
+	TEST_RUN(test_settles_at_any_pace);
+	TEST_RUN(test_no_windup);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,176 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "notify-coalescer.h"
+#include "test.h"
+
+#define URI_A "/capability/a"
+#define URI_B "/capability/b"
+
+static struct {
+	int sent_a;
+	int sent_b;
+	int result; /* What the send callback returns */
+} g_send;
+
+static int __send_cb(const char *uri, void *data)
+{
+	if (!strcmp(uri, URI_A))
+		g_send.sent_a++;
+	else if (!strcmp(uri, URI_B))
+		g_send.sent_b++;
+
+	return g_send.result;
+}
+
+static void __init(void)
+{
+	memset(&g_send, 0, sizeof(g_send));
+	CHECK_INT(notify_coalescer_init(__send_cb, NULL), 0);
+	CHECK_INT(notify_coalescer_add_uri(URI_A, 1.0), 0);
+	CHECK_INT(notify_coalescer_add_uri(URI_B, 0.0), 0);
+}
+
+static void test_marks_in_one_iteration_coalesce(void)
+{
+	notify_coalescer_stats_s stats;
+
+	__init();
+	CHECK_INT(notify_coalescer_mark(URI_A), 0);
+	CHECK_INT(notify_coalescer_mark(URI_A), 0);
+	CHECK_INT(notify_coalescer_mark(URI_A), 0);
+	CHECK_INT(notify_coalescer_mark(URI_B), 0);
+	CHECK_INT(g_send.sent_a, 0);
+
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_a, 1);
+	CHECK_INT(g_send.sent_b, 1);
+
+	CHECK_INT(notify_coalescer_get_stats(URI_A, &stats), 0);
+	CHECK_INT(stats.marked, 3);
+	CHECK_INT(stats.sent, 1);
+	CHECK_INT(stats.suppressed, 2);
+
+	CHECK_INT(notify_coalescer_get_stats(NULL, &stats), 0);
+	CHECK_INT(stats.marked, 4);
+	CHECK_INT(stats.sent, 2);
+
+	CHECK(notify_coalescer_mark("/unknown") < 0);
+	notify_coalescer_fini();
+}
+
+static void test_min_interval_holds_and_retries(void)
+{
+	__init();
+	notify_coalescer_mark(URI_A);
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_a, 1);
+
+	/* Inside the interval the mark waits, later marks fold into it */
+	test_clock_advance(0.2);
+	notify_coalescer_mark(URI_A);
+	test_clock_advance(0.3);
+	notify_coalescer_mark(URI_A);
+	test_clock_advance(0.4);
+	CHECK_INT(g_send.sent_a, 1);
+
+	test_clock_advance(0.15);
+	CHECK_INT(g_send.sent_a, 2);
+
+	/* Nothing marked, nothing sent */
+	test_clock_advance(5.0);
+	CHECK_INT(g_send.sent_a, 2);
+
+	/* A zero interval URI goes out on every iteration it was marked in */
+	notify_coalescer_mark(URI_B);
+	test_loop_iterate();
+	notify_coalescer_mark(URI_B);
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_b, 2);
+	notify_coalescer_fini();
+}
+
+static void test_skipped_and_failed_are_counted_apart(void)
+{
+	notify_coalescer_stats_s stats;
+
+	__init();
+	g_send.result = NOTIFY_COALESCER_SKIPPED;
+	notify_coalescer_mark(URI_A);
+	test_loop_iterate();
+
+	/* A skipped notification does not start the interval */
+	g_send.result = 0;
+	notify_coalescer_mark(URI_A);
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_a, 2);
+
+	g_send.result = -1;
+	notify_coalescer_mark(URI_B);
+	test_loop_iterate();
+
+	CHECK_INT(notify_coalescer_get_stats(URI_A, &stats), 0);
+	CHECK_INT(stats.sent, 1);
+	CHECK_INT(stats.skipped, 1);
+	CHECK_INT(stats.failed, 0);
+
+	CHECK_INT(notify_coalescer_get_stats(URI_B, &stats), 0);
+	CHECK_INT(stats.sent, 0);
+	CHECK_INT(stats.skipped, 0);
+	CHECK_INT(stats.failed, 1);
+	notify_coalescer_fini();
+}
+
+static void test_mark_without_flusher_stays_clean(void)
+{
+	notify_coalescer_stats_s stats;
+
+	__init();
+	test_ecore_fail_adds(1);
+	CHECK(notify_coalescer_mark(URI_A) < 0);
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_a, 0);
+
+	/* Not left dirty, so the next mark is not folded away and does go out */
+	CHECK_INT(notify_coalescer_mark(URI_A), 0);
+	test_loop_iterate();
+	CHECK_INT(g_send.sent_a, 1);
+
+	CHECK_INT(notify_coalescer_get_stats(URI_A, &stats), 0);
+	CHECK_INT(stats.suppressed, 0);
+	notify_coalescer_fini();
+}
+
+static void test_fini_drops_pending(void)
+{
+	__init();
+	notify_coalescer_mark(URI_A);
+	notify_coalescer_fini();
+	test_clock_advance(2.0);
+	CHECK_INT(g_send.sent_a, 0);
+	CHECK(notify_coalescer_add_uri(URI_A, 1.0) < 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_marks_in_one_iteration_coalesce);
+	TEST_RUN(test_min_interval_holds_and_retries);
+	TEST_RUN(test_skipped_and_failed_are_counted_apart);
+	TEST_RUN(test_mark_without_flusher_stays_clean);
+	TEST_RUN(test_fini_drops_pending);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,221 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "peripheral_sim.h"
+#include "resource_internal.h"
+#include "resource/resource_led.h"
+#include "resource/resource_io_worker.h"
+#include "test.h"
+
+#define LED_1 5
+#define LED_2 26
+#define WRITES_MAX 16
+
+static struct {
+	pthread_mutex_t lock;
+	int pins[WRITES_MAX];
+	uint32_t values[WRITES_MAX];
+	int count;
+	int off_worker; /* Writes made by the main thread while the worker ran */
+	pthread_t main_thread;
+	int worker_expected;
+} g_writes = { PTHREAD_MUTEX_INITIALIZER, };
+
+static sem_t g_blocker;
+
+static void __write_cb(int pin_num, uint32_t value, double timestamp, void *data)
+{
+	pthread_mutex_lock(&g_writes.lock);
+	if (g_writes.count < WRITES_MAX) {
+		g_writes.pins[g_writes.count] = pin_num;
+		g_writes.values[g_writes.count] = value;
+	}
+	g_writes.count++;
+	if (g_writes.worker_expected && pthread_equal(pthread_self(), g_writes.main_thread))
+		g_writes.off_worker++;
+	pthread_mutex_unlock(&g_writes.lock);
+}
+
+static int __writes_count(void)
+{
+	int count = 0;
+
+	pthread_mutex_lock(&g_writes.lock);
+	count = g_writes.count;
+	pthread_mutex_unlock(&g_writes.lock);
+
+	return count;
+}
+
+static void __writes_reset(int worker_expected)
+{
+	pthread_mutex_lock(&g_writes.lock);
+	g_writes.count = 0;
+	g_writes.off_worker = 0;
+	g_writes.main_thread = pthread_self();
+	g_writes.worker_expected = worker_expected;
+	pthread_mutex_unlock(&g_writes.lock);
+}
+
+static int __block_work(void *data)
+{
+	sem_wait(&g_blocker);
+	return 0;
+}
+
+static int __nop_work(void *data)
+{
+	return 0;
+}
+
+/* Lets the worker run and the main loop take its completions back until the writes came */
+static void __wait_writes(int count)
+{
+	struct timespec pause = { 0, 1000000 };
+	int i = 0;
+
+	for (i = 0; i < 2000 && __writes_count() < count; i++) {
+		nanosleep(&pause, NULL);
+		test_loop_iterate();
+	}
+	test_loop_iterate();
+}
+
+static void test_writes_without_worker_run_inline(void)
+{
+	__writes_reset(0);
+	CHECK_INT(resource_write_led(LED_1, 1), 0);
+	CHECK_INT(__writes_count(), 1);
+
+	/* The shadow skips a write of the level the pin already has */
+	CHECK_INT(resource_write_led(LED_1, 1), 0);
+	CHECK_INT(__writes_count(), 1);
+
+	CHECK_INT(resource_write_led(LED_1, 0), 0);
+	CHECK_INT(__writes_count(), 2);
+}
+
+static void test_full_queue_merges_in_order(void)
+{
+	int submitted = 0;
+
+	__writes_reset(1);
+	CHECK_INT(resource_io_worker_start(), 0);
+
+	/* Park the worker and fill every slot behind it */
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	while (resource_io_submit(__nop_work, NULL, NULL) == 0)
+		submitted++;
+	CHECK(submitted > 0);
+
+	CHECK_INT(resource_write_led(LED_1, 1), 0);
+	CHECK_INT(resource_write_led(LED_2, 1), 0);
+	CHECK_INT(resource_write_led(LED_1, 0), 0);
+	CHECK_INT(resource_write_leds((1ULL << LED_2), 0), 0);
+	CHECK_INT(resource_write_leds((1ULL << LED_1) | (1ULL << LED_2), (1ULL << LED_2)), 0);
+
+	/* Nothing ran beside the parked worker */
+	CHECK_INT(__writes_count(), 0);
+
+	sem_post(&g_blocker);
+	__wait_writes(2);
+
+	/* One merged batch with the last level of each pin */
+	CHECK_INT(__writes_count(), 2);
+	CHECK_INT(g_writes.pins[0], LED_1);
+	CHECK_INT(g_writes.values[0], 0);
+	CHECK_INT(g_writes.pins[1], LED_2);
+	CHECK_INT(g_writes.values[1], 1);
+	CHECK_INT(g_writes.off_worker, 0);
+
+	/* With room again, writes go straight to the worker */
+	CHECK_INT(resource_write_led(LED_1, 1), 0);
+	__wait_writes(3);
+	CHECK_INT(__writes_count(), 3);
+	CHECK_INT(g_writes.values[2], 1);
+	CHECK_INT(g_writes.off_worker, 0);
+
+	resource_io_worker_stop();
+}
+
+static void test_close_flushes_pending(void)
+{
+	__writes_reset(0);
+	CHECK_INT(resource_io_worker_start(), 0);
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	while (resource_io_submit(__nop_work, NULL, NULL) == 0)
+		;
+
+	CHECK_INT(resource_write_led(LED_2, 0), 0);
+
+	/* The queued and pending writes still need the handle */
+	resource_close_led(LED_2);
+	CHECK_INT(resource_get_info(LED_2)->opened, 1);
+
+	sem_post(&g_blocker);
+	resource_io_worker_stop();
+	CHECK_INT(__writes_count(), 0);
+
+	/* The worker is gone, closing does the pending write itself */
+	resource_close_led(LED_2);
+	CHECK_INT(__writes_count(), 1);
+	CHECK_INT(g_writes.pins[0], LED_2);
+	CHECK_INT(g_writes.values[0], 0);
+
+	resource_close_led(LED_1);
+}
+
+static void test_driver_hooks(void)
+{
+	uint32_t value = 0;
+
+	__writes_reset(0);
+	CHECK(resource_get_info(-1) == NULL);
+	CHECK(resource_get_info(RESOURCE_ID_MAX) == NULL);
+
+	/* Closed, nothing to dispatch to */
+	CHECK(resource_write(LED_1, 1) < 0);
+
+	CHECK_INT(resource_led_driver.open(LED_1, 0), 0);
+	CHECK(resource_get_info(LED_1)->driver == &resource_led_driver);
+	CHECK_INT(resource_write(LED_1, 1), 0);
+	CHECK_INT(__writes_count(), 1);
+	CHECK_INT(g_writes.values[0], 1);
+
+	/* LEDs have no read hook */
+	CHECK(resource_read(LED_1, &value) < 0);
+	CHECK(resource_write(RESOURCE_ID_MAX, 1) < 0);
+
+	resource_close_led(LED_1);
+	CHECK(resource_get_info(LED_1)->driver == NULL);
+}
+
+int main(void)
+{
+	sem_init(&g_blocker, 0, 0);
+	peripheral_sim_set_write_cb(__write_cb, NULL);
+
+	TEST_RUN(test_writes_without_worker_run_inline);
+	TEST_RUN(test_full_queue_merges_in_order);
+	TEST_RUN(test_close_flushes_pending);
+	TEST_RUN(test_driver_hooks);
+
+	return TEST_EXIT();
+}
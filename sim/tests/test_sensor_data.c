@@ -0,0 +1,297 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "sensor-data.h"
+#include "test.h"
+
+#define STRESS_ROUNDS 200000
+
+static double __now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void test_scalars_and_version(void)
+{
+	sensor_data *data = sensor_data_new(SENSOR_DATA_TYPE_UINT);
+	unsigned int value = 0;
+	unsigned int version = 0;
+	double d = 0.0;
+
+	CHECK(data != NULL);
+	version = sensor_data_get_version(data);
+
+	CHECK_INT(sensor_data_set_uint(data, 7), 0);
+	CHECK_INT(sensor_data_get_uint(data, &value), 0);
+	CHECK_INT(value, 7);
+	CHECK_INT(sensor_data_get_version(data), version + 1);
+
+	/* The same value again is no change */
+	CHECK_INT(sensor_data_set_uint(data, 7), 0);
+	CHECK_INT(sensor_data_get_version(data), version + 1);
+
+	/* The type is fixed at creation */
+	CHECK(sensor_data_set_int(data, 1) < 0);
+	CHECK(sensor_data_get_double(data, &d) < 0);
+	sensor_data_free(data);
+
+	data = sensor_data_new(SENSOR_DATA_TYPE_DOUBLE);
+	CHECK_INT(sensor_data_set_double(data, 2.5), 0);
+	CHECK_INT(sensor_data_get_double(data, &d), 0);
+	CHECK_NEAR(d, 2.5, 0.0);
+	sensor_data_free(data);
+
+	CHECK(sensor_data_new(SENSOR_DATA_TYPE_NONE) == NULL);
+}
+
+static void *__double_writer(void *arg)
+{
+	sensor_data *data = arg;
+	uint64_t k = 0;
+	double value = 0.0;
+
+	/* Both halves always carry the same counter, a torn read shows as a mismatch */
+	for (k = 1; k <= STRESS_ROUNDS; k++) {
+		uint64_t bits = (k << 32) | k;
+		memcpy(&value, &bits, sizeof(value));
+		sensor_data_set_double(data, value);
+	}
+
+	return NULL;
+}
+
+static void test_double_is_never_torn(void)
+{
+	sensor_data *data = sensor_data_new(SENSOR_DATA_TYPE_DOUBLE);
+	pthread_t writer;
+	uint64_t bits = 0;
+	uint64_t last = 0;
+	unsigned int torn = 0;
+	unsigned int backwards = 0;
+	double value = 0.0;
+
+	CHECK_INT(pthread_create(&writer, NULL, __double_writer, data), 0);
+	do {
+		sensor_data_get_double(data, &value);
+		memcpy(&bits, &value, sizeof(bits));
+		if ((bits >> 32) != (bits & 0xffffffffULL))
+			torn++;
+		if ((bits & 0xffffffffULL) < last)
+			backwards++;
+		last = bits & 0xffffffffULL;
+	} while (last < STRESS_ROUNDS);
+	pthread_join(writer, NULL);
+
+	CHECK_INT(torn, 0);
+	CHECK_INT(backwards, 0);
+	CHECK_INT(sensor_data_get_version(data), STRESS_ROUNDS);
+	sensor_data_free(data);
+}
+
+static void test_history_ring(void)
+{
+	sensor_data *data = sensor_data_new(SENSOR_DATA_TYPE_INT);
+	sensor_data_window_s window;
+	double timestamps[8];
+	double values[8];
+	unsigned int count = 0;
+	double start = 0.0;
+	int i = 0;
+
+	CHECK(sensor_data_history_window(data, 0.0, &window) < 0);
+	CHECK_INT(sensor_data_history_enable(data, 4), 0);
+
+	start = __now();
+	for (i = 1; i <= 6; i++)
+		sensor_data_set_int(data, i * 10);
+
+	/* Six samples through a ring of four keeps the last four, oldest first */
+	CHECK_INT(sensor_data_history_last(data, 8, timestamps, values, &count), 0);
+	CHECK_INT(count, 4);
+	for (i = 0; i < 4; i++) {
+		CHECK_NEAR(values[i], (i + 3) * 10, 0.0);
+		CHECK(timestamps[i] >= start);
+		if (i)
+			CHECK(timestamps[i] >= timestamps[i - 1]);
+	}
+
+	CHECK_INT(sensor_data_history_last(data, 2, NULL, values, &count), 0);
+	CHECK_INT(count, 2);
+	CHECK_NEAR(values[0], 50, 0.0);
+	CHECK_NEAR(values[1], 60, 0.0);
+
+	CHECK_INT(sensor_data_history_window(data, start, &window), 0);
+	CHECK_INT(window.count, 4);
+	CHECK_NEAR(window.min, 30, 0.0);
+	CHECK_NEAR(window.max, 60, 0.0);
+	CHECK_NEAR(window.mean, 45, 1e-9);
+
+	CHECK_INT(sensor_data_history_window(data, __now() + 1.0, &window), 0);
+	CHECK_INT(window.count, 0);
+
+	/* Every set is a sample, changed or not */
+	sensor_data_set_int(data, 60);
+	CHECK_INT(sensor_data_history_last(data, 8, NULL, values, &count), 0);
+	CHECK_NEAR(values[count - 1], 60, 0.0);
+	CHECK_NEAR(values[0], 40, 0.0);
+
+	CHECK(sensor_data_history_enable(NULL, 4) < 0);
+	sensor_data_free(data);
+}
+
+static void test_strings(void)
+{
+	sensor_data *data = sensor_data_new(SENSOR_DATA_TYPE_STR);
+	const char *held = NULL;
+	const char *value = NULL;
+	unsigned int version = 0;
+
+	CHECK(data != NULL);
+	CHECK(sensor_data_history_enable(data, 4) < 0);
+
+	CHECK_INT(sensor_data_set_string(data, "open", 5), 0);
+	CHECK_INT(sensor_data_get_string(data, &value), 0);
+	CHECK_STR(value, "open");
+	version = sensor_data_get_version(data);
+
+	CHECK_INT(sensor_data_set_string(data, "open", 5), 0);
+	CHECK_INT(sensor_data_get_version(data), version);
+
+	/* The size bounds the copy, the stored value is terminated */
+	CHECK_INT(sensor_data_set_string(data, "closedXYZ", 6), 0);
+	CHECK_INT(sensor_data_get_string(data, &value), 0);
+	CHECK_STR(value, "closed");
+	CHECK_INT(sensor_data_get_version(data), version + 1);
+
+	/* A held snapshot survives any number of later sets */
+	CHECK_INT(sensor_data_acquire_string(data, &held), 0);
+	sensor_data_set_string(data, "a", 2);
+	sensor_data_set_string(data, "b", 2);
+	sensor_data_set_string(data, "c", 2);
+	sensor_data_set_string(data, "d", 2);
+	CHECK_STR(held, "closed");
+	CHECK_INT(sensor_data_get_string(data, &value), 0);
+	CHECK_STR(value, "d");
+	CHECK_INT(sensor_data_release_string(data, held), 0);
+	CHECK(sensor_data_release_string(data, held) < 0);
+
+	CHECK(sensor_data_set_string(data, NULL, 4) < 0);
+	CHECK(sensor_data_set_string(data, "x", 0) < 0);
+	sensor_data_free(data);
+}
+
+static void test_strings_grow(void)
+{
+	sensor_data *data = sensor_data_new(SENSOR_DATA_TYPE_STR);
+	char long_value[201];
+	const char *before = NULL;
+	const char *held = NULL;
+	const char *value = NULL;
+
+	CHECK_INT(sensor_data_set_string(data, "short", 6), 0);
+	CHECK_INT(sensor_data_get_string(data, &before), 0);
+	CHECK_INT(sensor_data_acquire_string(data, &held), 0);
+
+	/* Longer than the default 64 bytes, the slots grow instead of refusing it */
+	memset(long_value, 'x', sizeof(long_value) - 1);
+	long_value[sizeof(long_value) - 1] = '\0';
+	CHECK_INT(sensor_data_set_string(data, long_value, sizeof(long_value)), 0);
+	CHECK_INT(sensor_data_get_string(data, &value), 0);
+	CHECK_STR(value, long_value);
+
+	/* Reserving while a snapshot is held works too, and keeps the value */
+	CHECK_INT(sensor_data_string_reserve(data, 512), 0);
+	CHECK_INT(sensor_data_get_string(data, &value), 0);
+	CHECK_STR(value, long_value);
+
+	/* The pointers from before the growth still read the old value */
+	CHECK_STR(before, "short");
+	CHECK_STR(held, "short");
+	CHECK_INT(sensor_data_release_string(data, held), 0);
+	CHECK(sensor_data_release_string(data, held) < 0);
+	sensor_data_free(data);
+}
+
+static struct {
+	sensor_data *data;
+	int stop;
+} g_str;
+
+static void *__string_writer(void *arg)
+{
+	char buf[33];
+	unsigned int i = 0;
+
+	/* Every value is one letter repeated, a mixed snapshot was written while being read */
+	for (i = 0; !__atomic_load_n(&g_str.stop, __ATOMIC_RELAXED); i++) {
+		unsigned int len = 1 + i % 32;
+		memset(buf, 'a' + i % 26, len);
+		buf[len] = '\0';
+		sensor_data_set_string(g_str.data, buf, sizeof(buf));
+	}
+
+	return NULL;
+}
+
+static void test_string_snapshots_are_stable(void)
+{
+	pthread_t writer;
+	unsigned int mixed = 0;
+	unsigned int i = 0;
+
+	g_str.data = sensor_data_new(SENSOR_DATA_TYPE_STR);
+	g_str.stop = 0;
+	sensor_data_set_string(g_str.data, "a", 2);
+
+	CHECK_INT(pthread_create(&writer, NULL, __string_writer, NULL), 0);
+	for (i = 0; i < STRESS_ROUNDS / 10; i++) {
+		const char *value = NULL;
+		char first = 0;
+		size_t len = 0;
+		size_t j = 0;
+
+		if (sensor_data_acquire_string(g_str.data, &value))
+			continue;
+		first = value[0];
+		len = strlen(value);
+		for (j = 0; j < len; j++)
+			mixed += (value[j] != first);
+		sensor_data_release_string(g_str.data, value);
+	}
+	__atomic_store_n(&g_str.stop, 1, __ATOMIC_RELAXED);
+	pthread_join(writer, NULL);
+
+	CHECK_INT(mixed, 0);
+	sensor_data_free(g_str.data);
+}
+
+int main(void)
+{
+	TEST_RUN(test_scalars_and_version);
+	TEST_RUN(test_double_is_never_torn);
+	TEST_RUN(test_history_ring);
+	TEST_RUN(test_strings);
+	TEST_RUN(test_strings_grow);
+	TEST_RUN(test_string_snapshots_are_stable);
+
+	return TEST_EXIT();
+}
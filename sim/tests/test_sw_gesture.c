@@ -0,0 +1,203 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "resource/resource_sw_gesture.h"
+#include "test.h"
+
+#define PIN 20
+#define EVENTS_MAX 16
+
+static struct {
+	resource_sw_event_s events[EVENTS_MAX];
+	int count;
+} g_seen;
+
+static const resource_sw_gesture_config_s g_config = { 20, 1000, 300, 1 };
+
+static void __event_cb(const resource_sw_event_s *event, void *data)
+{
+	if (g_seen.count < EVENTS_MAX)
+		g_seen.events[g_seen.count] = *event;
+	g_seen.count++;
+}
+
+static void __start(void)
+{
+	memset(&g_seen, 0, sizeof(g_seen));
+	CHECK_INT(resource_sw_gesture_start(PIN, &g_config, __event_cb, NULL), 0);
+}
+
+/* Feeds the level and then lets the given time pass */
+static void __feed(uint32_t level, double hold)
+{
+	CHECK_INT(resource_sw_gesture_feed(PIN, level), 0);
+	test_clock_advance(hold);
+}
+
+static void test_bounces_settle_into_one_press(void)
+{
+	double edge = 0.0;
+
+	__start();
+	edge = test_clock_now();
+	__feed(1, 0.003);
+	__feed(0, 0.002);
+	__feed(1, 0.004);
+	__feed(0, 0.001);
+	__feed(1, 0.019);
+	CHECK_INT(g_seen.count, 0);
+
+	test_clock_advance(0.002);
+	CHECK_INT(g_seen.count, 1);
+	CHECK_INT(g_seen.events[0].type, RESOURCE_SW_EVENT_PRESS);
+	CHECK_INT(g_seen.events[0].pin_num, PIN);
+	/* Stamped with the first edge, not the last bounce */
+	CHECK_NEAR(g_seen.events[0].timestamp, edge, 1e-9);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_glitch_is_ignored(void)
+{
+	__start();
+	__feed(1, 0.005);
+	__feed(0, 0.100);
+	CHECK_INT(g_seen.count, 0);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_click_reports_duration(void)
+{
+	double press = 0.0;
+	double release = 0.0;
+
+	__start();
+	press = test_clock_now();
+	__feed(1, 0.200);
+	release = test_clock_now();
+	__feed(0, 0.002);
+	__feed(1, 0.001);
+	__feed(0, 0.100);
+
+	CHECK_INT(g_seen.count, 2);
+	CHECK_INT(g_seen.events[1].type, RESOURCE_SW_EVENT_RELEASE);
+	CHECK_NEAR(g_seen.events[1].timestamp, release, 1e-9);
+	CHECK_NEAR(g_seen.events[1].duration, release - press, 1e-9);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_double_click(void)
+{
+	__start();
+	__feed(1, 0.100);
+	__feed(0, 0.150);
+	__feed(1, 0.100);
+	__feed(0, 0.100);
+
+	CHECK_INT(g_seen.count, 5);
+	CHECK_INT(g_seen.events[0].type, RESOURCE_SW_EVENT_PRESS);
+	CHECK_INT(g_seen.events[1].type, RESOURCE_SW_EVENT_RELEASE);
+	CHECK_INT(g_seen.events[2].type, RESOURCE_SW_EVENT_PRESS);
+	CHECK_INT(g_seen.events[3].type, RESOURCE_SW_EVENT_DOUBLE_CLICK);
+	CHECK_INT(g_seen.events[4].type, RESOURCE_SW_EVENT_RELEASE);
+
+	/* A third press right away starts a new click, it does not double again */
+	__feed(1, 0.100);
+	CHECK_INT(g_seen.count, 6);
+	CHECK_INT(g_seen.events[5].type, RESOURCE_SW_EVENT_PRESS);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_slow_second_click_is_no_double(void)
+{
+	__start();
+	__feed(1, 0.100);
+	__feed(0, 0.400);
+	__feed(1, 0.100);
+
+	CHECK_INT(g_seen.count, 3);
+	CHECK_INT(g_seen.events[2].type, RESOURCE_SW_EVENT_PRESS);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_long_press(void)
+{
+	double press = 0.0;
+
+	__start();
+	press = test_clock_now();
+	__feed(1, 0.900);
+	CHECK_INT(g_seen.count, 1);
+
+	test_clock_advance(0.200);
+	CHECK_INT(g_seen.count, 2);
+	CHECK_INT(g_seen.events[1].type, RESOURCE_SW_EVENT_LONG_PRESS);
+	CHECK_NEAR(g_seen.events[1].timestamp, press, 1e-9);
+	CHECK_NEAR(g_seen.events[1].duration, 1.0, 1e-9);
+
+	/* The release after a long press does not arm a double click */
+	__feed(0, 0.050);
+	__feed(1, 0.050);
+	CHECK_INT(g_seen.count, 4);
+	CHECK_INT(g_seen.events[3].type, RESOURCE_SW_EVENT_PRESS);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_active_low(void)
+{
+	resource_sw_gesture_config_s config = g_config;
+
+	memset(&g_seen, 0, sizeof(g_seen));
+	config.active_level = 0;
+	CHECK_INT(resource_sw_gesture_start(PIN, &config, __event_cb, NULL), 0);
+	__feed(0, 0.050);
+
+	CHECK_INT(g_seen.count, 1);
+	CHECK_INT(g_seen.events[0].type, RESOURCE_SW_EVENT_PRESS);
+
+	resource_sw_gesture_stop(PIN);
+}
+
+static void test_stop_drops_pending(void)
+{
+	__start();
+	__feed(1, 0.005);
+	resource_sw_gesture_stop(PIN);
+	test_clock_advance(2.0);
+
+	CHECK_INT(g_seen.count, 0);
+	CHECK(resource_sw_gesture_feed(PIN, 1) < 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_bounces_settle_into_one_press);
+	TEST_RUN(test_glitch_is_ignored);
+	TEST_RUN(test_click_reports_duration);
+	TEST_RUN(test_double_click);
+	TEST_RUN(test_slow_second_click_is_no_double);
+	TEST_RUN(test_long_press);
+	TEST_RUN(test_active_low);
+	TEST_RUN(test_stop_drops_pending);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,248 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "peripheral_sim.h"
+#include "resource_internal.h"
+#include "resource/resource_sw_sensor.h"
+#include "resource/resource_io_worker.h"
+#include "test.h"
+
+#define SW_1 20
+#define SW_2 21
+#define SW_3 16
+#define EDGES_MAX 8
+
+typedef struct {
+	int count;
+	double levels[EDGES_MAX];
+} edges_s;
+
+static edges_s g_edges[2];
+static sem_t g_blocker;
+
+static void __edge_cb(double value, void *data)
+{
+	edges_s *edges = data;
+
+	if (edges->count < EDGES_MAX)
+		edges->levels[edges->count] = value;
+	edges->count++;
+}
+
+static int __block_work(void *data)
+{
+	sem_wait(&g_blocker);
+	return 0;
+}
+
+static int __nop_work(void *data)
+{
+	return 0;
+}
+
+/* Lets the worker run and the main loop take its completions back until the edges came */
+static void __wait_edges(const edges_s *edges, int count)
+{
+	struct timespec pause = { 0, 1000000 };
+	int i = 0;
+
+	for (i = 0; i < 2000 && edges->count < count; i++) {
+		nanosleep(&pause, NULL);
+		test_loop_iterate();
+	}
+}
+
+static void __levels_reset(void)
+{
+	peripheral_sim_gpio_set_level(SW_1, 0);
+	peripheral_sim_gpio_set_level(SW_2, 0);
+	peripheral_sim_gpio_set_level(SW_3, 0);
+	memset(g_edges, 0, sizeof(g_edges));
+}
+
+static void test_edges_reach_their_own_callback(void)
+{
+	__levels_reset();
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_1, __edge_cb, &g_edges[0]), 0);
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_2, __edge_cb, &g_edges[1]), 0);
+
+	/* Both edges, with the level read after each */
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	peripheral_sim_gpio_set_level(SW_2, 1);
+	peripheral_sim_gpio_set_level(SW_1, 0);
+	test_loop_iterate();
+
+	CHECK_INT(g_edges[0].count, 2);
+	CHECK_NEAR(g_edges[0].levels[0], 1.0, 0.0);
+	CHECK_NEAR(g_edges[0].levels[1], 0.0, 0.0);
+	CHECK_INT(g_edges[1].count, 1);
+	CHECK_NEAR(g_edges[1].levels[0], 1.0, 0.0);
+
+	/* A second registration replaces the first */
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_2, __edge_cb, &g_edges[0]), 0);
+	peripheral_sim_gpio_set_level(SW_2, 0);
+	test_loop_iterate();
+	CHECK_INT(g_edges[0].count, 3);
+	CHECK_INT(g_edges[1].count, 1);
+
+	CHECK(resource_set_sw_sensor_interrupted_cb(SW_1, NULL, NULL) < 0);
+	CHECK(resource_set_sw_sensor_interrupted_cb(PIN_MAX, __edge_cb, &g_edges[0]) < 0);
+
+	resource_close_sw_sensor(SW_1);
+	resource_close_sw_sensor(SW_2);
+}
+
+static void test_unset_falls_back_to_reads(void)
+{
+	uint32_t value = 0;
+
+	__levels_reset();
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_1, __edge_cb, &g_edges[0]), 0);
+	CHECK_INT(resource_unset_sw_sensor_interrupted_cb(SW_1), 0);
+	CHECK_INT(resource_unset_sw_sensor_interrupted_cb(SW_1), 0);
+
+	/* The pin stays open for plain reads, its edges go unreported */
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	test_loop_iterate();
+	CHECK_INT(g_edges[0].count, 0);
+	CHECK_INT(resource_read_sw_sensor(SW_1, &value), 0);
+	CHECK_INT(value, 1);
+
+	resource_close_sw_sensor(SW_1);
+}
+
+static void test_polled_level_masks(void)
+{
+	uint64_t mask = (1ULL << SW_1) | (1ULL << SW_2) | (1ULL << SW_3);
+	uint64_t levels = ~0ULL;
+
+	__levels_reset();
+	CHECK_INT(resource_read_sw_sensors(mask, &levels), 0);
+	CHECK_INT(levels, 0);
+
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	peripheral_sim_gpio_set_level(SW_3, 1);
+	CHECK_INT(resource_read_sw_sensors(mask, &levels), 0);
+	CHECK_INT(levels, (1ULL << SW_1) | (1ULL << SW_3));
+
+	/* Only the asked pins show up */
+	CHECK_INT(resource_read_sw_sensors(1ULL << SW_2, &levels), 0);
+	CHECK_INT(levels, 0);
+
+	CHECK(resource_read_sw_sensors(mask, NULL) < 0);
+	CHECK(resource_read_sw_sensors(1ULL << PIN_MAX, &levels) < 0);
+
+	resource_close_sw_sensor(SW_1);
+	resource_close_sw_sensor(SW_2);
+	resource_close_sw_sensor(SW_3);
+}
+
+static void test_close_drops_the_callback(void)
+{
+	uint32_t value = 0;
+
+	__levels_reset();
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_1, __edge_cb, &g_edges[0]), 0);
+	resource_close_sw_sensor(SW_1);
+	CHECK_INT(resource_get_info(SW_1)->opened, 0);
+	CHECK(resource_get_info(SW_1)->resource_read_info == NULL);
+
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	test_loop_iterate();
+	CHECK_INT(g_edges[0].count, 0);
+
+	/* Closed twice or unset after close does nothing */
+	resource_close_sw_sensor(SW_1);
+	CHECK(resource_unset_sw_sensor_interrupted_cb(SW_1) < 0);
+
+	/* A read opens the pin again */
+	CHECK_INT(resource_read_sw_sensor(SW_1, &value), 0);
+	CHECK_INT(value, 1);
+	CHECK_INT(resource_get_info(SW_1)->opened, 1);
+
+	resource_close_sw_sensor(SW_1);
+}
+
+static void test_edges_read_on_the_worker(void)
+{
+	uint32_t value = 0;
+
+	__levels_reset();
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_1, __edge_cb, &g_edges[0]), 0);
+	CHECK_INT(resource_io_worker_start(), 0);
+
+	/* With the queue full the edges wait for one read, which gets the level after the last of them */
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	while (resource_io_submit(__nop_work, NULL, NULL) == 0)
+		;
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	peripheral_sim_gpio_set_level(SW_1, 0);
+	peripheral_sim_gpio_set_level(SW_1, 1);
+	test_loop_iterate();
+	CHECK_INT(g_edges[0].count, 0);
+
+	/* The queued read still needs the handle */
+	resource_close_sw_sensor(SW_1);
+	CHECK_INT(resource_get_info(SW_1)->opened, 1);
+
+	sem_post(&g_blocker);
+	__wait_edges(&g_edges[0], 1);
+	CHECK_INT(g_edges[0].count, 1);
+	CHECK_NEAR(g_edges[0].levels[0], 1.0, 0.0);
+
+	/* The level before the first edge, through the same path */
+	CHECK_INT(resource_refresh_sw_sensor(SW_1), 0);
+	CHECK_INT(g_edges[0].count, 1);
+	__wait_edges(&g_edges[0], 2);
+	CHECK_INT(g_edges[0].count, 2);
+	CHECK_NEAR(g_edges[0].levels[1], 1.0, 0.0);
+
+	/* Unset while the read is on the worker, the level goes nowhere */
+	CHECK_INT(resource_io_submit(__block_work, NULL, NULL), 0);
+	peripheral_sim_gpio_set_level(SW_1, 0);
+	CHECK_INT(resource_unset_sw_sensor_interrupted_cb(SW_1), 0);
+	CHECK(resource_refresh_sw_sensor(SW_1) < 0);
+	sem_post(&g_blocker);
+	resource_io_worker_stop();
+	CHECK_INT(g_edges[0].count, 2);
+
+	/* Without the worker the read is done right away */
+	CHECK_INT(resource_set_sw_sensor_interrupted_cb(SW_1, __edge_cb, &g_edges[1]), 0);
+	CHECK_INT(resource_refresh_sw_sensor(SW_1), 0);
+	CHECK_INT(g_edges[1].count, 1);
+	CHECK_NEAR(g_edges[1].levels[0], 0.0, 0.0);
+
+	resource_close_sw_sensor(SW_1);
+	CHECK(resource_refresh_sw_sensor(SW_1) < 0);
+	CHECK(resource_read_sw_sensor(PIN_MAX, &value) < 0);
+}
+
+int main(void)
+{
+	sem_init(&g_blocker, 0, 0);
+
+	TEST_RUN(test_edges_reach_their_own_callback);
+	TEST_RUN(test_unset_falls_back_to_reads);
+	TEST_RUN(test_polled_level_masks);
+	TEST_RUN(test_close_drops_the_callback);
+	TEST_RUN(test_edges_read_on_the_worker);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,95 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "tracing.h"
+#include "test.h"
+
+#define TEST_EVENTS_MAX 16
+
+/* The "ph" of each event in the trace file, with the name for the begins, like "B:outer" */
+static int __read_events(char events[][32], int max)
+{
+	const char *dir = getenv("LEDSW_TEST_DATA");
+	char path[PATH_MAX];
+	char line[256];
+	FILE *fp = NULL;
+	int count = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dir && *dir ? dir : ".", TRACING_FILE_DEFAULT);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp) && count < max) {
+		char name[16] = { 0, };
+		char ph = 0;
+
+		if (sscanf(line, "{\"name\":\"%15[^\"]\",\"ph\":\"%c\"", name, &ph) == 2)
+			snprintf(events[count++], 32, "%c:%s", ph, name);
+		else if (sscanf(line, "{\"ph\":\"%c\"", &ph) == 1)
+			snprintf(events[count++], 32, "%c", ph);
+	}
+	fclose(fp);
+
+	return count;
+}
+
+static void test_toggles_keep_spans_paired(void)
+{
+	char events[TEST_EVENTS_MAX][32];
+
+	unsetenv("LEDSW_TRACE");
+	unsetenv("LEDSW_TRACE_FILE");
+	CHECK_INT(tracing_init(), 0);
+	CHECK_INT(tracing_set_enabled(1), 0);
+
+	/* Switched off inside a span, the inner end must not close the outer one */
+	TRACE_BEGIN("outer");
+	tracing_set_enabled(0);
+	TRACE_BEGIN("hidden");
+	TRACE_END();
+	CHECK_INT(tracing_depth, 1);
+	TRACE_END();
+	CHECK_INT(tracing_depth, 0);
+
+	/* Switched on inside a span, only the spans begun afterwards are recorded */
+	TRACE_BEGIN("unseen");
+	tracing_set_enabled(1);
+	TRACE_BEGIN("inner");
+	TRACE_END();
+	TRACE_END();
+	CHECK_INT(tracing_depth, 0);
+
+	tracing_fini();
+
+	/* The file lands in the app data directory */
+	CHECK_INT(__read_events(events, TEST_EVENTS_MAX), 5);
+	CHECK_STR(events[0], "B:outer");
+	CHECK_STR(events[1], "E");
+	CHECK_STR(events[2], "B:inner");
+	CHECK_STR(events[3], "E");
+	CHECK_STR(events[4], "M:process_name");
+}
+
+int main(void)
+{
+	TEST_RUN(test_toggles_keep_spans_paired);
+
+	return TEST_EXIT();
+}
@@ -0,0 +1,138 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "adaptive-sampler.h"
+#include "tracing.h"
+
+struct __adaptive_sampler_s {
+	adaptive_sampler_config_s config;
+	double interval;
+	int sampling;
+	Ecore_Timer *timer;
+	adaptive_sampler_cb cb;
+	void *data;
+};
+
+static void __adaptive_sampler_set(adaptive_sampler *sampler, double interval)
+{
+	if (interval < sampler->config.min_interval)
+		interval = sampler->config.min_interval;
+	else if (interval > sampler->config.max_interval)
+		interval = sampler->config.max_interval;
+
+	if (interval == sampler->interval)
+		return;
+
+	_D("Sampling interval %.3f -> %.3f", sampler->interval, interval);
+	sampler->interval = interval;
+	/* Ecore picks the new interval up when the timer is renewed */
+	ecore_timer_interval_set(sampler->timer, interval);
+}
+
+static Eina_Bool __adaptive_sampler_tick(void *data)
+{
+	adaptive_sampler *sampler = data;
+	int ret = 0;
+
+	TRACE_BEGIN("sampler_tick");
+	sampler->sampling = 1;
+	ret = sampler->cb(sampler->data);
+	sampler->sampling = 0;
+
+	if (ret > 0)
+		__adaptive_sampler_set(sampler, sampler->config.min_interval);
+	else
+		__adaptive_sampler_set(sampler, sampler->interval * sampler->config.backoff);
+	TRACE_END();
+
+	return ECORE_CALLBACK_RENEW;
+}
+
+adaptive_sampler *adaptive_sampler_start(const adaptive_sampler_config_s *config, adaptive_sampler_cb cb, void *data)
+{
+	adaptive_sampler *sampler = NULL;
+
+	retv_if(!config, NULL);
+	retv_if(!cb, NULL);
+	retvm_if(config->min_interval <= 0.0 || config->max_interval < config->min_interval, NULL,
+			"Invalid intervals : %f, %f", config->min_interval, config->max_interval);
+	retvm_if(config->backoff < 1.0, NULL, "Invalid backoff : %f", config->backoff);
+
+	sampler = calloc(1, sizeof(adaptive_sampler));
+	retv_if(!sampler, NULL);
+
+	sampler->config = *config;
+	sampler->interval = config->min_interval;
+	sampler->cb = cb;
+	sampler->data = data;
+
+	sampler->timer = ecore_timer_add(sampler->interval, __adaptive_sampler_tick, sampler);
+	if (!sampler->timer) {
+		_E("Failed to add sampling timer");
+		free(sampler);
+		return NULL;
+	}
+
+	return sampler;
+}
+
+void adaptive_sampler_stop(adaptive_sampler *sampler)
+{
+	ret_if(!sampler);
+
+	ecore_timer_del(sampler->timer);
+	free(sampler);
+}
+
+void adaptive_sampler_poke(adaptive_sampler *sampler)
+{
+	ret_if(!sampler);
+
+	if (sampler->interval == sampler->config.min_interval)
+		return;
+
+	__adaptive_sampler_set(sampler, sampler->config.min_interval);
+	/* Restarts the countdown, so a long idle wait is cut short, a running sample renews it anyway */
+	if (!sampler->sampling)
+		ecore_timer_reset(sampler->timer);
+}
+
+int adaptive_sampler_set_min_interval(adaptive_sampler *sampler, double min_interval)
+{
+	retv_if(!sampler, -1);
+	retvm_if(min_interval <= 0.0, -1, "Invalid interval : %f", min_interval);
+
+	if (min_interval == sampler->config.min_interval)
+		return 0;
+
+	sampler->config.min_interval = min_interval;
+	if (sampler->config.max_interval < min_interval)
+		sampler->config.max_interval = min_interval;
+
+	__adaptive_sampler_set(sampler, sampler->interval);
+
+	return 0;
+}
+
+double adaptive_sampler_get_interval(const adaptive_sampler *sampler)
+{
+	retv_if(!sampler, -1.0);
+
+	return sampler->interval;
+}
@@ -0,0 +1,647 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "resource_internal.h"
+#include "device-config.h"
+
+#define CONFIG_SECTION "ledsw"
+#define CONFIG_IMAGE_MAGIC 0x4746434cU /* "LCFG" */
+#define CONFIG_IMAGE_VERSION 3 /* Bumped on every change of config_image_s or of the values accepted */
+#define JSON_DEPTH_MAX 16
+
+/* Used in place, the strings follow the header and the image ends with the NUL of the last one */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; /* The whole image, strings included */
+	uint32_t defaults_hash; /* The defaults the missing keys were taken from */
+	int64_t source_mtime; /* In nanoseconds */
+	int64_t source_size;
+	int32_t pins[DEVICE_CONFIG_PIN_MAX];
+	int32_t i2c_bus;
+	double intervals[DEVICE_CONFIG_INTERVAL_MAX];
+	double backoff;
+	uint32_t uris[DEVICE_CONFIG_URI_MAX]; /* Offsets from the start of the image */
+	int32_t lamp[DEVICE_CONFIG_LAMP_MAX];
+} config_image_s;
+
+typedef int (*json_member_cb)(char **cur, const char *key, device_config_s *values, int depth);
+
+static struct {
+	device_config_s defaults;
+	config_image_s *image; /* NULL while running on the defaults */
+	size_t mapped; /* The mapping length, 0 if the image was compiled by this process */
+} g_config;
+
+static const char *g_pin_names[DEVICE_CONFIG_PIN_MAX] = { "sw", "led1", "led2" };
+static const char *g_interval_names[DEVICE_CONFIG_INTERVAL_MAX] = {
+	"sensor", "illuminance", "sw_min", "illuminance_min", "notify_illuminance", "notify_door"
+};
+static const char *g_uri_names[DEVICE_CONFIG_URI_MAX] = { "illuminance", "door" };
+static const char *g_lamp_names[DEVICE_CONFIG_LAMP_MAX] = { "chip", "channel", "period_ns", "target_lux" };
+
+static uint32_t __hash(uint32_t hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	size_t i = 0;
+
+	/* FNV-1a */
+	for (i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static uint32_t __defaults_hash(const device_config_s *defaults)
+{
+	uint32_t hash = 2166136261U;
+	int i = 0;
+
+	hash = __hash(hash, defaults->pins, sizeof(defaults->pins));
+	hash = __hash(hash, &defaults->i2c_bus, sizeof(defaults->i2c_bus));
+	hash = __hash(hash, defaults->intervals, sizeof(defaults->intervals));
+	hash = __hash(hash, &defaults->backoff, sizeof(defaults->backoff));
+	hash = __hash(hash, defaults->lamp, sizeof(defaults->lamp));
+	for (i = 0; i < DEVICE_CONFIG_URI_MAX; i++) {
+		if (defaults->uris[i])
+			hash = __hash(hash, defaults->uris[i], strlen(defaults->uris[i]) + 1);
+	}
+
+	return hash;
+}
+
+static inline int64_t __mtime(const struct stat *st)
+{
+	return (int64_t) st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+/* A small reader for the definition, strings are unescaped in place */
+
+static void __json_ws(char **cur)
+{
+	while (**cur == ' ' || **cur == '\t' || **cur == '\n' || **cur == '\r')
+		(*cur)++;
+}
+
+static int __json_string(char **cur, char **out)
+{
+	char *src = NULL;
+	char *dst = NULL;
+
+	__json_ws(cur);
+	if (**cur != '"')
+		return -1;
+
+	*out = dst = src = *cur + 1;
+	while (*src != '"') {
+		if (!*src)
+			return -1;
+
+		if (*src == '\\') {
+			src++;
+			switch (*src) {
+			case '"':
+			case '\\':
+			case '/':
+				break;
+			case 'n':
+				*src = '\n';
+				break;
+			case 't':
+				*src = '\t';
+				break;
+			default:
+				/* \u and the rest are not needed for names and URIs */
+				return -1;
+			}
+		}
+		*dst++ = *src++;
+	}
+
+	*cur = src + 1;
+	*dst = '\0';
+
+	return 0;
+}
+
+static int __json_number(char **cur, double *out)
+{
+	char *end = NULL;
+
+	__json_ws(cur);
+	*out = strtod(*cur, &end);
+	if (end == *cur)
+		return -1;
+	*cur = end;
+
+	return 0;
+}
+
+static int __json_int(char **cur, int *out)
+{
+	double value = 0.0;
+
+	if (__json_number(cur, &value))
+		return -1;
+	if (!(value >= 0.0 && value <= INT_MAX) || value != (int) value)
+		return -1;
+	*out = (int) value;
+
+	return 0;
+}
+
+static int __json_object(char **cur, json_member_cb cb, device_config_s *values, int depth);
+
+static int __json_skip(char **cur, int depth)
+{
+	char *str = NULL;
+	double number = 0.0;
+
+	if (depth > JSON_DEPTH_MAX)
+		return -1;
+
+	__json_ws(cur);
+	switch (**cur) {
+	case '"':
+		return __json_string(cur, &str);
+	case '{':
+		return __json_object(cur, NULL, NULL, depth + 1);
+	case '[':
+		(*cur)++;
+		__json_ws(cur);
+		if (**cur == ']') {
+			(*cur)++;
+			return 0;
+		}
+		for (;;) {
+			if (__json_skip(cur, depth + 1))
+				return -1;
+			__json_ws(cur);
+			if (**cur == ']') {
+				(*cur)++;
+				return 0;
+			}
+			if (**cur != ',')
+				return -1;
+			(*cur)++;
+		}
+	case 't':
+		*cur += strncmp(*cur, "true", 4) ? 0 : 4;
+		return **cur == 't' ? -1 : 0;
+	case 'f':
+		*cur += strncmp(*cur, "false", 5) ? 0 : 5;
+		return **cur == 'f' ? -1 : 0;
+	case 'n':
+		*cur += strncmp(*cur, "null", 4) ? 0 : 4;
+		return **cur == 'n' ? -1 : 0;
+	default:
+		return __json_number(cur, &number);
+	}
+}
+
+/* Members without a callback are skipped */
+static int __json_object(char **cur, json_member_cb cb, device_config_s *values, int depth)
+{
+	char *key = NULL;
+
+	if (depth > JSON_DEPTH_MAX)
+		return -1;
+
+	__json_ws(cur);
+	if (**cur != '{')
+		return -1;
+	(*cur)++;
+
+	__json_ws(cur);
+	if (**cur == '}') {
+		(*cur)++;
+		return 0;
+	}
+
+	for (;;) {
+		if (__json_string(cur, &key))
+			return -1;
+		__json_ws(cur);
+		if (**cur != ':')
+			return -1;
+		(*cur)++;
+
+		if (cb ? cb(cur, key, values, depth) : __json_skip(cur, depth))
+			return -1;
+
+		__json_ws(cur);
+		if (**cur == '}') {
+			(*cur)++;
+			return 0;
+		}
+		if (**cur != ',')
+			return -1;
+		(*cur)++;
+	}
+}
+
+static int __find_name(const char **names, int count, const char *key)
+{
+	int i = 0;
+
+	for (i = 0; i < count; i++) {
+		if (!strcmp(names[i], key))
+			return i;
+	}
+
+	return -1;
+}
+
+static int __parse_pins(char **cur, const char *key, device_config_s *values, int depth)
+{
+	int i = __find_name(g_pin_names, DEVICE_CONFIG_PIN_MAX, key);
+
+	if (i < 0)
+		return __json_skip(cur, depth);
+
+	if (__json_int(cur, &values->pins[i]))
+		return -1;
+
+	return values->pins[i] < PIN_MAX ? 0 : -1;
+}
+
+static int __parse_intervals(char **cur, const char *key, device_config_s *values, int depth)
+{
+	int i = __find_name(g_interval_names, DEVICE_CONFIG_INTERVAL_MAX, key);
+
+	if (i < 0)
+		return __json_skip(cur, depth);
+
+	if (__json_number(cur, &values->intervals[i]))
+		return -1;
+
+	/* Only the illuminance sensor can be left off, the samplers and notifications need a period */
+	if (i == DEVICE_CONFIG_INTERVAL_ILLUMINANCE)
+		return values->intervals[i] >= 0.0 ? 0 : -1;
+
+	return values->intervals[i] > 0.0 ? 0 : -1;
+}
+
+static int __parse_uris(char **cur, const char *key, device_config_s *values, int depth)
+{
+	int i = __find_name(g_uri_names, DEVICE_CONFIG_URI_MAX, key);
+	char *uri = NULL;
+
+	if (i < 0)
+		return __json_skip(cur, depth);
+
+	if (__json_string(cur, &uri) || !*uri)
+		return -1;
+	values->uris[i] = uri;
+
+	return 0;
+}
+
+static int __parse_lamp(char **cur, const char *key, device_config_s *values, int depth)
+{
+	int i = __find_name(g_lamp_names, DEVICE_CONFIG_LAMP_MAX, key);
+
+	if (i < 0)
+		return __json_skip(cur, depth);
+
+	return __json_int(cur, &values->lamp[i]);
+}
+
+static int __parse_section(char **cur, const char *key, device_config_s *values, int depth)
+{
+	if (!strcmp(key, "i2c_bus"))
+		return __json_int(cur, &values->i2c_bus);
+
+	if (!strcmp(key, "pins"))
+		return __json_object(cur, __parse_pins, values, depth + 1);
+
+	if (!strcmp(key, "intervals"))
+		return __json_object(cur, __parse_intervals, values, depth + 1);
+
+	if (!strcmp(key, "backoff")) {
+		if (__json_number(cur, &values->backoff))
+			return -1;
+		/* The sampler needs a factor above 1 to slow down at all */
+		return values->backoff > 1.0 ? 0 : -1;
+	}
+
+	if (!strcmp(key, "uris"))
+		return __json_object(cur, __parse_uris, values, depth + 1);
+
+	if (!strcmp(key, "lamp"))
+		return __json_object(cur, __parse_lamp, values, depth + 1);
+
+	return __json_skip(cur, depth);
+}
+
+static int __parse_root(char **cur, const char *key, device_config_s *values, int depth)
+{
+	if (strcmp(key, CONFIG_SECTION))
+		return __json_skip(cur, depth);
+
+	return __json_object(cur, __parse_section, values, depth + 1);
+}
+
+/* What a single key cannot check, once the whole definition is read */
+static int __values_check(const device_config_s *values)
+{
+	int i = 0;
+	int j = 0;
+
+	for (i = 0; i < DEVICE_CONFIG_PIN_MAX; i++) {
+		for (j = i + 1; j < DEVICE_CONFIG_PIN_MAX; j++)
+			retvm_if(values->pins[i] == values->pins[j], -1, "Pins %s and %s are both %d",
+					g_pin_names[i], g_pin_names[j], values->pins[i]);
+	}
+
+	return 0;
+}
+
+static char *__read_file(const char *path)
+{
+	FILE *fp = NULL;
+	char *buf = NULL;
+	long size = 0;
+
+	fp = fopen(path, "r");
+	retv_if(!fp, NULL);
+
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET)) {
+		fclose(fp);
+		return NULL;
+	}
+
+	buf = malloc(size + 1);
+	if (buf && fread(buf, 1, size, fp) != (size_t) size) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	retv_if(!buf, NULL);
+	buf[size] = '\0';
+
+	return buf;
+}
+
+static config_image_s *__image_compile(const char *source, const struct stat *st, uint32_t hash)
+{
+	device_config_s values = g_config.defaults;
+	config_image_s *image = NULL;
+	char *buf = NULL;
+	char *cur = NULL;
+	size_t size = sizeof(config_image_s);
+	size_t offset = 0;
+	int i = 0;
+
+	buf = __read_file(source);
+	retvm_if(!buf, NULL, "Cannot read %s", source);
+
+	cur = buf;
+	if (__json_object(&cur, __parse_root, &values, 0)) {
+		_E("Invalid device definition %s at offset %ld", source, (long) (cur - buf));
+		free(buf);
+		return NULL;
+	}
+
+	if (__values_check(&values)) {
+		_E("Invalid device definition %s", source);
+		free(buf);
+		return NULL;
+	}
+
+	for (i = 0; i < DEVICE_CONFIG_URI_MAX; i++)
+		size += values.uris[i] ? strlen(values.uris[i]) + 1 : 1;
+
+	image = calloc(1, size);
+	if (!image) {
+		free(buf);
+		return NULL;
+	}
+
+	image->magic = CONFIG_IMAGE_MAGIC;
+	image->version = CONFIG_IMAGE_VERSION;
+	image->size = size;
+	image->defaults_hash = hash;
+	image->source_mtime = __mtime(st);
+	image->source_size = st->st_size;
+	for (i = 0; i < DEVICE_CONFIG_PIN_MAX; i++)
+		image->pins[i] = values.pins[i];
+	image->i2c_bus = values.i2c_bus;
+	for (i = 0; i < DEVICE_CONFIG_INTERVAL_MAX; i++)
+		image->intervals[i] = values.intervals[i];
+	image->backoff = values.backoff;
+	for (i = 0; i < DEVICE_CONFIG_LAMP_MAX; i++)
+		image->lamp[i] = values.lamp[i];
+
+	offset = sizeof(config_image_s);
+	for (i = 0; i < DEVICE_CONFIG_URI_MAX; i++) {
+		const char *uri = values.uris[i] ? values.uris[i] : "";
+
+		image->uris[i] = offset;
+		strcpy((char *) image + offset, uri);
+		offset += strlen(uri) + 1;
+	}
+	free(buf);
+
+	return image;
+}
+
+static int __image_write(const char *cache, const config_image_s *image)
+{
+	char *tmp_path = NULL;
+	FILE *fp = NULL;
+	int ret = 0;
+
+	/* A process mapping the old image keeps it, the next start maps the new one */
+	tmp_path = malloc(strlen(cache) + sizeof(".tmp"));
+	retv_if(!tmp_path, -1);
+	sprintf(tmp_path, "%s.tmp", cache);
+
+	fp = fopen(tmp_path, "wb");
+	if (!fp) {
+		free(tmp_path);
+		return -1;
+	}
+
+	if (fwrite(image, 1, image->size, fp) != image->size)
+		ret = -1;
+	if (fclose(fp) || ret || rename(tmp_path, cache)) {
+		unlink(tmp_path);
+		ret = -1;
+	}
+	free(tmp_path);
+
+	return ret;
+}
+
+/* Only looks at the header, loading time does not grow with the image */
+static int __image_check(const config_image_s *image, size_t size, const struct stat *source, uint32_t hash)
+{
+	int i = 0;
+
+	if (image->magic != CONFIG_IMAGE_MAGIC || image->version != CONFIG_IMAGE_VERSION || image->size != size)
+		return -1;
+
+	if (((const char *) image)[size - 1] != '\0')
+		return -1;
+
+	for (i = 0; i < DEVICE_CONFIG_URI_MAX; i++) {
+		if (image->uris[i] < sizeof(config_image_s) || image->uris[i] >= size)
+			return -1;
+	}
+
+	/* Stale once the definition or the compiled in defaults changed */
+	if (image->source_mtime != __mtime(source) || image->source_size != source->st_size
+			|| image->defaults_hash != hash)
+		return -1;
+
+	return 0;
+}
+
+static int __image_map(const char *cache, const struct stat *source, uint32_t hash)
+{
+	struct stat st;
+	void *image = NULL;
+	int fd = -1;
+
+	fd = open(cache, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(config_image_s)) {
+		close(fd);
+		return -1;
+	}
+
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	retvm_if(image == MAP_FAILED, -1, "Cannot map %s", cache);
+
+	if (__image_check(image, st.st_size, source, hash)) {
+		_D("%s is out of date", cache);
+		munmap(image, st.st_size);
+		return -1;
+	}
+
+	g_config.image = image;
+	g_config.mapped = st.st_size;
+
+	return 0;
+}
+
+int device_config_load(const char *source, const char *cache, const device_config_s *defaults)
+{
+	struct stat st;
+	config_image_s *image = NULL;
+	uint32_t hash = 0;
+
+	retv_if(!defaults, -1);
+
+	device_config_unload();
+	g_config.defaults = *defaults;
+
+	if (!source || stat(source, &st)) {
+		_I("No device definition, running on the defaults");
+		return 0;
+	}
+
+	hash = __defaults_hash(defaults);
+	if (cache && !__image_map(cache, &st, hash)) {
+		_I("Mapped the device configuration from %s", cache);
+		return 0;
+	}
+
+	image = __image_compile(source, &st, hash);
+	if (!image) {
+		_E("Running on the default device configuration");
+		return 0;
+	}
+
+	if (cache && __image_write(cache, image))
+		_W("Cannot cache the device configuration in %s", cache);
+
+	_I("Compiled %s into a %u byte image", source, image->size);
+	g_config.image = image;
+
+	return 0;
+}
+
+void device_config_unload(void)
+{
+	if (!g_config.image)
+		return;
+
+	if (g_config.mapped)
+		munmap(g_config.image, g_config.mapped);
+	else
+		free(g_config.image);
+
+	g_config.image = NULL;
+	g_config.mapped = 0;
+}
+
+int device_config_get_pin(device_config_pin_e pin)
+{
+	retv_if(pin >= DEVICE_CONFIG_PIN_MAX, -1);
+
+	return g_config.image ? g_config.image->pins[pin] : g_config.defaults.pins[pin];
+}
+
+int device_config_get_i2c_bus(void)
+{
+	return g_config.image ? g_config.image->i2c_bus : g_config.defaults.i2c_bus;
+}
+
+double device_config_get_interval(device_config_interval_e interval)
+{
+	retv_if(interval >= DEVICE_CONFIG_INTERVAL_MAX, -1.0);
+
+	return g_config.image ? g_config.image->intervals[interval] : g_config.defaults.intervals[interval];
+}
+
+double device_config_get_backoff(void)
+{
+	return g_config.image ? g_config.image->backoff : g_config.defaults.backoff;
+}
+
+const char *device_config_get_uri(device_config_uri_e uri)
+{
+	retv_if(uri >= DEVICE_CONFIG_URI_MAX, NULL);
+
+	if (g_config.image)
+		return (const char *) g_config.image + g_config.image->uris[uri];
+
+	return g_config.defaults.uris[uri];
+}
+
+int device_config_get_lamp(device_config_lamp_e lamp)
+{
+	retv_if(lamp >= DEVICE_CONFIG_LAMP_MAX, -1);
+
+	return g_config.image ? g_config.image->lamp[lamp] : g_config.defaults.lamp[lamp];
+}
@@ -0,0 +1,176 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "resource.h"
+#include "led-sequence.h"
+#include "tracing.h"
+
+struct __led_sequence_s {
+	const led_step_s *steps;
+	unsigned int count;
+	unsigned int repeat;
+	unsigned int index;
+	Ecore_Timer *timer;
+	led_sequence_done_cb cb;
+	void *data;
+};
+
+/* The sequence currently driving each pin, so patterns on different pins run side by side */
+static led_sequence *g_pin_owner[PIN_MAX] = { NULL, };
+
+static void __led_sequence_release(led_sequence *seq)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < seq->count; i++) {
+		int pin_num = seq->steps[i].pin_num;
+		if (pin_num >= 0 && g_pin_owner[pin_num] == seq)
+			g_pin_owner[pin_num] = NULL;
+	}
+
+	if (seq->timer)
+		ecore_timer_del(seq->timer);
+
+	free(seq);
+}
+
+static Eina_Bool __led_sequence_tick(void *data);
+
+/* Runs steps until one has to be waited on, returns -1 once the sequence is over */
+static int __led_sequence_advance(led_sequence *seq)
+{
+	const led_step_s *step = NULL;
+	uint64_t mask = 0;
+	uint64_t values = 0;
+
+	while (1) {
+		if (seq->index == seq->count) {
+			if (seq->repeat == 1)
+				break;
+			if (seq->repeat)
+				seq->repeat--;
+			seq->index = 0;
+		}
+
+		/* Steps that do not wait are collected and written as one batch */
+		step = &seq->steps[seq->index++];
+		if (step->pin_num >= 0) {
+			mask |= 1ULL << step->pin_num;
+			if (step->value)
+				values |= 1ULL << step->pin_num;
+			else
+				values &= ~(1ULL << step->pin_num);
+		}
+
+		if (step->duration_ms) {
+			if (mask)
+				resource_write_leds(mask, values);
+			seq->timer = ecore_timer_add(step->duration_ms / 1000.0, __led_sequence_tick, seq);
+			retv_if(!seq->timer, -1);
+			return 0;
+		}
+	}
+
+	if (mask)
+		resource_write_leds(mask, values);
+
+	return -1;
+}
+
+static Eina_Bool __led_sequence_tick(void *data)
+{
+	led_sequence *seq = data;
+
+	TRACE_BEGIN("led_sequence_tick");
+	seq->timer = NULL;
+
+	if (__led_sequence_advance(seq) < 0) {
+		led_sequence_done_cb cb = seq->cb;
+		void *cb_data = seq->data;
+
+		__led_sequence_release(seq);
+		if (cb)
+			cb(seq, cb_data);
+	}
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+led_sequence *led_sequence_play(const led_step_s *steps, unsigned int count, unsigned int repeat, led_sequence_done_cb cb, void *data)
+{
+	led_sequence *seq = NULL;
+	unsigned int total_ms = 0;
+	unsigned int i = 0;
+
+	retv_if(!steps, NULL);
+	retv_if(count == 0, NULL);
+
+	for (i = 0; i < count; i++) {
+		retvm_if(steps[i].pin_num >= PIN_MAX, NULL, "Invalid pin number : %d", steps[i].pin_num);
+		total_ms += steps[i].duration_ms;
+	}
+	retvm_if(repeat == 0 && total_ms == 0, NULL, "Endless sequence must take time");
+
+	seq = calloc(1, sizeof(led_sequence));
+	retv_if(!seq, NULL);
+
+	seq->steps = steps;
+	seq->count = count;
+	seq->repeat = repeat;
+	seq->cb = cb;
+	seq->data = data;
+
+	for (i = 0; i < count; i++) {
+		int pin_num = steps[i].pin_num;
+		if (pin_num < 0)
+			continue;
+		if (g_pin_owner[pin_num] && g_pin_owner[pin_num] != seq)
+			led_sequence_stop(g_pin_owner[pin_num]);
+		g_pin_owner[pin_num] = seq;
+	}
+
+	if (__led_sequence_advance(seq) < 0) {
+		/* Everything was written at once, nothing left to wait for */
+		__led_sequence_release(seq);
+		if (cb)
+			cb(seq, data);
+		return NULL;
+	}
+
+	return seq;
+}
+
+void led_sequence_stop(led_sequence *seq)
+{
+	ret_if(!seq);
+
+	__led_sequence_release(seq);
+}
+
+void led_sequence_stop_all(void)
+{
+	int i = 0;
+
+	for (i = 0; i < PIN_MAX; i++) {
+		if (g_pin_owner[i])
+			led_sequence_stop(g_pin_owner[i]);
+	}
+}
@@ -19,14 +19,23 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <limits.h>
 #include <Ecore.h>
 
 #include "st_things.h"
 #include "log.h"
 #include "sensor-data.h"
 #include "resource.h"
+#include "led-sequence.h"
+#include "notify-coalescer.h"
+#include "adaptive-sampler.h"
+#include "tracing.h"
+#include "device-config.h"
+#include "lux-controller.h"
 
 #define JSON_PATH "device_def.json"
+/* The device definition compiled for a fast start, in the app data directory */
+#define CONFIG_FILE "device_config.bin"
 
 #define SENSOR_URI_ILLUMINANCE "/capability/illuminanceMeasurement/main/0"
 #define SENSOR_KEY_ILLUMINANCE "illuminance"
@@ -36,95 +45,338 @@
 #define SENSOR_KEY_DOOR "doorState"
 #define SENSOR_POWER_INITIALIZING BLIND_DOWN
 
+/* Observers hear about illuminance once it moves past the larger of both bands */
+#ifndef ILLUMINANCE_DEADBAND_LUX
+#define ILLUMINANCE_DEADBAND_LUX (5.0)
+#endif
+#ifndef ILLUMINANCE_DEADBAND_RATIO
+#define ILLUMINANCE_DEADBAND_RATIO (0.05)
+#endif
+
+/* Shortest time between two notifications of a URI, later changes ride on the next one */
+#ifndef ILLUMINANCE_NOTIFY_INTERVAL
+#define ILLUMINANCE_NOTIFY_INTERVAL (1.0)
+#endif
+#ifndef DOOR_NOTIFY_INTERVAL
+#define DOOR_NOTIFY_INTERVAL (0.1)
+#endif
+
 #define I2C_BUS_NUMBER (1)
+#ifndef SENSOR_GATHER_INTERVAL
 #define SENSOR_GATHER_INTERVAL (1.0f)
+#endif
+/* Zero leaves the illuminance sensor alone */
+#ifndef ILLUMINANCE_GATHER_INTERVAL
+#define ILLUMINANCE_GATHER_INTERVAL SENSOR_GATHER_INTERVAL
+#endif
+
+/* Sampling speeds up to the _MIN interval on activity and backs off to the slowest one when idle */
+#ifndef SW_GATHER_INTERVAL_MIN
+#define SW_GATHER_INTERVAL_MIN (0.02)
+#endif
+#ifndef ILLUMINANCE_GATHER_INTERVAL_MIN
+#define ILLUMINANCE_GATHER_INTERVAL_MIN (0.25)
+#endif
+#ifndef GATHER_BACKOFF
+#define GATHER_BACKOFF (2.0)
+#endif
+#define GATHER_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* The I/O metrics are written to the app data directory this often, zero turns the file off */
+#ifndef METRICS_DUMP_INTERVAL
+#define METRICS_DUMP_INTERVAL (60.0)
+#endif
+#define METRICS_FILE "metrics.json"
 #define PAGE_SCR (0)
 
+#define SW_PIN_NUMBER (20)
+#define SW_HISTORY_SIZE (32)
+#define LED_PIN_NUMBER_1 (5)
+#define LED_PIN_NUMBER_2 (26)
+
+/* The dimmable LED holds the room at LAMP_TARGET_LUX, zero leaves it off */
+#ifndef LAMP_TARGET_LUX
+#define LAMP_TARGET_LUX (0)
+#endif
+#define LAMP_PWM_CHIP (0)
+#define LAMP_PWM_CHANNEL (0)
+#define LAMP_PWM_PERIOD_NS (1000000) /* 1 kHz, well above visible flicker */
+/*
+ * Tuned for a lamp adding about 400 lux at full duty, see lux_controller_config_s for the units.
+ * The integral part alone would take the whole error away in one second, at the slowest pace.
+ */
+#ifndef LAMP_KP_Q8
+#define LAMP_KP_Q8 (256)
+#endif
+#ifndef LAMP_KI_Q8
+#define LAMP_KI_Q8 (2560)
+#endif
+/* Corrections under 1% of the brightness are not worth a write */
+#define LAMP_DUTY_THRESHOLD (LUX_CONTROLLER_DUTY_MAX / 100)
+
+/* SW_MODE_INTERRUPT falls back to SW_MODE_POLLING if edges cannot be registered */
+#define SW_MODE_POLLING (0)
+#define SW_MODE_INTERRUPT (1)
+#ifndef SW_ACQUISITION_MODE
+#define SW_ACQUISITION_MODE SW_MODE_INTERRUPT
+#endif
+
+/* The LEDs of the step templates, __led_steps_build() puts the configured pins in their place */
+#define LED_STEP_LED_1 (0)
+#define LED_STEP_LED_2 (1)
+
+static const led_step_s g_sw_pressed_steps[] = {
+	{ LED_STEP_LED_1, 1, 0 },
+	{ LED_STEP_LED_2, 1, 0 },
+};
+
+static const led_step_s g_sw_released_steps[] = {
+	{ LED_STEP_LED_1, 0, 200 },
+	{ LED_STEP_LED_1, 1, 200 },
+	{ LED_STEP_LED_2, 0, 200 },
+	{ LED_STEP_LED_2, 1, 200 },
+};
+
+static const led_step_s g_startup_steps[] = {
+	{ LED_STEP_LED_1, 1, 200 },
+	{ LED_STEP_LED_1, 0, 0 },
+};
+
+#define LED_STEP_COUNT(steps) (sizeof(steps) / sizeof(steps[0]))
+
 typedef struct app_data_s {
-	Ecore_Timer *getter_sw;
+	adaptive_sampler *getter_sw;
+	adaptive_sampler *getter_illuminance;
 	sensor_data *sw_data;
-
+	sensor_data *illuminance_data;
+	sensor_data *range_data;
+	lux_controller *lamp; /* NULL while the lamp is off */
+	int sw_mode;
+	int gathering; /* Between gathering_start() and gathering_stop() */
+	int sw_pin;
+	int led_pin_1;
+	int led_pin_2;
+	int i2c_bus;
+	unsigned int sw_level; /* Last raw level read */
+	int things_started;
+	int illuminance_notified; /* The observers know notified_lux and notified_range */
+	double notified_lux;
+	unsigned int notified_range;
+	/* The templates with the configured pins, played from here */
+	led_step_s sw_pressed_steps[LED_STEP_COUNT(g_sw_pressed_steps)];
+	led_step_s sw_released_steps[LED_STEP_COUNT(g_sw_released_steps)];
+	led_step_s startup_steps[LED_STEP_COUNT(g_startup_steps)];
 } app_data;
 
 static app_data *g_ad = NULL;
 
-static inline int __get_sw(void *data, unsigned int *sw_value)
+/* The compiled in values, for whatever the device definition leaves out */
+static const device_config_s g_config_defaults = {
+	{ SW_PIN_NUMBER, LED_PIN_NUMBER_1, LED_PIN_NUMBER_2 },
+	I2C_BUS_NUMBER,
+	{
+		SENSOR_GATHER_INTERVAL, ILLUMINANCE_GATHER_INTERVAL,
+		SW_GATHER_INTERVAL_MIN, ILLUMINANCE_GATHER_INTERVAL_MIN,
+		ILLUMINANCE_NOTIFY_INTERVAL, DOOR_NOTIFY_INTERVAL,
+	},
+	GATHER_BACKOFF,
+	{ SENSOR_URI_ILLUMINANCE, SENSOR_URI_DOOR },
+	{ LAMP_PWM_CHIP, LAMP_PWM_CHANNEL, LAMP_PWM_PERIOD_NS, LAMP_TARGET_LUX },
+};
+
+static int __notify_observers(const char *uri, void *data)
 {
-	int ret = 0;
 	app_data *ad = data;
-	unsigned int delay_usec = 200000; // 20mS delay
+	int ret = ST_THINGS_ERROR_NONE;
+
+	if (!ad->things_started)
+		return NOTIFY_COALESCER_SKIPPED;
+
+	ret = st_things_notify_observers(uri);
+	retvm_if(ret != ST_THINGS_ERROR_NONE, -1, "Failed to notify %s : %d", uri, ret);
+
+	return 0;
+}
+
+static int __set_sw(app_data *ad, unsigned int sw_value)
+{
+	unsigned int version = 0;
+
 	retv_if(!ad, -1);
 	retv_if(!ad->sw_data, -1);
 
-/*
-#if 1
-	ret = resource_read_illuminance_sensor(I2C_BUS_NUMBER, sw_value);
-	retv_if(ret != 0, -1);
-#endif
+	version = sensor_data_get_version(ad->sw_data);
+	sensor_data_set_uint(ad->sw_data, sw_value);
+	_D2("Detected sw value is: %u", sw_value);
 
-	sensor_data_set_uint(ad->sw_data, *sw_value);
-	_D2("sw value : %u", *sw_value);
-*/
-#if 1
-	ret = resource_read_sw_sensor(20, &sw_value);
-	retv_if(ret != 0, -1);
-#endif
+	/* The debouncer already keeps bounces out, every change left is a real one */
+	if (sensor_data_get_version(ad->sw_data) != version)
+		notify_coalescer_mark(device_config_get_uri(DEVICE_CONFIG_URI_DOOR));
 
-//	if (ret != 0) _E("Cannot read sensor value");
+	// change to LED light
+	if (sw_value)
+		led_sequence_play(ad->sw_pressed_steps, LED_STEP_COUNT(ad->sw_pressed_steps), 1, NULL, NULL);
+	else
+		led_sequence_play(ad->sw_released_steps, LED_STEP_COUNT(ad->sw_released_steps), 1, NULL, NULL);
 
-	_D2("Detected sw value is: %d", sw_value);
+	return 0;
+}
 
-	// Send value to LED light
-	// resource_write_led(26, value);
-	sw_value = 1;
-	if (sw_value)
-	{
-	// change to LED light
+static inline int __get_sw(void *data, unsigned int *sw_value)
+{
+	int ret = 0;
+	uint64_t levels = 0;
+	app_data *ad = data;
 
-	resource_write_led(5, 1);
-	resource_write_led(26, 1);
-	sw_value = 0;
+	retv_if(!ad, -1);
+	retv_if(!sw_value, -1);
 
-	}
-	else
-	{
-	// change to LED light
-	resource_write_led(5, 0);
-	usleep(delay_usec);
-	resource_write_led(5, 1);
-	usleep(delay_usec);
+	ret = resource_read_sw_sensors(1ULL << ad->sw_pin, &levels);
+	retv_if(ret != 0, -1);
+
+	*sw_value = !!(levels & (1ULL << ad->sw_pin));
+	ad->sw_level = *sw_value;
 
-	resource_write_led(26, 0);
-	usleep(delay_usec);
-	resource_write_led(26, 1);
-	usleep(delay_usec);
+	/* Raw levels go through the debouncer, __set_sw() runs on clean events only */
+	return resource_sw_gesture_feed(ad->sw_pin, *sw_value);
+}
 
+static void __sw_event_cb(const resource_sw_event_s *event, void *data)
+{
+	app_data *ad = data;
+
+	ret_if(!ad);
+	ret_if(!event);
+
+	switch (event->type) {
+	case RESOURCE_SW_EVENT_PRESS:
+		__set_sw(ad, 1);
+		break;
+	case RESOURCE_SW_EVENT_RELEASE:
+		__set_sw(ad, 0);
+		break;
+	case RESOURCE_SW_EVENT_LONG_PRESS:
+		_D2("sw long press at %.3f", event->timestamp);
+		break;
+	case RESOURCE_SW_EVENT_DOUBLE_CLICK:
+		_D2("sw double click at %.3f", event->timestamp);
+		break;
+	default:
+		break;
 	}
-	return 0;
 }
 
-static Eina_Bool __sw_to_value(void *data)
+static int __sw_to_value(void *data)
 {
 	int ret = 0;
 	unsigned int sw_value = 0;
-	uint32_t value = 1;
+	unsigned int last_level = 0;
 	app_data *ad = data;
-	resource_write_led(26, value); //debug led on
+
 	if (!ad) {
 		_E("failed to get app_data");
 		service_app_exit();
+		return -1;
 	}
-# if 1
+
 	if (!ad->sw_data) {
 		_E("failed to get sw_data");
 		service_app_exit();
+		return -1;
 	}
+
+	TRACE_BEGIN("sw_to_value");
+
+	last_level = ad->sw_level;
 	ret = __get_sw(ad, &sw_value);
-	retv_if(ret != 0, ECORE_CALLBACK_RENEW);
+	TRACE_END();
+	retv_if(ret != 0, -1);
+
+	/* Stays fast while the switch moves or is held, so the release is caught quickly too */
+	return sw_value != last_level || sw_value;
+}
+
+/* Returns 1 if the duty cycle moved */
+static int __lamp_update(app_data *ad, const resource_illuminance_sample_s *sample)
+{
+	/* Through 64 bits, the conversion to 32 wraps instead of overflowing */
+	unsigned int time_ms = (unsigned int) (unsigned long long) (sample->timestamp * 1000.0);
+	unsigned int duty = 0;
+
+	if (lux_controller_update(ad->lamp, sample->lux_q4, time_ms, &duty) != 1)
+		return 0;
+
+	_D2("Lamp duty %u/%u at %u lux", duty, LUX_CONTROLLER_DUTY_MAX, sample->lux_q4 >> 4);
+	resource_write_pwm_led(duty);
+
+	return 1;
+}
+
+/* Sampling faster than the sensor converts in its current range only reads the same result again */
+static void __illuminance_min_update(app_data *ad)
+{
+	double min_interval = GATHER_MIN(device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE_MIN),
+			device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE));
+	double conversion_time = resource_get_illuminance_sensor_conversion_time();
+
+	adaptive_sampler_set_min_interval(ad->getter_illuminance,
+			conversion_time > min_interval ? conversion_time : min_interval);
+}
+
+static void __illuminance_cb(const resource_illuminance_sample_s *sample, void *data)
+{
+	app_data *ad = data;
+	double band = 0.0;
+
+	ret_if(!ad);
+	ret_if(!sample);
+
+	sensor_data_set_double(ad->illuminance_data, sample->lux);
+	sensor_data_set_uint(ad->range_data, sample->range);
+	__illuminance_min_update(ad);
+
+	/* The loop settles at the fast pace, the sampler only backs off once the lamp holds still */
+	if (ad->lamp && __lamp_update(ad, sample))
+		adaptive_sampler_poke(ad->getter_illuminance);
+
+	band = ad->notified_lux * ILLUMINANCE_DEADBAND_RATIO;
+	if (band < ILLUMINANCE_DEADBAND_LUX)
+		band = ILLUMINANCE_DEADBAND_LUX;
+
+	if (ad->illuminance_notified && sample->range == ad->notified_range
+			&& sample->lux > ad->notified_lux - band && sample->lux < ad->notified_lux + band)
+		return;
+
+	ad->illuminance_notified = 1;
+	ad->notified_lux = sample->lux;
+	ad->notified_range = sample->range;
+	notify_coalescer_mark(device_config_get_uri(DEVICE_CONFIG_URI_ILLUMINANCE));
+
+	/* The result comes after its sample was counted as quiet, so the speed up is reported here */
+	adaptive_sampler_poke(ad->getter_illuminance);
+}
+
+static int __illuminance_to_value(void *data)
+{
+	app_data *ad = data;
+
+	retv_if(!ad, -1);
+
+	/* Busy while the previous read is still converting, it simply gets the next tick */
+	TRACE_BEGIN("illuminance_to_value");
+	resource_read_illuminance_sensor_async(ad->i2c_bus, RESOURCE_ILLUMINANCE_MODE_CONTINUOUS, __illuminance_cb, ad);
+	TRACE_END();
+
+	return 0;
+}
+
+static void __sw_changed_cb(double value, void *data)
+{
+	app_data *ad = data;
+
+	ret_if(!ad);
 
-#endif 
-	
-	return ECORE_CALLBACK_RENEW;
+	resource_sw_gesture_feed(ad->sw_pin, (uint32_t) value);
 }
 
 void gathering_stop(void *data)
@@ -133,59 +385,386 @@ void gathering_stop(void *data)
 
 	ret_if(!ad);
 
-	if (ad->getter_sw)
-		ecore_timer_del(ad->getter_sw);
+	if (ad->getter_sw) {
+		adaptive_sampler_stop(ad->getter_sw);
+		ad->getter_sw = NULL;
+	}
+
+	if (ad->getter_illuminance) {
+		adaptive_sampler_stop(ad->getter_illuminance);
+		ad->getter_illuminance = NULL;
+	}
+	resource_cancel_illuminance_sensor_async();
+
+	if (ad->sw_mode == SW_MODE_INTERRUPT) {
+		resource_unset_sw_sensor_interrupted_cb(ad->sw_pin);
+		ad->sw_mode = SW_MODE_POLLING;
+	}
+
+	resource_sw_gesture_stop(ad->sw_pin);
+	ad->gathering = 0;
 }
 
 void gathering_start(void *data)
 {
 	app_data *ad = data;
+	double sensor_interval = device_config_get_interval(DEVICE_CONFIG_INTERVAL_SENSOR);
+	double illuminance_interval = device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE);
+	const adaptive_sampler_config_s sw_config = {
+		GATHER_MIN(device_config_get_interval(DEVICE_CONFIG_INTERVAL_SW_MIN), sensor_interval),
+		sensor_interval, device_config_get_backoff()
+	};
+	const adaptive_sampler_config_s illuminance_config = {
+		GATHER_MIN(device_config_get_interval(DEVICE_CONFIG_INTERVAL_ILLUMINANCE_MIN), illuminance_interval),
+		illuminance_interval, device_config_get_backoff()
+	};
 
 	ret_if(!ad);
 
 	gathering_stop(ad);
+	ad->gathering = 1;
+
+	if (resource_sw_gesture_start(ad->sw_pin, NULL, __sw_event_cb, ad))
+		_E("Failed to start sw gesture");
 
-	ad->getter_sw = ecore_timer_add(SENSOR_GATHER_INTERVAL, __sw_to_value, ad);
+	if (illuminance_interval > 0) {
+		ad->getter_illuminance = adaptive_sampler_start(&illuminance_config, __illuminance_to_value, ad);
+		if (!ad->getter_illuminance)
+			_E("Failed to add getter_illuminance");
+		else
+			__illuminance_min_update(ad);
+	}
+
+	if (SW_ACQUISITION_MODE == SW_MODE_INTERRUPT) {
+		if (!resource_set_sw_sensor_interrupted_cb(ad->sw_pin, __sw_changed_cb, ad)) {
+			ad->sw_mode = SW_MODE_INTERRUPT;
+			/* Pick up the level the switch had before the first edge, read like the edges are */
+			if (resource_refresh_sw_sensor(ad->sw_pin))
+				_E("Failed to read the initial sw level");
+			return;
+		}
+		_W("Failed to set sw interrupt, falling back to polling");
+	}
+
+	ad->sw_mode = SW_MODE_POLLING;
+	ad->getter_sw = adaptive_sampler_start(&sw_config, __sw_to_value, ad);
 	if (!ad->getter_sw)
 		_E("Failed to add getter_sw");
 }
 
 
+/* Called on the things thread, answered from the cached values only, never from the hardware */
+static bool __handle_get_request(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep)
+{
+	app_data *ad = g_ad;
+
+	retv_if(!ad, false);
+	retv_if(!req_msg || !resp_rep, false);
+
+	if (!strcmp(req_msg->resource_uri, device_config_get_uri(DEVICE_CONFIG_URI_ILLUMINANCE))) {
+		double lux = 0.0;
+		unsigned int range = 0;
+
+		if (req_msg->has_property_key(req_msg, SENSOR_KEY_ILLUMINANCE)) {
+			retv_if(sensor_data_get_double(ad->illuminance_data, &lux), false);
+			resp_rep->set_double_value(resp_rep, SENSOR_KEY_ILLUMINANCE, lux);
+		}
+		if (req_msg->has_property_key(req_msg, SENSOR_KEY_RANGE)) {
+			retv_if(sensor_data_get_uint(ad->range_data, &range), false);
+			resp_rep->set_int_value(resp_rep, SENSOR_KEY_RANGE, range);
+		}
+		return true;
+	}
+
+	if (!strcmp(req_msg->resource_uri, device_config_get_uri(DEVICE_CONFIG_URI_DOOR))) {
+		unsigned int sw_value = 0;
+
+		if (req_msg->has_property_key(req_msg, SENSOR_KEY_DOOR)) {
+			retv_if(sensor_data_get_uint(ad->sw_data, &sw_value), false);
+			/* The switch is held down by a closed door */
+			resp_rep->set_str_value(resp_rep, SENSOR_KEY_DOOR, sw_value ? "closed" : "open");
+		}
+		return true;
+	}
+
+	_E("Unsupported GET request : %s", req_msg->resource_uri);
+	return false;
+}
+
+static bool __handle_set_request(st_things_set_request_message_s *req_msg, st_things_representation_s *resp_rep)
+{
+	retv_if(!req_msg, false);
+
+	/* Both capabilities are sensors, nothing is writable */
+	_E("Unsupported SET request : %s", req_msg->resource_uri);
+	return false;
+}
+
+static int __things_start(app_data *ad)
+{
+	bool easysetup_complete = false;
+	int ret = ST_THINGS_ERROR_NONE;
+
+	ret = st_things_initialize(JSON_PATH, &easysetup_complete);
+	retvm_if(ret != ST_THINGS_ERROR_NONE, -1, "st_things_initialize failed : %d", ret);
+
+	ret = st_things_register_request_cb(__handle_get_request, __handle_set_request);
+	if (ret != ST_THINGS_ERROR_NONE) {
+		_E("st_things_register_request_cb failed : %d", ret);
+		st_things_deinitialize();
+		return -1;
+	}
+
+	ret = st_things_start();
+	if (ret != ST_THINGS_ERROR_NONE) {
+		_E("st_things_start failed : %d", ret);
+		st_things_deinitialize();
+		return -1;
+	}
+
+	_I("Things started, easy setup %s", easysetup_complete ? "complete" : "pending");
+	ad->things_started = 1;
+
+	return 0;
+}
+
+static void __things_stop(app_data *ad)
+{
+	ret_if(!ad->things_started);
+
+	st_things_stop();
+	st_things_deinitialize();
+	ad->things_started = 0;
+}
+
+/* Left out of the dump while the sampler is not running */
+static double __sw_interval_gauge(void *data)
+{
+	app_data *ad = data;
+
+	return ad->getter_sw ? adaptive_sampler_get_interval(ad->getter_sw) : -1.0;
+}
+
+static double __illuminance_interval_gauge(void *data)
+{
+	app_data *ad = data;
+
+	return ad->getter_illuminance ? adaptive_sampler_get_interval(ad->getter_illuminance) : -1.0;
+}
+
+static int __metrics_dump_start(app_data *ad)
+{
+	char *data_path = NULL;
+	char path[PATH_MAX];
+	int ret = 0;
+
+	data_path = app_get_data_path();
+	retv_if(!data_path, -1);
+
+	snprintf(path, sizeof(path), "%s%s", data_path, METRICS_FILE);
+	free(data_path);
+
+	ret = resource_metrics_dump_start(path, METRICS_DUMP_INTERVAL);
+	retv_if(ret != 0, -1);
+
+	/* How far the samplers backed off, next to the reads they made */
+	if (resource_metrics_add_gauge("sw_sample_interval", __sw_interval_gauge, ad)
+			|| resource_metrics_add_gauge("illuminance_sample_interval", __illuminance_interval_gauge, ad))
+		_W("Failed to add the sampler intervals to the metrics");
+
+	return 0;
+}
+
+static void __config_load(app_data *ad)
+{
+	char *res_path = NULL;
+	char *data_path = NULL;
+	char source[PATH_MAX];
+	char cache[PATH_MAX];
+
+	res_path = app_get_resource_path();
+	if (res_path)
+		snprintf(source, sizeof(source), "%s%s", res_path, JSON_PATH);
+
+	data_path = app_get_data_path();
+	if (data_path)
+		snprintf(cache, sizeof(cache), "%s%s", data_path, CONFIG_FILE);
+
+	/* Only fails without defaults, every value has one */
+	device_config_load(res_path ? source : NULL, data_path ? cache : NULL, &g_config_defaults);
+	free(res_path);
+	free(data_path);
+
+	ad->sw_pin = device_config_get_pin(DEVICE_CONFIG_PIN_SW);
+	ad->led_pin_1 = device_config_get_pin(DEVICE_CONFIG_PIN_LED_1);
+	ad->led_pin_2 = device_config_get_pin(DEVICE_CONFIG_PIN_LED_2);
+	ad->i2c_bus = device_config_get_i2c_bus();
+}
+
+/* Called after the configuration is loaded */
+static void __led_steps_build(app_data *ad, const led_step_s *templates, led_step_s *steps, unsigned int count)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < count; i++) {
+		steps[i] = templates[i];
+		steps[i].pin_num = (templates[i].pin_num == LED_STEP_LED_2) ? ad->led_pin_2 : ad->led_pin_1;
+	}
+}
+
+static int __prewarm(app_data *ad)
+{
+	/* Everything the app drives, opened up front so the first event does not pay for the opens */
+	resource_prewarm_s items[] = {
+		{ &resource_sw_sensor_driver, ad->sw_pin, 0, 0, 0 },
+		{ &resource_led_driver, ad->led_pin_1, 0, 0, 0 },
+		{ &resource_led_driver, ad->led_pin_2, 0, 0, 0 },
+		{ &resource_illuminance_driver, RESOURCE_ID_ILLUMINANCE, ad->i2c_bus, 0, 0 },
+	};
+
+	return resource_prewarm(items, sizeof(items) / sizeof(items[0]));
+}
+
+static int __lamp_start(app_data *ad)
+{
+	int target_lux = device_config_get_lamp(DEVICE_CONFIG_LAMP_TARGET_LUX);
+	lux_controller_config_s config = {
+		(unsigned int) target_lux << 4, LAMP_KP_Q8, LAMP_KI_Q8, LAMP_DUTY_THRESHOLD
+	};
+	int ret = 0;
+
+	if (target_lux <= 0)
+		return 0;
+
+	ret = resource_open_pwm_led(device_config_get_lamp(DEVICE_CONFIG_LAMP_CHIP),
+			device_config_get_lamp(DEVICE_CONFIG_LAMP_CHANNEL),
+			device_config_get_lamp(DEVICE_CONFIG_LAMP_PERIOD_NS));
+	retv_if(ret != 0, -1);
+
+	ad->lamp = lux_controller_new(&config);
+	retv_if(!ad->lamp, -1);
+
+	_I("Lamp holds %d lux", target_lux);
+
+	return 0;
+}
+
 static bool service_app_create(void *user_data)
 {
 	app_data *ad = (app_data *)user_data;
 
+	/* Logs are only formatted on the drainer thread from here on */
+	if (log_start())
+		_W("Failed to start the log drainer");
+
+	if (tracing_init())
+		_W("Failed to start tracing");
+
+	__config_load(ad);
+	__led_steps_build(ad, g_sw_pressed_steps, ad->sw_pressed_steps, LED_STEP_COUNT(g_sw_pressed_steps));
+	__led_steps_build(ad, g_sw_released_steps, ad->sw_released_steps, LED_STEP_COUNT(g_sw_released_steps));
+	__led_steps_build(ad, g_startup_steps, ad->startup_steps, LED_STEP_COUNT(g_startup_steps));
+
 	ad->sw_data = sensor_data_new(SENSOR_DATA_TYPE_UINT);
 	if (!ad->sw_data)
 		return false;
-	
-	resource_write_led(5, 1);
-	usleep(delay_usec);
-	resource_write_led(5, 0);
+
+	ad->illuminance_data = sensor_data_new(SENSOR_DATA_TYPE_DOUBLE);
+	if (!ad->illuminance_data)
+		return false;
+
+	ad->range_data = sensor_data_new(SENSOR_DATA_TYPE_UINT);
+	if (!ad->range_data)
+		return false;
+
+	if (resource_set_illuminance_sensor_range(RESOURCE_ILLUMINANCE_RANGE_AUTO))
+		_W("Failed to set illuminance auto ranging");
+
+	if (sensor_data_history_enable(ad->sw_data, SW_HISTORY_SIZE))
+		_W("Failed to enable sw history");
+
+	/* The drivers open lazily too, a resource failing here gets another try on first use */
+	if (__prewarm(ad))
+		_W("Some resources failed to open");
+
+	/* Without the worker the drivers make their peripheral calls right in the loop */
+	if (resource_io_worker_start())
+		_W("Failed to start the I/O worker");
+
+	/* Driven from the illuminance readings, so it only runs while the sensor is sampled */
+	if (__lamp_start(ad))
+		_W("Failed to start the lamp");
+
+	if (METRICS_DUMP_INTERVAL > 0 && __metrics_dump_start(ad))
+		_W("Failed to start the metrics dump");
+
+	led_sequence_play(ad->startup_steps, LED_STEP_COUNT(ad->startup_steps), 1, NULL, NULL);
+
+	if (notify_coalescer_init(__notify_observers, ad)
+			|| notify_coalescer_add_uri(device_config_get_uri(DEVICE_CONFIG_URI_ILLUMINANCE),
+					device_config_get_interval(DEVICE_CONFIG_INTERVAL_NOTIFY_ILLUMINANCE))
+			|| notify_coalescer_add_uri(device_config_get_uri(DEVICE_CONFIG_URI_DOOR),
+					device_config_get_interval(DEVICE_CONFIG_INTERVAL_NOTIFY_DOOR)))
+		_W("Failed to set up notifications");
+
+	/* The sensors run locally even if the cloud side cannot start */
+	if (__things_start(ad))
+		_W("Running without things");
 
 	return true;
 }
 
 static void service_app_control(app_control_h app_control, void *user_data)
 {
+	app_data *ad = user_data;
+	char *trace = NULL;
 
-	gathering_start(user_data);
+	/* app_launcher -s org.example.ledsw trace on|off, the sensors keep running as they are */
+	if (app_control && app_control_get_extra_data(app_control, "trace", &trace) == APP_CONTROL_ERROR_NONE) {
+		if (tracing_set_enabled(!strcmp(trace, "on")))
+			_W("Failed to switch tracing %s", trace);
+		free(trace);
 
+		if (ad->gathering)
+			return;
+	}
+
+	gathering_start(ad);
 }
 
 static void service_app_terminate(void *user_data)
 {
 	app_data *ad = (app_data *)user_data;
 
-	resource_write_led(5, 0);
+	/* No more requests read the sensor data freed below */
+	__things_stop(ad);
+	notify_coalescer_fini();
+
+	gathering_stop(ad);
+	led_sequence_stop_all();
+
+	resource_write_led(ad->led_pin_1, 0);
 
+	/* Runs the queued writes, the handles they use are closed next */
+	resource_io_worker_stop();
+	resource_metrics_dump_stop();
+	resource_metrics_remove_gauge("sw_sample_interval");
+	resource_metrics_remove_gauge("illuminance_sample_interval");
 	resource_close_all();
 
-	gathering_stop(ad);
+	/* Nothing reads the configured URIs any more */
+	device_config_unload();
 
+	/* Its PWM was switched off and closed with the other resources */
+	lux_controller_free(ad->lamp);
 
+	sensor_data_free(ad->range_data);
+	sensor_data_free(ad->illuminance_data);
 	sensor_data_free(ad->sw_data);
 	free(ad);
+
+	tracing_fini();
+	log_stop();
 }
 
 int main(int argc, char *argv[])
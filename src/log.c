@@ -0,0 +1,542 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <dlog.h>
+
+#include "log.h"
+
+/*
+ * Binary logger.
+ * A record keeps the format id and the raw arguments, string arguments copied in.
+ * Each thread writes its records into a ring of its own, the drainer thread formats
+ * them later and hands them to dlog. Without the drainer, records are printed right away.
+ * The drainer sleeps until a writer posts, one post covers everything written until it ran.
+ * A ring outlives its thread until the drainer emptied it.
+ */
+
+#define LOG_RING_SIZE 256 /* Power of two, records per thread */
+#define LOG_RECORD_ARGS 8
+#define LOG_RECORD_STRINGS 128
+#define LOG_FORMAT_MAX 512 /* Power of two */
+#define LOG_LINE_MAX 512
+
+typedef enum {
+	LOG_ARG_INT = 0,
+	LOG_ARG_LONG,
+	LOG_ARG_LLONG,
+	LOG_ARG_SIZE,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_PTR,
+	LOG_ARG_STR,
+} log_arg_type_e;
+
+typedef struct {
+	const char *fmt; /* The key, claimed once */
+	int ready;
+	int direct; /* Arguments the records cannot hold, printed right away */
+	unsigned char nargs;
+	unsigned char types[LOG_RECORD_ARGS];
+} log_format_s;
+
+typedef struct {
+	const char *tag;
+	const char *func;
+	int line;
+	unsigned short fmt_id;
+	unsigned char prio;
+	uint64_t args[LOG_RECORD_ARGS];
+	char strings[LOG_RECORD_STRINGS];
+} log_record_s;
+
+typedef struct _log_ring_s {
+	unsigned int head; /* Written by the owning thread */
+	unsigned int tail; /* Written by the drainer */
+	unsigned int dropped;
+	int writing; /* The owning thread is inside log_write() */
+	int exited; /* The owning thread is gone, the ring goes once it is empty */
+	struct _log_ring_s *next;
+	log_record_s records[LOG_RING_SIZE];
+} log_ring_s;
+
+int log_runtime_level = LOG_LEVEL_DEBUG;
+
+static log_format_s g_formats[LOG_FORMAT_MAX];
+static log_ring_s *g_rings = NULL;
+static __thread log_ring_s *g_ring = NULL;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static int g_draining = 0;
+static int g_stopping = 0;
+static int g_wake_posted = 0;
+static sem_t g_wakeup;
+static pthread_t g_drainer;
+
+/* Reads the conversions of a format, returns -1 for anything a record cannot hold */
+static int __parse_format(const char *fmt, log_format_s *format)
+{
+	const char *p = fmt;
+
+	format->nargs = 0;
+
+	while ((p = strchr(p, '%'))) {
+		int longs = 0;
+		int size = 0;
+		log_arg_type_e type = LOG_ARG_INT;
+
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+
+		p += strspn(p, "-+ #0");
+		p += strspn(p, "0123456789");
+		if (*p == '.') {
+			p++;
+			p += strspn(p, "0123456789");
+		}
+		if (*p == '*')
+			return -1;
+
+		for (; *p && strchr("hlzjtL", *p); p++) {
+			if (*p == 'l')
+				longs++;
+			else if (*p == 'z' || *p == 'j' || *p == 't')
+				size = 1;
+			else if (*p == 'L')
+				return -1;
+		}
+
+		switch (*p) {
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+			type = size ? LOG_ARG_SIZE : longs >= 2 ? LOG_ARG_LLONG : longs ? LOG_ARG_LONG : LOG_ARG_INT;
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			type = LOG_ARG_DOUBLE;
+			break;
+		case 'p':
+			type = LOG_ARG_PTR;
+			break;
+		case 's':
+			type = LOG_ARG_STR;
+			break;
+		default:
+			return -1;
+		}
+
+		if (format->nargs == LOG_RECORD_ARGS)
+			return -1;
+		format->types[format->nargs++] = type;
+		p++;
+	}
+
+	return 0;
+}
+
+/* Gives every format string its id once, lock free since any thread may log */
+static log_format_s *__get_format(const char *fmt, unsigned short *id)
+{
+	unsigned int hash = (unsigned int) (((uintptr_t) fmt >> 3) * 2654435761u);
+	unsigned int i = 0;
+
+	for (i = 0; i < LOG_FORMAT_MAX; i++) {
+		unsigned int slot = (hash + i) & (LOG_FORMAT_MAX - 1);
+		log_format_s *format = &g_formats[slot];
+		const char *key = __atomic_load_n(&format->fmt, __ATOMIC_ACQUIRE);
+
+		if (!key) {
+			const char *expected = NULL;
+			if (!__atomic_compare_exchange_n(&format->fmt, &expected, fmt, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				key = expected;
+			} else {
+				format->direct = __parse_format(fmt, format) != 0;
+				__atomic_store_n(&format->ready, 1, __ATOMIC_RELEASE);
+				key = fmt;
+			}
+		}
+
+		if (key != fmt)
+			continue;
+
+		/* Another thread may still be parsing it */
+		while (!__atomic_load_n(&format->ready, __ATOMIC_ACQUIRE))
+			sched_yield();
+
+		*id = (unsigned short) slot;
+		return format;
+	}
+
+	return NULL;
+}
+
+/* Runs as the thread exits, its records may not be drained yet */
+static void __ring_exit(void *data)
+{
+	log_ring_s *ring = data;
+
+	/* A destructor logging after this one gets a ring of its own */
+	g_ring = NULL;
+	__atomic_store_n(&ring->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void __ring_key_create(void)
+{
+	if (pthread_key_create(&g_ring_key, __ring_exit) != 0)
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] Failed to create the log ring key\n", __func__, __LINE__);
+}
+
+static log_ring_s *__get_ring(void)
+{
+	log_ring_s *ring = g_ring;
+
+	if (ring)
+		return ring;
+
+	ring = calloc(1, sizeof(log_ring_s));
+	if (!ring)
+		return NULL;
+
+	/* Without the key the ring would never be freed, the thread prints directly instead */
+	if (pthread_setspecific(g_ring_key, ring) != 0) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->next = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE);
+	while (!__atomic_compare_exchange_n(&g_rings, &ring->next, ring, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		;
+
+	g_ring = ring;
+	return ring;
+}
+
+/* Writers only ever push at the head, the drainer is the only one unlinking */
+static void __ring_unlink(log_ring_s *ring)
+{
+	log_ring_s *head = ring;
+	log_ring_s **link = NULL;
+
+	if (__atomic_compare_exchange_n(&g_rings, &head, ring->next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return;
+
+	for (link = &head->next; *link != ring; link = &(*link)->next)
+		;
+	*link = ring->next;
+}
+
+/* While log_stop() runs, the records this thread left in its ring go out before the direct ones */
+static void __ring_wait_drained(void)
+{
+	log_ring_s *ring = g_ring;
+
+	while (ring && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head)
+		sched_yield();
+}
+
+static void __print(log_priority prio, const char *tag, const char *func, int line, const char *message)
+{
+	dlog_print(prio, tag, "[%s:%d] %s\n", func, line, message);
+}
+
+static void __print_direct(log_priority prio, const char *tag, const char *func, int line, const char *fmt, va_list ap)
+{
+	char message[LOG_LINE_MAX];
+
+	vsnprintf(message, sizeof(message), fmt, ap);
+	__print(prio, tag, func, line, message);
+}
+
+void log_write(log_priority prio, const char *tag, const char *func, int line, const char *fmt, ...)
+{
+	log_format_s *format = NULL;
+	log_ring_s *ring = NULL;
+	log_record_s *record = NULL;
+	unsigned short id = 0;
+	unsigned int head = 0;
+	unsigned int used = 0;
+	unsigned int i = 0;
+	va_list ap;
+
+	va_start(ap, fmt);
+
+	if (!__atomic_load_n(&g_draining, __ATOMIC_ACQUIRE)) {
+		__ring_wait_drained();
+		__print_direct(prio, tag, func, line, fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	if (!(format = __get_format(fmt, &id)) || format->direct || !(ring = __get_ring())) {
+		__print_direct(prio, tag, func, line, fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	/* Checked again inside, log_stop() waits for the writers that saw the drainer running */
+	__atomic_store_n(&ring->writing, 1, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&g_draining, __ATOMIC_SEQ_CST)) {
+		__atomic_store_n(&ring->writing, 0, __ATOMIC_RELEASE);
+		__ring_wait_drained();
+		__print_direct(prio, tag, func, line, fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	head = ring->head;
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+		/* Never wait on the drainer, the loss shows up in the count */
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&ring->writing, 0, __ATOMIC_RELEASE);
+		va_end(ap);
+		return;
+	}
+
+	record = &ring->records[head % LOG_RING_SIZE];
+	record->tag = tag;
+	record->func = func;
+	record->line = line;
+	record->fmt_id = id;
+	record->prio = (unsigned char) prio;
+
+	for (i = 0; i < format->nargs; i++) {
+		switch (format->types[i]) {
+		case LOG_ARG_INT:
+			record->args[i] = (uint64_t) (int64_t) va_arg(ap, int);
+			break;
+		case LOG_ARG_LONG:
+			record->args[i] = (uint64_t) (int64_t) va_arg(ap, long);
+			break;
+		case LOG_ARG_LLONG:
+			record->args[i] = (uint64_t) va_arg(ap, long long);
+			break;
+		case LOG_ARG_SIZE:
+			record->args[i] = (uint64_t) va_arg(ap, size_t);
+			break;
+		case LOG_ARG_DOUBLE: {
+			double value = va_arg(ap, double);
+			memcpy(&record->args[i], &value, sizeof(value));
+			break;
+		}
+		case LOG_ARG_PTR:
+			record->args[i] = (uint64_t) (uintptr_t) va_arg(ap, void *);
+			break;
+		case LOG_ARG_STR: {
+			const char *value = va_arg(ap, const char *);
+			size_t len = 0;
+
+			if (!value)
+				value = "(null)";
+			len = strlen(value);
+			if (len > LOG_RECORD_STRINGS - 1 - used)
+				len = LOG_RECORD_STRINGS - 1 - used;
+
+			/* Strings share one buffer, the last ones get truncated */
+			memcpy(record->strings + used, value, len);
+			record->strings[used + len] = '\0';
+			record->args[i] = used;
+			used += len + (used + len < LOG_RECORD_STRINGS - 1);
+			break;
+		}
+		}
+	}
+	va_end(ap);
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	/* One post until the drainer runs, it clears the flag before it looks at the rings */
+	if (!__atomic_exchange_n(&g_wake_posted, 1, __ATOMIC_SEQ_CST))
+		sem_post(&g_wakeup);
+
+	__atomic_store_n(&ring->writing, 0, __ATOMIC_RELEASE);
+}
+
+/* Formats a record one conversion at a time, with the argument type read back from its format */
+static void __format_record(const log_record_s *record, char *out, size_t size)
+{
+	const log_format_s *format = &g_formats[record->fmt_id];
+	const char *p = format->fmt;
+	size_t len = 0;
+	unsigned int arg = 0;
+
+	while (*p && len < size - 1) {
+		const char *start = p;
+		char spec[32];
+		size_t spec_len = 0;
+		int n = 0;
+
+		if (*p != '%' || p[1] == '%') {
+			out[len++] = *p;
+			p += (*p == '%') ? 2 : 1;
+			continue;
+		}
+
+		p++;
+		p += strspn(p, "-+ #0");
+		p += strspn(p, "0123456789.");
+		p += strspn(p, "hlzjt");
+		p++;
+
+		spec_len = p - start;
+		if (spec_len >= sizeof(spec) || arg >= format->nargs)
+			break;
+		memcpy(spec, start, spec_len);
+		spec[spec_len] = '\0';
+
+		switch (format->types[arg]) {
+		case LOG_ARG_INT:
+			n = snprintf(out + len, size - len, spec, (int) record->args[arg]);
+			break;
+		case LOG_ARG_LONG:
+			n = snprintf(out + len, size - len, spec, (long) record->args[arg]);
+			break;
+		case LOG_ARG_LLONG:
+			n = snprintf(out + len, size - len, spec, (long long) record->args[arg]);
+			break;
+		case LOG_ARG_SIZE:
+			n = snprintf(out + len, size - len, spec, (size_t) record->args[arg]);
+			break;
+		case LOG_ARG_DOUBLE: {
+			double value = 0.0;
+			memcpy(&value, &record->args[arg], sizeof(value));
+			n = snprintf(out + len, size - len, spec, value);
+			break;
+		}
+		case LOG_ARG_PTR:
+			n = snprintf(out + len, size - len, spec, (void *) (uintptr_t) record->args[arg]);
+			break;
+		case LOG_ARG_STR:
+			n = snprintf(out + len, size - len, spec, record->strings + record->args[arg]);
+			break;
+		}
+		arg++;
+
+		if (n < 0)
+			break;
+		len += (size_t) n < size - len ? (size_t) n : size - len - 1;
+	}
+
+	out[len] = '\0';
+}
+
+static void __drain(void)
+{
+	log_ring_s *ring = NULL;
+	log_ring_s *next = NULL;
+	char message[LOG_LINE_MAX];
+
+	for (ring = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); ring; ring = next) {
+		/* Read first, every record of an exited thread is published by then */
+		int exited = __atomic_load_n(&ring->exited, __ATOMIC_ACQUIRE);
+		unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		unsigned int tail = ring->tail;
+		unsigned int dropped = 0;
+
+		next = ring->next;
+
+		for (; tail != head; tail++) {
+			const log_record_s *record = &ring->records[tail % LOG_RING_SIZE];
+
+			__format_record(record, message, sizeof(message));
+			__print(record->prio, record->tag, record->func, record->line, message);
+		}
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+		dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+		if (dropped)
+			dlog_print(DLOG_WARN, LOG_TAG, "[%s:%d] %u log records dropped\n", __func__, __LINE__, dropped);
+
+		if (exited) {
+			__ring_unlink(ring);
+			free(ring);
+		}
+	}
+}
+
+static void *__drainer(void *data)
+{
+	int stopping = 0;
+
+	while (!stopping) {
+		while (sem_wait(&g_wakeup) != 0)
+			;
+
+		/* Read before the rings, log_stop() posts after setting it */
+		stopping = __atomic_load_n(&g_stopping, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&g_wake_posted, 0, __ATOMIC_SEQ_CST);
+		__drain();
+	}
+
+	return NULL;
+}
+
+void log_set_level(int level)
+{
+	__atomic_store_n(&log_runtime_level, level, __ATOMIC_RELAXED);
+}
+
+int log_start(void)
+{
+	if (g_draining)
+		return 0;
+
+	pthread_once(&g_ring_key_once, __ring_key_create);
+
+	if (sem_init(&g_wakeup, 0, 0) != 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] Failed to create the log wakeup\n", __func__, __LINE__);
+		return -1;
+	}
+
+	g_stopping = 0;
+	g_wake_posted = 0;
+	if (pthread_create(&g_drainer, NULL, __drainer, NULL) != 0) {
+		dlog_print(DLOG_ERROR, LOG_TAG, "[%s:%d] Failed to start the log drainer\n", __func__, __LINE__);
+		sem_destroy(&g_wakeup);
+		return -1;
+	}
+	__atomic_store_n(&g_draining, 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+void log_stop(void)
+{
+	log_ring_s *ring = NULL;
+
+	if (!g_draining)
+		return;
+
+	/* Records written from now on are printed right away */
+	__atomic_store_n(&g_draining, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&g_stopping, 1, __ATOMIC_RELEASE);
+	sem_post(&g_wakeup);
+	pthread_join(g_drainer, NULL);
+
+	/* Writers that saw the drainer running still publish their record, the last drain takes it */
+	for (ring = __atomic_load_n(&g_rings, __ATOMIC_SEQ_CST); ring; ring = ring->next)
+		while (__atomic_load_n(&ring->writing, __ATOMIC_ACQUIRE))
+			sched_yield();
+
+	__drain();
+	sem_destroy(&g_wakeup);
+}
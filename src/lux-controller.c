@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "log.h"
+#include "lux-controller.h"
+
+/* The duty cycle is kept with 8 more bits, so small errors still add up */
+#define ACC_SHIFT 8
+#define ACC_MAX ((int64_t) LUX_CONTROLLER_DUTY_MAX << ACC_SHIFT)
+/* A reading after a longer gap integrates this long only, more would overshoot */
+#define DT_MAX_MS 1000
+
+struct __lux_controller_s {
+	lux_controller_config_s config;
+	int32_t acc; /* The duty cycle in 1/256 steps */
+	int32_t last_error;
+	int has_error; /* last_error and last_ms come from a reading */
+	unsigned int last_ms;
+	unsigned int written; /* The duty cycle handed out last */
+};
+
+lux_controller *lux_controller_new(const lux_controller_config_s *config)
+{
+	lux_controller *ctl = NULL;
+
+	retv_if(!config, NULL);
+
+	ctl = calloc(1, sizeof(lux_controller));
+	retv_if(!ctl, NULL);
+
+	ctl->config = *config;
+
+	return ctl;
+}
+
+void lux_controller_free(lux_controller *ctl)
+{
+	free(ctl);
+}
+
+int lux_controller_update(lux_controller *ctl, unsigned int lux_q4, unsigned int time_ms, unsigned int *duty)
+{
+	int32_t error = 0;
+	unsigned int dt_ms = 0;
+	int64_t acc = 0;
+	unsigned int next = 0;
+	unsigned int change = 0;
+
+	retv_if(!ctl, -1);
+	retv_if(!duty, -1);
+
+	/* The GY30 tops out around 2^21 in 1/16 lux, far from overflowing */
+	error = (int32_t) ctl->config.target_lux_q4 - (int32_t) lux_q4;
+
+	/*
+	 * Velocity form: the proportional part acts on the change of the error, so the
+	 * accumulator is the duty cycle itself and clamping it keeps the integral from winding up.
+	 * The integral part is scaled by the time since the last reading, the sampler changes its pace.
+	 * The products are 32 by 32 bit multiplies into 64 bits, cheap without an FPU.
+	 */
+	acc = ctl->acc;
+	if (ctl->has_error) {
+		/* Unsigned, so the millisecond clock may wrap */
+		dt_ms = time_ms - ctl->last_ms;
+		if (dt_ms > DT_MAX_MS)
+			dt_ms = DT_MAX_MS;
+
+		acc += (int64_t) ctl->config.ki_q8 * error * dt_ms / 1000;
+		acc += (int64_t) ctl->config.kp_q8 * (error - ctl->last_error);
+	}
+	ctl->last_error = error;
+	ctl->last_ms = time_ms;
+	ctl->has_error = 1;
+
+	if (acc < 0)
+		acc = 0;
+	else if (acc > ACC_MAX)
+		acc = ACC_MAX;
+	ctl->acc = (int32_t) acc;
+
+	next = (unsigned int) ctl->acc >> ACC_SHIFT;
+	change = next > ctl->written ? next - ctl->written : ctl->written - next;
+	if (!change)
+		return 0;
+
+	/* Below the threshold the light stays as it is, unless the loop wants it fully off or on */
+	if (change < ctl->config.threshold && next != 0 && next != LUX_CONTROLLER_DUTY_MAX)
+		return 0;
+
+	ctl->written = next;
+	*duty = next;
+
+	return 1;
+}
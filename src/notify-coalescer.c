@@ -0,0 +1,229 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "notify-coalescer.h"
+#include "tracing.h"
+
+#define NOTIFY_URI_MAX 8
+
+typedef struct {
+	char *uri;
+	double min_interval;
+	double last_sent;
+	int dirty;
+	notify_coalescer_stats_s stats;
+} notify_uri_s;
+
+static struct {
+	notify_coalescer_send_cb cb;
+	void *data;
+	notify_uri_s uris[NOTIFY_URI_MAX];
+	unsigned int count;
+	Ecore_Idle_Enterer *flusher; /* Runs once the current loop iteration is done */
+	Ecore_Timer *retry; /* Wakes up for a dirty URI still inside its interval */
+} g_notify;
+
+static notify_uri_s *__find_uri(const char *uri)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < g_notify.count; i++) {
+		if (!strcmp(g_notify.uris[i].uri, uri))
+			return &g_notify.uris[i];
+	}
+
+	return NULL;
+}
+
+static void __notify_flush(void);
+
+static Eina_Bool __notify_flusher(void *data)
+{
+	TRACE_BEGIN("notify_flush");
+	g_notify.flusher = NULL;
+	__notify_flush();
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool __notify_retry(void *data)
+{
+	TRACE_BEGIN("notify_retry");
+	g_notify.retry = NULL;
+	__notify_flush();
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void __notify_flush(void)
+{
+	double now = ecore_time_get();
+	double next = -1.0;
+	unsigned int i = 0;
+	int ret = 0;
+
+	for (i = 0; i < g_notify.count; i++) {
+		notify_uri_s *entry = &g_notify.uris[i];
+		double due = entry->last_sent + entry->min_interval;
+
+		if (!entry->dirty)
+			continue;
+
+		if (entry->stats.sent && due > now) {
+			if (next < 0.0 || due < next)
+				next = due;
+			continue;
+		}
+
+		entry->dirty = 0;
+		ret = g_notify.cb(entry->uri, g_notify.data);
+		if (ret == NOTIFY_COALESCER_SKIPPED) {
+			entry->stats.skipped++;
+			continue;
+		} else if (ret) {
+			entry->stats.failed++;
+			continue;
+		}
+		entry->stats.sent++;
+		entry->last_sent = now;
+	}
+
+	if (g_notify.retry) {
+		ecore_timer_del(g_notify.retry);
+		g_notify.retry = NULL;
+	}
+
+	if (next < 0.0)
+		return;
+
+	g_notify.retry = ecore_timer_add(next - now, __notify_retry, NULL);
+	if (!g_notify.retry)
+		_E("Failed to add notify retry timer");
+}
+
+int notify_coalescer_init(notify_coalescer_send_cb cb, void *data)
+{
+	retv_if(!cb, -1);
+
+	notify_coalescer_fini();
+	g_notify.cb = cb;
+	g_notify.data = data;
+
+	return 0;
+}
+
+void notify_coalescer_fini(void)
+{
+	unsigned int i = 0;
+
+	if (g_notify.flusher)
+		ecore_idle_enterer_del(g_notify.flusher);
+	if (g_notify.retry)
+		ecore_timer_del(g_notify.retry);
+
+	for (i = 0; i < g_notify.count; i++) {
+		notify_uri_s *entry = &g_notify.uris[i];
+		_I("%s : %u marked, %u sent, %u suppressed, %u skipped, %u failed", entry->uri,
+				entry->stats.marked, entry->stats.sent, entry->stats.suppressed,
+				entry->stats.skipped, entry->stats.failed);
+		free(entry->uri);
+	}
+
+	memset(&g_notify, 0, sizeof(g_notify));
+}
+
+int notify_coalescer_add_uri(const char *uri, double min_interval)
+{
+	notify_uri_s *entry = NULL;
+
+	retv_if(!uri, -1);
+	retv_if(min_interval < 0.0, -1);
+	retv_if(!g_notify.cb, -1);
+
+	entry = __find_uri(uri);
+	if (entry) {
+		entry->min_interval = min_interval;
+		return 0;
+	}
+
+	retvm_if(g_notify.count >= NOTIFY_URI_MAX, -1, "Too many URIs");
+
+	entry = &g_notify.uris[g_notify.count];
+	memset(entry, 0, sizeof(notify_uri_s));
+	entry->uri = strdup(uri);
+	retv_if(!entry->uri, -1);
+	entry->min_interval = min_interval;
+	g_notify.count++;
+
+	return 0;
+}
+
+int notify_coalescer_mark(const char *uri)
+{
+	notify_uri_s *entry = NULL;
+
+	retv_if(!uri, -1);
+
+	entry = __find_uri(uri);
+	retvm_if(!entry, -1, "Unknown URI : %s", uri);
+
+	entry->stats.marked++;
+	if (entry->dirty) {
+		entry->stats.suppressed++;
+		return 0;
+	}
+
+	/* Only dirty with a flusher on the way, otherwise the next mark tries again */
+	if (!g_notify.flusher) {
+		g_notify.flusher = ecore_idle_enterer_add(__notify_flusher, NULL);
+		retv_if(!g_notify.flusher, -1);
+	}
+	entry->dirty = 1;
+
+	return 0;
+}
+
+int notify_coalescer_get_stats(const char *uri, notify_coalescer_stats_s *stats)
+{
+	notify_uri_s *entry = NULL;
+	unsigned int i = 0;
+
+	retv_if(!stats, -1);
+
+	if (uri) {
+		entry = __find_uri(uri);
+		retv_if(!entry, -1);
+		*stats = entry->stats;
+		return 0;
+	}
+
+	memset(stats, 0, sizeof(notify_coalescer_stats_s));
+	for (i = 0; i < g_notify.count; i++) {
+		stats->marked += g_notify.uris[i].stats.marked;
+		stats->sent += g_notify.uris[i].stats.sent;
+		stats->suppressed += g_notify.uris[i].stats.suppressed;
+		stats->skipped += g_notify.uris[i].stats.skipped;
+		stats->failed += g_notify.uris[i].stats.failed;
+	}
+
+	return 0;
+}
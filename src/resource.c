@@ -12,28 +12,105 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
 #include <peripheral_io.h>
 
 #include "log.h"
 #include "resource.h"
 
-static resource_s resource_info[PIN_MAX] = { {0, NULL, NULL}, };
+#define RESOURCE_OPEN_WORDS ((RESOURCE_ID_MAX + 63) / 64)
 
-resource_s *resource_get_info(int pin_num)
+static resource_s resource_info[RESOURCE_ID_MAX] = { {0, NULL, NULL, NULL, -1, 0, 0}, };
+
+/* The open resources, so walking them costs the number open and not the table size.
+ * Updated atomically since the prewarm opens different resources from several threads. */
+static uint64_t g_opened[RESOURCE_OPEN_WORDS] = { 0, };
+
+resource_s *resource_get_info(int id)
 {
-	return &resource_info[pin_num];
+	retv_if(id < 0 || id >= RESOURCE_ID_MAX, NULL);
+
+	return &resource_info[id];
 }
 
-void resource_close_all(void)
+void resource_set_opened(int id, const resource_driver_s *driver)
 {
-	int i = 0;
-	for (i = 0; i < PIN_MAX; i++) {
-		if (!resource_info[i].opened) continue;
-		_I("GPIO[%d] is closing...", i);
+	ret_if(id < 0 || id >= RESOURCE_ID_MAX);
 
-		if (resource_info[i].close)
-			resource_info[i].close(i);
+	resource_info[id].opened = 1;
+	resource_info[id].driver = driver;
+	__atomic_fetch_or(&g_opened[id / 64], 1ULL << (id % 64), __ATOMIC_RELAXED);
+}
+
+void resource_set_closed(int id)
+{
+	ret_if(id < 0 || id >= RESOURCE_ID_MAX);
+
+	resource_info[id].opened = 0;
+	resource_info[id].driver = NULL;
+	__atomic_fetch_and(&g_opened[id / 64], ~(1ULL << (id % 64)), __ATOMIC_RELAXED);
+}
+
+void resource_foreach_opened(resource_foreach_cb cb, void *data)
+{
+	uint64_t pending = 0;
+	int word = 0;
+	int id = 0;
+
+	ret_if(!cb);
+
+	for (word = 0; word < RESOURCE_OPEN_WORDS; word++) {
+		/* A snapshot of the word, the callback may close what it is given */
+		for (pending = __atomic_load_n(&g_opened[word], __ATOMIC_RELAXED); pending; pending &= pending - 1) {
+			id = word * 64 + __builtin_ctzll(pending);
+			if (resource_info[id].opened)
+				cb(id, &resource_info[id], data);
+		}
 	}
+}
+
+static void __close_resource(int id, resource_s *info, void *data)
+{
+	const resource_driver_s *driver = info->driver;
+
+	_I("%s[%d] is closing...", driver ? driver->name : "Resource", id);
 
-	
+	if (driver && driver->close)
+		driver->close(id);
+
+	/* Never left marked open, whatever the driver did */
+	if (info->opened)
+		resource_set_closed(id);
+}
+
+int resource_read(int id, uint32_t *out_value)
+{
+	const resource_driver_s *driver = NULL;
+
+	retv_if(id < 0 || id >= RESOURCE_ID_MAX, -1);
+	retv_if(!out_value, -1);
+
+	driver = resource_info[id].driver;
+	retvm_if(!resource_info[id].opened || !driver, -1, "Resource %d is not open", id);
+	retvm_if(!driver->read, -1, "%s[%d] cannot be read", driver->name, id);
+
+	return driver->read(id, out_value);
+}
+
+int resource_write(int id, int value)
+{
+	const resource_driver_s *driver = NULL;
+
+	retv_if(id < 0 || id >= RESOURCE_ID_MAX, -1);
+
+	driver = resource_info[id].driver;
+	retvm_if(!resource_info[id].opened || !driver, -1, "Resource %d is not open", id);
+	retvm_if(!driver->write, -1, "%s[%d] cannot be written", driver->name, id);
+
+	return driver->write(id, value);
+}
+
+void resource_close_all(void)
+{
+	resource_foreach_opened(__close_resource, NULL);
 }
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <peripheral_io.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "resource/resource_i2c_bus.h"
+#include "resource/resource_io_worker.h"
+#include "resource/resource_metrics.h"
+#include "tracing.h"
+
+#define I2C_STEP_WAITING 1 /* The step stopped at a delay */
+
+typedef struct _i2c_transaction_s {
+	resource_i2c_op_s *ops;
+	unsigned int count;
+	unsigned int index;
+	int cancelled; /* Dropped while the worker ran it, freed once it comes back */
+	resource_i2c_done_cb cb;
+	void *data;
+	struct _i2c_transaction_s *next;
+} i2c_transaction_s;
+
+struct _resource_i2c_device_s {
+	int bus;
+	int address;
+	int refcount;
+	peripheral_i2c_h handle;
+	int metrics_id; /* -1 while nobody counts the calls */
+	double ready_at; /* The device converts until then, its queue waits */
+	int busy; /* The head transaction is on the I/O worker */
+	i2c_transaction_s *head;
+	i2c_transaction_s *tail;
+	struct _resource_i2c_device_s *next;
+};
+
+static resource_i2c_device *g_devices = NULL;
+static Ecore_Job *g_dispatch_job = NULL;
+static Ecore_Timer *g_dispatch_timer = NULL;
+static Ecore_Idle_Enterer *g_dispatch_retry = NULL;
+static int g_dispatching = 0;
+
+static void __i2c_bus_schedule(void);
+
+static void __transaction_free(i2c_transaction_s *transaction)
+{
+	free(transaction->ops);
+	free(transaction);
+}
+
+static void __device_drop_queue(resource_i2c_device *device)
+{
+	i2c_transaction_s *keep = NULL;
+
+	/* The worker still uses the head of a busy device */
+	if (device->busy && device->head) {
+		keep = device->head;
+		keep->cancelled = 1;
+		device->head = keep->next;
+		keep->next = NULL;
+	}
+
+	while (device->head) {
+		i2c_transaction_s *transaction = device->head;
+		device->head = transaction->next;
+		__transaction_free(transaction);
+	}
+	device->head = keep;
+	device->tail = keep;
+}
+
+/* Devices released during a dispatch are only unlinked once it is over */
+static void __device_collect(void)
+{
+	resource_i2c_device **link = &g_devices;
+
+	while (*link) {
+		resource_i2c_device *device = *link;
+		if (device->refcount > 0 || device->busy) {
+			link = &device->next;
+			continue;
+		}
+
+		*link = device->next;
+		__device_drop_queue(device);
+		_I("I2C[%d:0x%02x] is closing...", device->bus, device->address);
+		peripheral_i2c_close(device->handle);
+		free(device);
+	}
+}
+
+resource_i2c_device *resource_i2c_bus_get(int bus, int address)
+{
+	resource_i2c_device *device = NULL;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	/*
+	 * A released device can still be linked, waiting for its cancelled step to come back
+	 * from the worker. It is taken back as is, a second handle would talk to the same slave.
+	 */
+	for (device = g_devices; device; device = device->next) {
+		if (device->bus == bus && device->address == address) {
+			if (device->refcount++ == 0)
+				device->metrics_id = -1;
+			return device;
+		}
+	}
+
+	device = calloc(1, sizeof(resource_i2c_device));
+	retv_if(!device, NULL);
+
+	TRACE_BEGIN("i2c_open");
+	ret = peripheral_i2c_open(bus, address, &device->handle);
+	TRACE_END();
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("i2c open error : %s", get_error_message(ret));
+		free(device);
+		return NULL;
+	}
+
+	device->bus = bus;
+	device->address = address;
+	device->metrics_id = -1;
+	device->refcount = 1;
+	device->next = g_devices;
+	g_devices = device;
+
+	return device;
+}
+
+void resource_i2c_bus_put(resource_i2c_device *device)
+{
+	ret_if(!device);
+	ret_if(device->refcount <= 0);
+
+	if (--device->refcount > 0)
+		return;
+
+	/* A step still on the worker comes back cancelled, and the device is collected after it */
+	__device_drop_queue(device);
+	if (!g_dispatching)
+		__device_collect();
+}
+
+void resource_i2c_bus_set_metrics(resource_i2c_device *device, int id)
+{
+	ret_if(!device);
+
+	device->metrics_id = id;
+}
+
+static int __op_run(resource_i2c_device *device, const resource_i2c_op_s *op)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	unsigned long long start = resource_metrics_now();
+
+	if (op->type == RESOURCE_I2C_OP_WRITE) {
+		TRACE_BEGIN("i2c_write");
+		ret = peripheral_i2c_write(device->handle, op->buf, op->len);
+		TRACE_END();
+		resource_metrics_record(device->metrics_id, RESOURCE_METRICS_WRITE, start, ret != PERIPHERAL_ERROR_NONE);
+	} else if (op->type == RESOURCE_I2C_OP_READ) {
+		TRACE_BEGIN("i2c_read");
+		ret = peripheral_i2c_read(device->handle, op->buf, op->len);
+		TRACE_END();
+		resource_metrics_record(device->metrics_id, RESOURCE_METRICS_READ, start, ret != PERIPHERAL_ERROR_NONE);
+	}
+
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("I2C[%d:0x%02x] %s error : %s", device->bus, device->address,
+				op->type == RESOURCE_I2C_OP_WRITE ? "write" : "read", get_error_message(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Runs the head transaction up to its next delay or its end, on the I/O worker if there is one */
+static int __device_step_work(void *data)
+{
+	resource_i2c_device *device = data;
+	i2c_transaction_s *transaction = device->head;
+
+	while (transaction->index < transaction->count) {
+		const resource_i2c_op_s *op = &transaction->ops[transaction->index];
+
+		if (op->type == RESOURCE_I2C_OP_DELAY)
+			return I2C_STEP_WAITING;
+
+		transaction->index++;
+		if (__op_run(device, op) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Back on the main loop, parks the device on a delay or completes the transaction */
+static void __device_step_done(resource_i2c_device *device, int result)
+{
+	i2c_transaction_s *transaction = device->head;
+
+	device->busy = 0;
+
+	if (result == I2C_STEP_WAITING && !transaction->cancelled) {
+		device->ready_at = ecore_time_get() + transaction->ops[transaction->index++].delay;
+		return;
+	}
+
+	device->head = transaction->next;
+	if (!device->head)
+		device->tail = NULL;
+
+	if (transaction->cb && !transaction->cancelled)
+		transaction->cb(result, transaction->data);
+	__transaction_free(transaction);
+}
+
+static void __i2c_bus_kick(void);
+
+static void __device_step_worker_done(int result, void *data)
+{
+	g_dispatching = 1;
+	__device_step_done(data, result);
+	g_dispatching = 0;
+
+	/* Steps finished together are handed back together, one dispatch picks up after them */
+	__i2c_bus_kick();
+}
+
+static Eina_Bool __i2c_bus_dispatch_retry(void *data);
+
+static void __i2c_bus_dispatch(void)
+{
+	resource_i2c_device *device = NULL;
+	int progress = 0;
+	int full = 0;
+
+	g_dispatching = 1;
+
+	/*
+	 * Each pass gives every ready device one step, passes repeat while any ran inline.
+	 * With the worker, the steps of a pass are queued together and run back to back there.
+	 */
+	do {
+		double now = ecore_time_get();
+
+		progress = 0;
+		for (device = g_devices; device; device = device->next) {
+			if (device->refcount <= 0 || device->busy || !device->head || device->ready_at > now)
+				continue;
+
+			device->busy = 1;
+			if (resource_io_submit(__device_step_work, __device_step_worker_done, device) == 0)
+				continue;
+
+			/* The handles belong to a running worker, a full queue only means waiting for room */
+			if (resource_io_worker_running()) {
+				device->busy = 0;
+				full = 1;
+				break;
+			}
+
+			__device_step_done(device, __device_step_work(device));
+			progress = 1;
+		}
+	} while (progress);
+
+	g_dispatching = 0;
+	__device_collect();
+
+	if (full && !g_dispatch_retry) {
+		g_dispatch_retry = ecore_idle_enterer_add(__i2c_bus_dispatch_retry, NULL);
+		if (!g_dispatch_retry)
+			_E("Failed to add the i2c retry, the steps wait for the next dispatch");
+	}
+
+	__i2c_bus_schedule();
+}
+
+static void __i2c_bus_dispatch_job(void *data)
+{
+	TRACE_BEGIN("i2c_dispatch_job");
+	g_dispatch_job = NULL;
+	__i2c_bus_dispatch();
+	TRACE_END();
+}
+
+static void __i2c_bus_kick(void)
+{
+	if (g_dispatching || g_dispatch_job)
+		return;
+
+	g_dispatch_job = ecore_job_add(__i2c_bus_dispatch_job, NULL);
+	if (!g_dispatch_job)
+		_E("Failed to add i2c dispatch job");
+}
+
+/* Runs after the completions that freed the queue slots were handed back */
+static Eina_Bool __i2c_bus_dispatch_retry(void *data)
+{
+	TRACE_BEGIN("i2c_dispatch_retry");
+	g_dispatch_retry = NULL;
+	__i2c_bus_dispatch();
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool __i2c_bus_dispatch_timer(void *data)
+{
+	TRACE_BEGIN("i2c_dispatch_timer");
+	g_dispatch_timer = NULL;
+	__i2c_bus_dispatch();
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/* Wakes up for the earliest device that has work and is converting */
+static void __i2c_bus_schedule(void)
+{
+	resource_i2c_device *device = NULL;
+	double next = -1.0;
+	double now = ecore_time_get();
+
+	if (g_dispatch_timer) {
+		ecore_timer_del(g_dispatch_timer);
+		g_dispatch_timer = NULL;
+	}
+
+	/* Ready devices would only find the queue full again, the retry dispatches once it has room */
+	if (g_dispatch_retry)
+		return;
+
+	for (device = g_devices; device; device = device->next) {
+		if (device->refcount <= 0 || device->busy || !device->head)
+			continue;
+		if (next < 0.0 || device->ready_at < next)
+			next = device->ready_at;
+	}
+
+	if (next < 0.0)
+		return;
+
+	g_dispatch_timer = ecore_timer_add(next > now ? next - now : 0.0, __i2c_bus_dispatch_timer, NULL);
+	if (!g_dispatch_timer)
+		_E("Failed to add i2c dispatch timer");
+}
+
+int resource_i2c_bus_submit(resource_i2c_device *device, const resource_i2c_op_s *ops, unsigned int count, resource_i2c_done_cb cb, void *data)
+{
+	i2c_transaction_s *transaction = NULL;
+
+	retv_if(!device, -1);
+	retv_if(device->refcount <= 0, -1);
+	retv_if(!ops, -1);
+	retv_if(count == 0, -1);
+
+	transaction = calloc(1, sizeof(i2c_transaction_s));
+	retv_if(!transaction, -1);
+
+	transaction->ops = malloc(count * sizeof(resource_i2c_op_s));
+	if (!transaction->ops) {
+		free(transaction);
+		return -1;
+	}
+	memcpy(transaction->ops, ops, count * sizeof(resource_i2c_op_s));
+	transaction->count = count;
+	transaction->cb = cb;
+	transaction->data = data;
+
+	if (device->tail)
+		device->tail->next = transaction;
+	else
+		device->head = transaction;
+	device->tail = transaction;
+
+	/* Transactions submitted in the same iteration are picked up by one dispatch */
+	__i2c_bus_kick();
+
+	return 0;
+}
+
+int resource_i2c_bus_run(resource_i2c_device *device, const resource_i2c_op_s *ops, unsigned int count)
+{
+	unsigned int i = 0;
+
+	retv_if(!device, -1);
+	retv_if(device->refcount <= 0, -1);
+	retv_if(!ops, -1);
+	retvm_if(device->head, -1, "I2C[%d:0x%02x] has queued work", device->bus, device->address);
+
+	for (i = 0; i < count; i++) {
+		retvm_if(ops[i].type == RESOURCE_I2C_OP_DELAY, -1, "Delays need resource_i2c_bus_submit()");
+		retv_if(__op_run(device, &ops[i]), -1);
+	}
+
+	return 0;
+}
+
+void resource_i2c_bus_cancel(resource_i2c_device *device)
+{
+	ret_if(!device);
+
+	__device_drop_queue(device);
+	if (!device->busy)
+		device->ready_at = 0.0;
+}
@@ -20,75 +20,379 @@
 #include <unistd.h>
 #include <peripheral_io.h>
 #include <sys/time.h>
+#include <Ecore.h>
 
 #include "log.h"
 #include "resource_internal.h"
 #include "resource.h"
+#include "resource/resource_i2c_bus.h"
+#include "resource/resource_metrics.h"
 
 #define I2C_PIN_MAX 28
 /* I2C */
 #define GY30_ADDR 0x23 /* Address of GY30 light sensor */
 #define GY30_CONT_HIGH_RES_MODE 0x10 /* Start measurement at 11x resolution. Measurement time is approx 120mx */
+#define GY30_CONT_HIGH_RES_MODE2 0x11 /* Start measurement at 0.5lx resolution. Measurement time is approx 120ms */
+#define GY30_CONT_LOW_RES_MODE 0x13 /* Start measurement at 4lx resolution. Measurement time is approx 16ms */
+#define GY30_ONE_TIME_OFFSET 0x10 /* One time variant of each continuous mode, powers down afterwards */
+#define GY30_IS_ONE_TIME(mode) (((mode) & 0xf0) == 0x20)
+#define GY30_MTREG_HIGH 0x40 /* Measurement time register, bit 7:5 */
+#define GY30_MTREG_LOW 0x60 /* Measurement time register, bit 4:0 */
+#define GY30_MTREG_DEFAULT 69
+#define GY30_TIME_MAX_RATIO (1.5) /* Worst case over typical conversion time */
 #define GY30_CONSTANT_NUM (1.2)
+/* Counts to 1/16 lux at the default mtreg, 16 / GY30_CONSTANT_NUM * GY30_MTREG_DEFAULT is a whole number */
+#define GY30_LUX_Q4_NUM (16 * 10 * GY30_MTREG_DEFAULT / 12)
+#define GY30_COUNT_MAX 65535
+#define GY30_OPS_MAX 5 /* Two mtreg writes, the mode, the conversion delay and the result */
+
+/* Auto ranging moves to a brighter range above this count, to a darker one below half its top */
+#define GY30_COUNT_HIGH_WATER (GY30_COUNT_MAX * 9 / 10)
+
+typedef struct {
+	unsigned char mode;
+	unsigned char mtreg;
+	double typ_time; /* Typical conversion time in seconds at this mtreg */
+	double lux_max;
+} gy30_range_s;
+
+/* Indexed by resource_illuminance_range_e minus one, darkest first */
+static const gy30_range_s g_ranges[] = {
+	{ GY30_CONT_HIGH_RES_MODE2, 254, 0.120 * 254 / GY30_MTREG_DEFAULT, GY30_COUNT_MAX / GY30_CONSTANT_NUM / 2 * GY30_MTREG_DEFAULT / 254 },
+	{ GY30_CONT_HIGH_RES_MODE, GY30_MTREG_DEFAULT, 0.120, GY30_COUNT_MAX / GY30_CONSTANT_NUM },
+	{ GY30_CONT_LOW_RES_MODE, 31, 0.016 * 31 / GY30_MTREG_DEFAULT, GY30_COUNT_MAX / GY30_CONSTANT_NUM * GY30_MTREG_DEFAULT / 31 },
+};
+
+#define GY30_RANGE_COUNT (sizeof(g_ranges) / sizeof(g_ranges[0]))
 
 static struct {
-	int opened;
-	peripheral_i2c_h sensor_h;
+	resource_i2c_device *device;
+	int i2c_bus;
+	unsigned char mode; /* Last mode command sent, 0 while powered down */
+	unsigned char mtreg; /* Measurement time register value programmed */
+	double started; /* When the conversion in progress started */
+	double last_read; /* When the last asynchronous result was read */
+	resource_illuminance_range_e requested;
+	resource_illuminance_range_e range; /* The range used for the next conversion */
+	int pending; /* An asynchronous read is queued on the bus */
+	unsigned char commands[GY30_OPS_MAX];
+	unsigned char result[2];
+	resource_illuminance_cb cb;
+	void *data;
 } resource_sensor_s;
 
+static int __driver_open(int id, int bus)
+{
+	return resource_open_illuminance_sensor(bus);
+}
+
+static int __driver_read(int id, uint32_t *out_value)
+{
+	return resource_read_illuminance_sensor(resource_sensor_s.i2c_bus, out_value);
+}
+
+static void __driver_close(int id)
+{
+	resource_close_illuminance_sensor();
+}
+
+const resource_driver_s resource_illuminance_driver = {
+	RESOURCE_TYPE_I2C, "Illuminance", __driver_open, __driver_read, NULL, __driver_close
+};
+
 void resource_close_illuminance_sensor(void)
 {
-	if (!resource_sensor_s.opened)
+	if (!resource_get_info(RESOURCE_ID_ILLUMINANCE)->opened)
 		return;
 
+	resource_cancel_illuminance_sensor_async();
+
 	_I("Illuminance Sensor is finishing...");
-	peripheral_i2c_close(resource_sensor_s.sensor_h);
-	resource_sensor_s.opened = 0;
+	resource_i2c_bus_put(resource_sensor_s.device);
+	resource_sensor_s.device = NULL;
+	resource_sensor_s.mode = 0;
+	resource_set_closed(RESOURCE_ID_ILLUMINANCE);
 }
 
-int resource_read_illuminance_sensor(int i2c_bus, uint32_t *out_value)
+/* After a failed or dropped transaction the sensor state is unknown, program it again */
+static inline void __forget_conversion(void)
 {
-	int ret = PERIPHERAL_ERROR_NONE;
-	static int write = 0;
-	unsigned char buf[10] = { 0, };
-	unsigned int delay_usec = 20000; // 20mS delay
-
-	if (!resource_sensor_s.opened) {
-		ret = peripheral_i2c_open(i2c_bus, GY30_ADDR, &resource_sensor_s.sensor_h);
-		if (ret != PERIPHERAL_ERROR_NONE) {
-			_E("i2c open error : %s", get_error_message(ret));
-			return -1;
-		}
-		resource_sensor_s.opened = 1;
-		write = 0;
-	}
+	resource_sensor_s.mode = 0;
+	resource_sensor_s.mtreg = 0;
+}
+
+static int __open_illuminance_sensor(int i2c_bus)
+{
+	unsigned long long start = 0;
+
+	if (resource_get_info(RESOURCE_ID_ILLUMINANCE)->opened)
+		return 0;
+
+	start = resource_metrics_now();
+	resource_sensor_s.device = resource_i2c_bus_get(i2c_bus, GY30_ADDR);
+	resource_metrics_record(RESOURCE_ID_ILLUMINANCE, RESOURCE_METRICS_OPEN, start, !resource_sensor_s.device);
+	retv_if(!resource_sensor_s.device, -1);
+
+	resource_i2c_bus_set_metrics(resource_sensor_s.device, RESOURCE_ID_ILLUMINANCE);
+
+	resource_sensor_s.i2c_bus = i2c_bus;
+	resource_set_opened(RESOURCE_ID_ILLUMINANCE, &resource_illuminance_driver);
+	/* An earlier user may have left another measurement time programmed, the first conversion sets it */
+	__forget_conversion();
+	resource_sensor_s.last_read = 0.0;
+	if (!resource_sensor_s.range)
+		resource_sensor_s.range = RESOURCE_ILLUMINANCE_RANGE_NORMAL;
+
+	return 0;
+}
 
-	buf[0] = 0x10;
+int resource_open_illuminance_sensor(int i2c_bus)
+{
+	return __open_illuminance_sensor(i2c_bus);
+}
+
+static inline const gy30_range_s *__range_info(resource_illuminance_range_e range)
+{
+	return &g_ranges[range - RESOURCE_ILLUMINANCE_RANGE_DARK];
+}
+
+static inline void __add_command(resource_i2c_op_s *ops, unsigned int *count, unsigned char command)
+{
+	resource_sensor_s.commands[*count] = command;
+	ops[*count].type = RESOURCE_I2C_OP_WRITE;
+	ops[*count].buf = &resource_sensor_s.commands[*count];
+	ops[*count].len = 1;
+	(*count)++;
+}
+
+/* Fills in the writes programming the measurement time if needed and starting the conversion */
+static unsigned int __conversion_ops(int one_time, resource_i2c_op_s *ops)
+{
+	const gy30_range_s *info = __range_info(resource_sensor_s.range);
+	unsigned char mode = info->mode + (one_time ? GY30_ONE_TIME_OFFSET : 0);
+	unsigned int count = 0;
 
-	if (!write) {
-		ret = peripheral_i2c_write(resource_sensor_s.sensor_h, buf, 1);
-		if (ret != PERIPHERAL_ERROR_NONE) {
-			_E("i2c write error : %s", get_error_message(ret));
-			return -1;
-		}
-		write = 1;
+	if (resource_sensor_s.mtreg != info->mtreg) {
+		__add_command(ops, &count, GY30_MTREG_HIGH | (info->mtreg >> 5));
+		__add_command(ops, &count, GY30_MTREG_LOW | (info->mtreg & 0x1f));
+		resource_sensor_s.mtreg = info->mtreg;
 	}
 
-	ret = peripheral_i2c_read(resource_sensor_s.sensor_h, buf, 2);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		_E("i2c read error : %s", get_error_message(ret));
+	__add_command(ops, &count, mode);
+
+	resource_sensor_s.mode = mode;
+	resource_sensor_s.started = ecore_time_get();
+
+	return count;
+}
+
+static int __start_conversion(int one_time)
+{
+	resource_i2c_op_s ops[GY30_OPS_MAX] = { { 0, }, };
+	unsigned int count = __conversion_ops(one_time, ops);
+
+	if (resource_i2c_bus_run(resource_sensor_s.device, ops, count)) {
+		__forget_conversion();
 		return -1;
 	}
 
-	*out_value = (buf[0] << 8 | buf[1]) / GY30_CONSTANT_NUM; // Just Sum High 8bit and Low 8bit
+	return 0;
+}
+
+static inline int __conversion_running(int one_time)
+{
+	const gy30_range_s *info = __range_info(resource_sensor_s.range);
+
+	/* A one time conversion is never reused, it powers the sensor down */
+	return !one_time && resource_sensor_s.mode == info->mode && resource_sensor_s.mtreg == info->mtreg;
+}
+
+/* Picks the range of the next conversion from the count just read in the range @a measured */
+static void __update_range(resource_illuminance_range_e measured, unsigned int count, double lux)
+{
+	resource_illuminance_range_e range = measured;
+
+	/* Fixed meanwhile, or already moved on since that conversion started */
+	if (resource_sensor_s.requested != RESOURCE_ILLUMINANCE_RANGE_AUTO || measured != resource_sensor_s.range)
+		return;
+
+	if (count >= GY30_COUNT_HIGH_WATER && range < RESOURCE_ILLUMINANCE_RANGE_BRIGHT)
+		range++;
+	else if (range > RESOURCE_ILLUMINANCE_RANGE_DARK && lux < __range_info(range - 1)->lux_max / 2)
+		range--;
+
+	if (range != resource_sensor_s.range) {
+		_D("Illuminance range %d -> %d at %.1f lux", resource_sensor_s.range, range, lux);
+		resource_sensor_s.range = range;
+	}
+}
+
+/* @a range is the one the conversion was started with, the current one may have changed since */
+static void __handle_result(const unsigned char *buf, resource_illuminance_range_e range,
+		double *out_lux, unsigned int *out_lux_q4, resource_illuminance_range_e *out_range)
+{
+	const gy30_range_s *info = NULL;
+	unsigned int count = 0;
+	unsigned int lux_q4 = 0;
+	double lux = 0.0;
+
+	info = __range_info(range);
+	count = buf[0] << 8 | buf[1]; // Just Sum High 8bit and Low 8bit
+	lux = count / GY30_CONSTANT_NUM * GY30_MTREG_DEFAULT / info->mtreg;
+	lux_q4 = count * GY30_LUX_Q4_NUM / info->mtreg;
+	if (info->mode == GY30_CONT_HIGH_RES_MODE2) {
+		lux /= 2;
+		lux_q4 /= 2;
+	}
+
+	*out_lux = lux;
+	if (out_lux_q4)
+		*out_lux_q4 = lux_q4;
+	if (out_range)
+		*out_range = range;
+
+	__update_range(range, count, lux);
+}
+
+int resource_read_illuminance_sensor(int i2c_bus, uint32_t *out_value)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	unsigned char buf[2] = { 0, };
+	resource_i2c_op_s read_op = { RESOURCE_I2C_OP_READ, buf, 2, 0.0 };
+	double lux = 0.0;
+
+	ret = __open_illuminance_sensor(i2c_bus);
+	retv_if(ret != 0, -1);
+	if (resource_sensor_s.pending)
+		return RESOURCE_ILLUMINANCE_BUSY;
+
+	if (!__conversion_running(0)) {
+		ret = __start_conversion(0);
+		retv_if(ret != 0, -1);
+	}
+
+	/* Until then the sensor holds no result, or one of the previous range the count cannot be scaled by */
+	if (ecore_time_get() - resource_sensor_s.started < resource_get_illuminance_sensor_conversion_time())
+		return RESOURCE_ILLUMINANCE_BUSY;
+
+	ret = resource_i2c_bus_run(resource_sensor_s.device, &read_op, 1);
+	retv_if(ret != 0, -1);
+
+	__handle_result(buf, resource_sensor_s.range, &lux, NULL, NULL);
+
+	*out_value = (uint32_t) lux;
+
+	return 0;
+}
+
+int resource_set_illuminance_sensor_range(resource_illuminance_range_e range)
+{
+	retvm_if(range < RESOURCE_ILLUMINANCE_RANGE_AUTO || range > RESOURCE_ILLUMINANCE_RANGE_BRIGHT, -1,
+			"Invalid range : %d", range);
+
+	resource_sensor_s.requested = range;
+	if (range != RESOURCE_ILLUMINANCE_RANGE_AUTO)
+		resource_sensor_s.range = range;
+	else if (!resource_sensor_s.range)
+		resource_sensor_s.range = RESOURCE_ILLUMINANCE_RANGE_NORMAL;
+
+	return 0;
+}
+
+resource_illuminance_range_e resource_get_illuminance_sensor_range(void)
+{
+	return resource_sensor_s.range ? resource_sensor_s.range : RESOURCE_ILLUMINANCE_RANGE_NORMAL;
+}
+
+double resource_get_illuminance_sensor_conversion_time(void)
+{
+	return __range_info(resource_get_illuminance_sensor_range())->typ_time * GY30_TIME_MAX_RATIO;
+}
+
+static void __conversion_done(int result, void *data)
+{
+	resource_illuminance_range_e range = (resource_illuminance_range_e) (long) data;
+	resource_illuminance_sample_s sample = { 0.0, 0, 0.0, RESOURCE_ILLUMINANCE_RANGE_NORMAL };
+	resource_illuminance_cb cb = resource_sensor_s.cb;
+	void *cb_data = resource_sensor_s.data;
+
+	resource_sensor_s.pending = 0;
+	resource_sensor_s.cb = NULL;
+	resource_sensor_s.data = NULL;
+
+	/* The one time modes power the sensor down on their own */
+	if (GY30_IS_ONE_TIME(resource_sensor_s.mode))
+		resource_sensor_s.mode = 0;
+
+	if (result)
+		__forget_conversion();
+	else
+		__handle_result(resource_sensor_s.result, range, &sample.lux, &sample.lux_q4, &sample.range);
+	sample.timestamp = ecore_time_get();
+	resource_sensor_s.last_read = sample.timestamp;
+
+	if (cb)
+		cb(result ? NULL : &sample, cb_data);
+}
+
+int resource_read_illuminance_sensor_async(int i2c_bus, resource_illuminance_mode_e mode, resource_illuminance_cb cb, void *data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	int one_time = (mode == RESOURCE_ILLUMINANCE_MODE_ONE_TIME);
+	resource_i2c_op_s ops[GY30_OPS_MAX] = { { 0, }, };
+	unsigned int count = 0;
+	double due = 0.0;
+
+	retv_if(!cb, -1);
+	if (resource_sensor_s.pending)
+		return RESOURCE_ILLUMINANCE_BUSY;
+
+	ret = __open_illuminance_sensor(i2c_bus);
+	retv_if(ret != 0, -1);
+
+	/* A running continuous conversion already has a result, or will have one soon */
+	if (!__conversion_running(one_time))
+		count = __conversion_ops(one_time, ops);
+
+	/* Wait for a conversion that finished after the last result handed out */
+	due = (resource_sensor_s.last_read > resource_sensor_s.started) ? resource_sensor_s.last_read : resource_sensor_s.started;
+	due += __range_info(resource_sensor_s.range)->typ_time * GY30_TIME_MAX_RATIO - ecore_time_get();
+	if (due < 0.0)
+		due = 0.0;
 
-	resource_write_led(5, 1);
-	resource_write_led(26, 1);
+	/* The bus serves the other devices while this one converts */
+	ops[count].type = RESOURCE_I2C_OP_DELAY;
+	ops[count].delay = due;
+	count++;
+	ops[count].type = RESOURCE_I2C_OP_READ;
+	ops[count].buf = resource_sensor_s.result;
+	ops[count].len = 2;
+	count++;
 
-	usleep(delay_usec);
+	/* The transaction carries its range, a range set while it is pending only applies to the next one */
+	ret = resource_i2c_bus_submit(resource_sensor_s.device, ops, count, __conversion_done,
+			(void *) (long) resource_sensor_s.range);
+	if (ret != 0) {
+		__forget_conversion();
+		return -1;
+	}
 
-	resource_write_led(5, 0);
-	resource_write_led(26, 0);
+	resource_sensor_s.cb = cb;
+	resource_sensor_s.data = data;
+	resource_sensor_s.pending = 1;
 
 	return 0;
 }
+
+void resource_cancel_illuminance_sensor_async(void)
+{
+	if (resource_sensor_s.pending) {
+		resource_i2c_bus_cancel(resource_sensor_s.device);
+		resource_sensor_s.pending = 0;
+		/* The conversion may not have been started yet */
+		__forget_conversion();
+	}
+
+	resource_sensor_s.cb = NULL;
+	resource_sensor_s.data = NULL;
+}
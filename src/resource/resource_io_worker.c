@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "resource/resource_io_worker.h"
+
+#define IO_QUEUE_SIZE 64 /* Power of two, the indexes wrap around */
+
+typedef struct {
+	resource_io_work_cb work;
+	resource_io_done_cb done;
+	void *data;
+	int result;
+	unsigned long long queued_usec;
+	unsigned long long started_usec;
+	unsigned long long finished_usec;
+} io_request_s;
+
+/*
+ * One ring, three indexes, each written by a single thread:
+ * head by the main loop when it submits, tail by the worker once a request ran,
+ * done by the main loop once it handed the result back.
+ */
+static struct {
+	int running;
+	int stopping;
+	int drain_posted;
+	pthread_t thread;
+	sem_t wakeup;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int done;
+	io_request_s requests[IO_QUEUE_SIZE];
+	resource_io_stats_s stats;
+} g_io;
+
+static unsigned long long __now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void __io_drain(void *data)
+{
+	/* Cleared first, a request finishing from now on posts again */
+	__atomic_store_n(&g_io.drain_posted, 0, __ATOMIC_SEQ_CST);
+
+	/* Completions may stop the worker, which drains as well, so the tail is read every time */
+	while (g_io.done != __atomic_load_n(&g_io.tail, __ATOMIC_SEQ_CST)) {
+		io_request_s *request = &g_io.requests[g_io.done % IO_QUEUE_SIZE];
+		resource_io_done_cb done = request->done;
+		void *done_data = request->data;
+		int result = request->result;
+		unsigned int service = (unsigned int) (request->finished_usec - request->started_usec);
+		unsigned int wait = (unsigned int) (request->started_usec - request->queued_usec);
+
+		/* The slot is free before the completion runs, it may submit again */
+		__atomic_store_n(&g_io.done, g_io.done + 1, __ATOMIC_RELEASE);
+
+		g_io.stats.completed++;
+		g_io.stats.last_service_usec = service;
+		g_io.stats.total_service_usec += service;
+		if (service > g_io.stats.max_service_usec)
+			g_io.stats.max_service_usec = service;
+		if (wait > g_io.stats.max_wait_usec)
+			g_io.stats.max_wait_usec = wait;
+
+		if (done)
+			done(result, done_data);
+	}
+}
+
+static void *__io_worker(void *data)
+{
+	for (;;) {
+		unsigned int head = __atomic_load_n(&g_io.head, __ATOMIC_ACQUIRE);
+		unsigned int tail = g_io.tail;
+
+		if (tail == head) {
+			if (__atomic_load_n(&g_io.stopping, __ATOMIC_ACQUIRE))
+				break;
+			sem_wait(&g_io.wakeup);
+			continue;
+		}
+
+		while (tail != head) {
+			io_request_s *request = &g_io.requests[tail % IO_QUEUE_SIZE];
+
+			request->started_usec = __now_usec();
+			request->result = request->work(request->data);
+			request->finished_usec = __now_usec();
+
+			tail++;
+			__atomic_store_n(&g_io.tail, tail, __ATOMIC_SEQ_CST);
+		}
+
+		/* One wakeup of the main loop for everything finished meanwhile */
+		if (!__atomic_exchange_n(&g_io.drain_posted, 1, __ATOMIC_SEQ_CST))
+			ecore_main_loop_thread_safe_call_async(__io_drain, NULL);
+	}
+
+	return NULL;
+}
+
+int resource_io_worker_start(void)
+{
+	int ret = 0;
+
+	if (g_io.running)
+		return 0;
+
+	retv_if(sem_init(&g_io.wakeup, 0, 0) != 0, -1);
+
+	g_io.stopping = 0;
+	ret = pthread_create(&g_io.thread, NULL, __io_worker, NULL);
+	if (ret != 0) {
+		_E("Failed to create the I/O worker : %d", ret);
+		sem_destroy(&g_io.wakeup);
+		return -1;
+	}
+	g_io.running = 1;
+
+	return 0;
+}
+
+void resource_io_worker_stop(void)
+{
+	ret_if(!g_io.running);
+
+	__atomic_store_n(&g_io.stopping, 1, __ATOMIC_RELEASE);
+	sem_post(&g_io.wakeup);
+	pthread_join(g_io.thread, NULL);
+	sem_destroy(&g_io.wakeup);
+	g_io.running = 0;
+
+	/* The worker ran everything queued before leaving, hand the results back now */
+	__io_drain(NULL);
+
+	_I("I/O worker stopped, %u requests, max depth %u, max service %u usec",
+			g_io.stats.completed, g_io.stats.max_depth, g_io.stats.max_service_usec);
+}
+
+int resource_io_worker_running(void)
+{
+	return g_io.running;
+}
+
+int resource_io_submit(resource_io_work_cb work, resource_io_done_cb done, void *data)
+{
+	io_request_s *request = NULL;
+	unsigned int depth = 0;
+
+	retv_if(!work, -1);
+	if (!g_io.running || g_io.stopping)
+		return -1;
+
+	depth = g_io.head - __atomic_load_n(&g_io.done, __ATOMIC_ACQUIRE);
+	retvm_if(depth >= IO_QUEUE_SIZE, -1, "I/O queue is full");
+
+	request = &g_io.requests[g_io.head % IO_QUEUE_SIZE];
+	request->work = work;
+	request->done = done;
+	request->data = data;
+	request->queued_usec = __now_usec();
+
+	__atomic_store_n(&g_io.head, g_io.head + 1, __ATOMIC_RELEASE);
+	sem_post(&g_io.wakeup);
+
+	g_io.stats.submitted++;
+	if (depth + 1 > g_io.stats.max_depth)
+		g_io.stats.max_depth = depth + 1;
+
+	return 0;
+}
+
+int resource_io_get_stats(resource_io_stats_s *stats)
+{
+	retv_if(!stats, -1);
+
+	*stats = g_io.stats;
+	stats->depth = g_io.head - g_io.done;
+
+	return 0;
+}
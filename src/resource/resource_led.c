@@ -16,37 +16,330 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <peripheral_io.h>
+#include <Ecore.h>
 
 #include "log.h"
 #include "resource_internal.h"
+#include "resource/resource_led.h"
+#include "resource/resource_io_worker.h"
+#include "resource/resource_metrics.h"
+#include "tracing.h"
+
+typedef struct {
+	uint64_t pin_mask; /* Pins to write, their shadow levels are already updated */
+	uint64_t values;
+	uint64_t failed;
+	unsigned int latency_usec;
+	int batch; /* Counted in the batch stats */
+} led_writes_s;
+
+static resource_led_batch_stats_s g_batch_stats = { 0, 0, 0, 0 };
+
+/* Writes that found the I/O queue full, the later ones are merged in until it has room */
+static struct {
+	led_writes_s *writes;
+	Ecore_Idle_Enterer *retry;
+} g_pending = { NULL, NULL };
+
+static int __led_pending_flush(void);
+
+static int __driver_open(int id, int bus)
+{
+	return resource_open_led(id);
+}
+
+const resource_driver_s resource_led_driver = {
+	RESOURCE_TYPE_GPIO_OUT, "LED", __driver_open, NULL, resource_write_led, resource_close_led
+};
 
 void resource_close_led(int pin_num)
 {
+	ret_if(pin_num < 0 || pin_num >= PIN_MAX);
 	if (!resource_get_info(pin_num)->opened) return;
 
+	/* Writes queued on the worker or pending for it still use the handle */
+	retm_if(resource_io_worker_running(), "LED[%d] cannot close while the I/O worker runs", pin_num);
+
+	/* Without the worker the writes still pending run here */
+	if (g_pending.writes && (g_pending.writes->pin_mask & (1ULL << pin_num)))
+		__led_pending_flush();
+
 	_I("LED is finishing...");
 	peripheral_gpio_close(resource_get_info(pin_num)->sensor_h);
-	resource_get_info(pin_num)->opened = 0;
+	resource_get_info(pin_num)->sensor_h = NULL;
+	resource_set_closed(pin_num);
+}
+
+static int __open_led(int pin_num)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	peripheral_gpio_h temp = NULL;
+	resource_s *info = resource_get_info(pin_num);
+	unsigned long long start = 0;
+
+	if (info->opened) {
+		retvm_if(info->driver != &resource_led_driver, -1, "GPIO[%d] is not a LED", pin_num);
+		return 0;
+	}
+
+	start = resource_metrics_now();
+	TRACE_BEGIN("gpio_open");
+	ret = peripheral_gpio_open(pin_num, &temp);
+	TRACE_END();
+	if (ret || !temp) {
+		resource_metrics_record(pin_num, RESOURCE_METRICS_OPEN, start, 1);
+		_E("peripheral_gpio_open failed.");
+		return -1;
+	}
+
+	TRACE_BEGIN("gpio_set_direction");
+	ret = peripheral_gpio_set_direction(temp, PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_LOW);
+	TRACE_END();
+	resource_metrics_record(pin_num, RESOURCE_METRICS_OPEN, start, ret != 0);
+	if (ret) {
+		peripheral_gpio_close(temp);
+		_E("peripheral_gpio_set_direction failed.");
+		return -1;
+	}
+
+	info->sensor_h = temp;
+	resource_set_opened(pin_num, &resource_led_driver);
+	info->value = 0;
+
+	return 0;
+}
+
+int resource_open_led(int pin_num)
+{
+	retvm_if(pin_num < 0 || pin_num >= PIN_MAX, -1, "Invalid pin number : %d", pin_num);
+
+	return __open_led(pin_num);
+}
+
+/* peripheral-io has no multi-pin gpio call, the writes are a tight loop of single writes */
+static int __led_writes_work(void *data)
+{
+	led_writes_s *writes = data;
+	unsigned long long start = resource_metrics_now();
+	unsigned long long write_start = 0;
+	uint64_t pending = 0;
+	int pin_num = 0;
+	int ret = 0;
+
+	for (pending = writes->pin_mask; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		write_start = resource_metrics_now();
+		TRACE_BEGIN("gpio_write");
+		ret = peripheral_gpio_write(resource_get_info(pin_num)->sensor_h, !!(writes->values & (1ULL << pin_num)));
+		TRACE_END();
+		resource_metrics_record(pin_num, RESOURCE_METRICS_WRITE, write_start, ret < 0);
+		if (ret < 0)
+			writes->failed |= 1ULL << pin_num;
+	}
+	writes->latency_usec = (unsigned int) (resource_metrics_now() - start);
+
+	return writes->failed ? -1 : 0;
+}
+
+static void __led_writes_done(int result, void *data)
+{
+	led_writes_s *writes = data;
+	uint64_t pending = 0;
+	int pin_num = 0;
+
+	/* The pins may have changed or not, make the next writes go through */
+	for (pending = writes->failed; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		resource_get_info(pin_num)->value = -1;
+		_E("GPIO[%d] write failed.", pin_num);
+	}
+
+	if (writes->batch) {
+		g_batch_stats.batches++;
+		g_batch_stats.last_latency_usec = writes->latency_usec;
+		g_batch_stats.total_latency_usec += writes->latency_usec;
+		if (writes->latency_usec > g_batch_stats.max_latency_usec)
+			g_batch_stats.max_latency_usec = writes->latency_usec;
+	}
+
+	free(writes);
+}
+
+/* Hands the pending writes to the worker, or does them here once there is none */
+static int __led_pending_flush(void)
+{
+	led_writes_s *writes = g_pending.writes;
+
+	if (!writes)
+		return 0;
+
+	if (resource_io_worker_running()) {
+		if (resource_io_submit(__led_writes_work, __led_writes_done, writes))
+			return -1;
+	} else {
+		__led_writes_done(__led_writes_work(writes), writes);
+	}
+
+	g_pending.writes = NULL;
+	if (g_pending.retry) {
+		ecore_idle_enterer_del(g_pending.retry);
+		g_pending.retry = NULL;
+	}
+
+	return 0;
+}
+
+/* Runs after the completions that freed the queue slots were handed back */
+static Eina_Bool __led_pending_retry(void *data)
+{
+	Ecore_Idle_Enterer *retry = g_pending.retry;
+
+	g_pending.retry = NULL;
+	if (__led_pending_flush()) {
+		g_pending.retry = retry;
+		return ECORE_CALLBACK_RENEW;
+	}
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+/*
+ * Updates the shadows and hands the writes to the I/O worker, or does them here without one.
+ * The gpio handles belong to the worker while it runs, so a full queue never makes the writes
+ * run here: they wait, merged with any later ones, and keep their order behind the queue.
+ */
+static int __led_writes_submit(uint64_t pin_mask, uint64_t values, int batch)
+{
+	led_writes_s *writes = NULL;
+	uint64_t pending = 0;
+	int pin_num = 0;
+	int ret = 0;
+
+	for (pending = pin_mask; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		resource_get_info(pin_num)->value = !!(values & (1ULL << pin_num));
+		resource_get_info(pin_num)->writes_issued++;
+	}
+
+	if (g_pending.writes) {
+		writes = g_pending.writes;
+		writes->values = (writes->values & ~pin_mask) | (values & pin_mask);
+		writes->pin_mask |= pin_mask;
+		writes->batch |= batch;
+		return 0;
+	}
+
+	writes = calloc(1, sizeof(led_writes_s));
+	retv_if(!writes, -1);
+
+	writes->pin_mask = pin_mask;
+	writes->values = values;
+	writes->batch = batch;
+
+	if (!resource_io_worker_running()) {
+		ret = __led_writes_work(writes);
+		__led_writes_done(ret, writes);
+		return ret;
+	}
+
+	if (resource_io_submit(__led_writes_work, __led_writes_done, writes) == 0)
+		return 0;
+
+	g_pending.writes = writes;
+	g_pending.retry = ecore_idle_enterer_add(__led_pending_retry, NULL);
+	if (!g_pending.retry)
+		_E("Failed to add the LED retry, the writes wait for the next one");
+
+	return 0;
+}
+
+static int __write_led(int pin_num, int write_value, int force)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	resource_s *info = NULL;
+
+	retvm_if(pin_num < 0 || pin_num >= PIN_MAX, -1, "Invalid pin number : %d", pin_num);
+	info = resource_get_info(pin_num);
+	write_value = !!write_value;
+
+	ret = __open_led(pin_num);
+	retv_if(ret != 0, -1);
+
+	if (!force && info->value == write_value) {
+		info->writes_saved++;
+		return 0;
+	}
+
+	ret = __led_writes_submit(1ULL << pin_num, (uint64_t) write_value << pin_num, 0);
+	retv_if(ret != 0, -1);
+
+	_D("LED Value : %s", write_value ? "ON":"OFF");
+	return 0;
 }
 
 int resource_write_led(int pin_num, int write_value)
 {
+	return __write_led(pin_num, write_value, 0);
+}
+
+int resource_write_led_force(int pin_num, int write_value)
+{
+	return __write_led(pin_num, write_value, 1);
+}
+
+int resource_get_led_write_stats(int pin_num, unsigned int *issued, unsigned int *saved)
+{
+	resource_s *info = NULL;
+
+	retv_if(pin_num < 0 || pin_num >= PIN_MAX, -1);
+	info = resource_get_info(pin_num);
+
+	if (issued)
+		*issued = info->writes_issued;
+	if (saved)
+		*saved = info->writes_saved;
+
+	return 0;
+}
+
+int resource_write_leds(uint64_t pin_mask, uint64_t values)
+{
+	uint64_t pending = 0;
+	uint64_t changed = 0;
+	resource_s *info = NULL;
+	int pin_num = 0;
 	int ret = PERIPHERAL_ERROR_NONE;
 
-	if (!resource_get_info(pin_num)->opened) {
-		ret = peripheral_gpio_open(pin_num, &resource_get_info(pin_num)->sensor_h);
-		retv_if(!resource_get_info(pin_num)->sensor_h, -1);
+	retvm_if(pin_mask >> PIN_MAX, -1, "Invalid pin mask : 0x%llx", (unsigned long long) pin_mask);
 
-		ret = peripheral_gpio_set_direction(resource_get_info(pin_num)->sensor_h, PERIPHERAL_GPIO_DIRECTION_OUT_INITIALLY_LOW);
+	/* Opens and shadow checks happen up front, so only the writes sit inside the batch */
+	for (pending = pin_mask; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		ret = __open_led(pin_num);
 		retv_if(ret != 0, -1);
 
-		resource_get_info(pin_num)->opened = 1;
-		resource_get_info(pin_num)->close = resource_close_led;
+		info = resource_get_info(pin_num);
+		if (info->value == !!(values & (1ULL << pin_num)))
+			info->writes_saved++;
+		else
+			changed |= 1ULL << pin_num;
 	}
 
-	ret = peripheral_gpio_write(resource_get_info(pin_num)->sensor_h, write_value);
-	retv_if(ret < 0, -1);
+	if (!changed)
+		return 0;
+
+	ret = __led_writes_submit(changed, values & changed, 1);
+	retv_if(ret != 0, -1);
+
+	_D("LED batch 0x%llx -> 0x%llx", (unsigned long long) changed, (unsigned long long) (values & changed));
+	return 0;
+}
+
+int resource_get_led_batch_stats(resource_led_batch_stats_s *stats)
+{
+	retv_if(!stats, -1);
+
+	*stats = g_batch_stats;
 
-	_D("LED Value : %s", write_value ? "ON":"OFF");
 	return 0;
 }
@@ -0,0 +1,309 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "resource/resource_metrics.h"
+#include "resource/resource_led.h"
+#include "resource/resource_io_worker.h"
+
+/* Written by the main loop and the I/O worker, every field is updated with a relaxed atomic add */
+static resource_metrics_s g_metrics[RESOURCE_METRICS_MAX];
+
+static struct {
+	char *path;
+	Ecore_Timer *timer;
+} g_dump = { NULL, NULL };
+
+/* Only touched from the main loop, like the dumps */
+static struct {
+	const char *name;
+	resource_metrics_gauge_cb cb;
+	void *data;
+} g_gauges[RESOURCE_METRICS_GAUGES_MAX];
+
+static const char *g_op_names[RESOURCE_METRICS_OP_MAX] = { "open", "read", "write" };
+
+unsigned long long resource_metrics_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static inline unsigned int __bucket(unsigned long long usec)
+{
+	unsigned int bucket = 0;
+
+	if (usec >= 1ULL << (RESOURCE_METRICS_BUCKETS - 1))
+		return RESOURCE_METRICS_BUCKETS - 1;
+
+	if (usec)
+		bucket = 32 - __builtin_clz((unsigned int) usec);
+
+	return bucket;
+}
+
+void resource_metrics_record(int id, resource_metrics_op_e op, unsigned long long start, int failed)
+{
+	resource_metrics_s *metrics = NULL;
+	unsigned long long usec = resource_metrics_now() - start;
+
+	if (id < 0 || id >= RESOURCE_METRICS_MAX || op >= RESOURCE_METRICS_OP_MAX)
+		return;
+	metrics = &g_metrics[id];
+
+	switch (op) {
+	case RESOURCE_METRICS_OPEN:
+		if (__atomic_fetch_add(&metrics->opens, 1, __ATOMIC_RELAXED))
+			__atomic_fetch_add(&metrics->reopens, 1, __ATOMIC_RELAXED);
+		break;
+	case RESOURCE_METRICS_READ:
+		__atomic_fetch_add(&metrics->reads, 1, __ATOMIC_RELAXED);
+		break;
+	case RESOURCE_METRICS_WRITE:
+		__atomic_fetch_add(&metrics->writes, 1, __ATOMIC_RELAXED);
+		break;
+	default:
+		break;
+	}
+
+	if (failed)
+		__atomic_fetch_add(&metrics->errors, 1, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&metrics->total_usec[op], usec, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&metrics->latency[op][__bucket(usec)], 1, __ATOMIC_RELAXED);
+}
+
+int resource_get_metrics(int id, resource_metrics_s *metrics)
+{
+	const resource_metrics_s *src = NULL;
+	int op = 0;
+	int i = 0;
+
+	retvm_if(id < 0 || id >= RESOURCE_METRICS_MAX, -1, "Invalid resource : %d", id);
+	retv_if(!metrics, -1);
+	src = &g_metrics[id];
+
+	metrics->opens = __atomic_load_n(&src->opens, __ATOMIC_RELAXED);
+	metrics->reopens = __atomic_load_n(&src->reopens, __ATOMIC_RELAXED);
+	metrics->reads = __atomic_load_n(&src->reads, __ATOMIC_RELAXED);
+	metrics->writes = __atomic_load_n(&src->writes, __ATOMIC_RELAXED);
+	metrics->errors = __atomic_load_n(&src->errors, __ATOMIC_RELAXED);
+
+	for (op = 0; op < RESOURCE_METRICS_OP_MAX; op++) {
+		metrics->total_usec[op] = __atomic_load_n(&src->total_usec[op], __ATOMIC_RELAXED);
+		for (i = 0; i < RESOURCE_METRICS_BUCKETS; i++)
+			metrics->latency[op][i] = __atomic_load_n(&src->latency[op][i], __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+int resource_metrics_add_gauge(const char *name, resource_metrics_gauge_cb cb, void *data)
+{
+	int free_slot = -1;
+	int i = 0;
+
+	retv_if(!name, -1);
+	retv_if(!cb, -1);
+
+	for (i = 0; i < RESOURCE_METRICS_GAUGES_MAX; i++) {
+		if (g_gauges[i].name && !strcmp(g_gauges[i].name, name))
+			break;
+		if (!g_gauges[i].name && free_slot < 0)
+			free_slot = i;
+	}
+
+	if (i == RESOURCE_METRICS_GAUGES_MAX)
+		i = free_slot;
+	retvm_if(i < 0, -1, "No room for gauge %s", name);
+
+	g_gauges[i].name = name;
+	g_gauges[i].cb = cb;
+	g_gauges[i].data = data;
+
+	return 0;
+}
+
+void resource_metrics_remove_gauge(const char *name)
+{
+	int i = 0;
+
+	ret_if(!name);
+
+	for (i = 0; i < RESOURCE_METRICS_GAUGES_MAX; i++) {
+		if (g_gauges[i].name && !strcmp(g_gauges[i].name, name)) {
+			memset(&g_gauges[i], 0, sizeof(g_gauges[i]));
+			return;
+		}
+	}
+}
+
+static void __dump_gauges(FILE *fp)
+{
+	double value = 0.0;
+	int count = 0;
+	int i = 0;
+
+	for (i = 0; i < RESOURCE_METRICS_GAUGES_MAX; i++) {
+		if (!g_gauges[i].name)
+			continue;
+
+		value = g_gauges[i].cb(g_gauges[i].data);
+		if (value < 0.0)
+			continue;
+
+		fputs(count ? ", " : ",\n  \"gauges\": { ", fp);
+		fprintf(fp, "\"%s\": %g", g_gauges[i].name, value);
+		count++;
+	}
+
+	if (count)
+		fprintf(fp, " }");
+}
+
+static void __dump_resource(FILE *fp, int id, const resource_metrics_s *metrics)
+{
+	const resource_driver_s *driver = resource_get_info(id)->driver;
+	unsigned int issued = 0;
+	unsigned int saved = 0;
+	int op = 0;
+	int i = 0;
+
+	/* A resource closed since keeps its counts, but no longer knows its driver */
+	fprintf(fp, "    { \"resource\": \"%s\", \"id\": %d", driver ? driver->name : "Closed", id);
+
+	fprintf(fp, ", \"opens\": %u, \"reopens\": %u, \"reads\": %u, \"writes\": %u, \"errors\": %u",
+			metrics->opens, metrics->reopens, metrics->reads, metrics->writes, metrics->errors);
+
+	/* The writes the LED shadow levels saved never reach the gpio, and so are not in the counts above */
+	if (id < PIN_MAX && !resource_get_led_write_stats(id, &issued, &saved) && (issued || saved))
+		fprintf(fp, ", \"writes_issued\": %u, \"writes_saved\": %u", issued, saved);
+
+	for (op = 0; op < RESOURCE_METRICS_OP_MAX; op++) {
+		fprintf(fp, ",\n      \"%s_usec\": { \"total\": %llu, \"buckets\": [", g_op_names[op], metrics->total_usec[op]);
+		for (i = 0; i < RESOURCE_METRICS_BUCKETS; i++)
+			fprintf(fp, "%s%u", i ? ", " : "", metrics->latency[op][i]);
+		fprintf(fp, "] }");
+	}
+
+	fprintf(fp, " }");
+}
+
+int resource_metrics_dump(const char *path)
+{
+	resource_metrics_s metrics;
+	resource_io_stats_s io;
+	resource_led_batch_stats_s batch;
+	char *tmp_path = NULL;
+	FILE *fp = NULL;
+	const char *sep = "";
+	int id = 0;
+	int ret = 0;
+
+	retv_if(!path, -1);
+
+	/* Readers never see a half written file */
+	tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+	retv_if(!tmp_path, -1);
+	sprintf(tmp_path, "%s.tmp", path);
+	fp = fopen(tmp_path, "w");
+	if (!fp) {
+		_E("Cannot write %s", tmp_path);
+		free(tmp_path);
+		return -1;
+	}
+
+	fprintf(fp, "{\n  \"timestamp\": %lld,\n  \"resources\": [\n", (long long) time(NULL));
+	for (id = 0; id < RESOURCE_METRICS_MAX; id++) {
+		resource_get_metrics(id, &metrics);
+		if (!metrics.opens)
+			continue;
+
+		fputs(sep, fp);
+		__dump_resource(fp, id, &metrics);
+		sep = ",\n";
+	}
+	fprintf(fp, "\n  ]");
+
+	if (!resource_io_get_stats(&io))
+		fprintf(fp, ",\n  \"io_worker\": { \"submitted\": %u, \"completed\": %u, \"depth\": %u, \"max_depth\": %u, "
+				"\"max_service_usec\": %u, \"total_service_usec\": %llu, \"max_wait_usec\": %u }",
+				io.submitted, io.completed, io.depth, io.max_depth,
+				io.max_service_usec, io.total_service_usec, io.max_wait_usec);
+
+	if (!resource_get_led_batch_stats(&batch))
+		fprintf(fp, ",\n  \"led_batches\": { \"batches\": %u, \"max_latency_usec\": %u, \"total_latency_usec\": %llu }",
+				batch.batches, batch.max_latency_usec, batch.total_latency_usec);
+
+	__dump_gauges(fp);
+
+	fprintf(fp, "\n}\n");
+
+	if (fclose(fp) || rename(tmp_path, path)) {
+		_E("Cannot replace %s", path);
+		ret = -1;
+	}
+	free(tmp_path);
+
+	return ret;
+}
+
+static Eina_Bool __dump_tick(void *data)
+{
+	resource_metrics_dump(g_dump.path);
+
+	return ECORE_CALLBACK_RENEW;
+}
+
+int resource_metrics_dump_start(const char *path, double interval)
+{
+	retv_if(!path, -1);
+	retvm_if(interval <= 0.0, -1, "Invalid interval : %f", interval);
+
+	resource_metrics_dump_stop();
+
+	g_dump.path = strdup(path);
+	retv_if(!g_dump.path, -1);
+
+	g_dump.timer = ecore_timer_add(interval, __dump_tick, NULL);
+	if (!g_dump.timer) {
+		free(g_dump.path);
+		g_dump.path = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void resource_metrics_dump_stop(void)
+{
+	if (!g_dump.timer)
+		return;
+
+	ecore_timer_del(g_dump.timer);
+	g_dump.timer = NULL;
+
+	resource_metrics_dump(g_dump.path);
+	free(g_dump.path);
+	g_dump.path = NULL;
+}
@@ -0,0 +1,130 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "resource.h"
+#include "resource/resource_prewarm.h"
+
+typedef struct {
+	resource_prewarm_s *items;
+	unsigned int count;
+} prewarm_batch_s;
+
+static inline int __is_pin(const resource_prewarm_s *item)
+{
+	return item->driver->type == RESOURCE_TYPE_GPIO_IN || item->driver->type == RESOURCE_TYPE_GPIO_OUT;
+}
+
+static void __prewarm_open(resource_prewarm_s *item)
+{
+	unsigned long long start = resource_metrics_now();
+
+	if (item->driver->open) {
+		item->result = item->driver->open(item->id, item->bus);
+	} else {
+		_E("%s[%d] cannot be opened without its own parameters", item->driver->name, item->id);
+		item->result = -1;
+	}
+
+	item->open_usec = (unsigned int) (resource_metrics_now() - start);
+}
+
+/* Each pin is its own handle, the backend opens them side by side */
+static void *__prewarm_pin_thread(void *data)
+{
+	__prewarm_open(data);
+
+	return NULL;
+}
+
+/* The i2c bus manager keeps one device list, its devices are opened one after the other */
+static void *__prewarm_bus_thread(void *data)
+{
+	prewarm_batch_s *batch = data;
+	unsigned int i = 0;
+
+	for (i = 0; i < batch->count; i++) {
+		if (!__is_pin(&batch->items[i]))
+			__prewarm_open(&batch->items[i]);
+	}
+
+	return NULL;
+}
+
+int resource_prewarm(resource_prewarm_s *items, unsigned int count)
+{
+	prewarm_batch_s batch = { items, count };
+	pthread_t *threads = NULL;
+	char *started = NULL;
+	unsigned long long start = 0;
+	unsigned int i = 0;
+	int failed = 0;
+
+	retv_if(!items, -1);
+	if (!count)
+		return 0;
+
+	for (i = 0; i < count; i++)
+		retvm_if(!items[i].driver, -1, "Resource %d has no driver", items[i].id);
+
+	/* The last slot runs the bus devices */
+	threads = calloc(count + 1, sizeof(pthread_t));
+	started = calloc(count + 1, sizeof(char));
+	if (!threads || !started) {
+		free(threads);
+		free(started);
+		return -1;
+	}
+
+	start = resource_metrics_now();
+
+	for (i = 0; i < count; i++) {
+		if (!__is_pin(&items[i]))
+			continue;
+		if (pthread_create(&threads[i], NULL, __prewarm_pin_thread, &items[i]) == 0)
+			started[i] = 1;
+		else
+			__prewarm_open(&items[i]);
+	}
+
+	if (pthread_create(&threads[count], NULL, __prewarm_bus_thread, &batch) == 0)
+		started[count] = 1;
+	else
+		__prewarm_bus_thread(&batch);
+
+	for (i = 0; i <= count; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (items[i].result) {
+			_E("Resource %d failed to open after %u usec", items[i].id, items[i].open_usec);
+			failed++;
+		} else {
+			_I("%s[%d] opened in %u usec", items[i].driver->name, items[i].id, items[i].open_usec);
+		}
+	}
+
+	_I("Prewarmed %u resources in %llu usec, %d failed", count, resource_metrics_now() - start, failed);
+
+	free(threads);
+	free(started);
+
+	return failed;
+}
@@ -0,0 +1,170 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <peripheral_io.h>
+
+#include "log.h"
+#include "resource_internal.h"
+#include "resource/resource_pwm_led.h"
+#include "resource/resource_io_worker.h"
+#include "resource/resource_metrics.h"
+#include "tracing.h"
+
+typedef struct {
+	peripheral_pwm_h pwm;
+	uint32_t duty_ns;
+} pwm_write_s;
+
+static struct {
+	peripheral_pwm_h pwm;
+	unsigned int period_ns;
+	unsigned int duty; /* Last duty cycle submitted */
+	int duty_known; /* Cleared when a write fails, the next one goes through */
+} g_pwm_led;
+
+static int __driver_write(int id, int value)
+{
+	retvm_if(value < 0, -1, "Invalid duty cycle : %d", value);
+
+	return resource_write_pwm_led((unsigned int) value);
+}
+
+static void __driver_close(int id)
+{
+	resource_close_pwm_led();
+}
+
+/* Opened with its chip, channel and period, through resource_open_pwm_led() only */
+const resource_driver_s resource_pwm_led_driver = {
+	RESOURCE_TYPE_PWM, "PWM LED", NULL, NULL, __driver_write, __driver_close
+};
+
+void resource_close_pwm_led(void)
+{
+	if (!resource_get_info(RESOURCE_ID_PWM_LED)->opened) return;
+
+	_I("PWM LED is finishing...");
+	peripheral_pwm_set_enabled(g_pwm_led.pwm, false);
+	peripheral_pwm_close(g_pwm_led.pwm);
+	g_pwm_led.pwm = NULL;
+	resource_set_closed(RESOURCE_ID_PWM_LED);
+}
+
+/* The period has to be set before the duty cycle, which cannot exceed it */
+static int __configure(peripheral_pwm_h pwm, unsigned int period_ns)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	ret = peripheral_pwm_set_period(pwm, period_ns);
+	retvm_if(ret != PERIPHERAL_ERROR_NONE, -1, "Cannot set the PWM period : %d", ret);
+
+	ret = peripheral_pwm_set_duty_cycle(pwm, 0);
+	retvm_if(ret != PERIPHERAL_ERROR_NONE, -1, "Cannot set the PWM duty cycle : %d", ret);
+
+	ret = peripheral_pwm_set_polarity(pwm, PERIPHERAL_PWM_POLARITY_ACTIVE_HIGH);
+	retvm_if(ret != PERIPHERAL_ERROR_NONE, -1, "Cannot set the PWM polarity : %d", ret);
+
+	ret = peripheral_pwm_set_enabled(pwm, true);
+	retvm_if(ret != PERIPHERAL_ERROR_NONE, -1, "Cannot enable the PWM : %d", ret);
+
+	return 0;
+}
+
+int resource_open_pwm_led(int chip, int channel, unsigned int period_ns)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	peripheral_pwm_h pwm = NULL;
+	unsigned long long start = 0;
+
+	if (resource_get_info(RESOURCE_ID_PWM_LED)->opened)
+		return 0;
+
+	retvm_if(chip < 0 || channel < 0, -1, "Invalid PWM : %d.%d", chip, channel);
+	retvm_if(!period_ns, -1, "Invalid PWM period");
+
+	start = resource_metrics_now();
+	TRACE_BEGIN("pwm_open");
+	ret = peripheral_pwm_open(chip, channel, &pwm);
+	if (ret == PERIPHERAL_ERROR_NONE && __configure(pwm, period_ns)) {
+		peripheral_pwm_close(pwm);
+		ret = PERIPHERAL_ERROR_IO_ERROR;
+	}
+	TRACE_END();
+	resource_metrics_record(RESOURCE_ID_PWM_LED, RESOURCE_METRICS_OPEN, start, ret != PERIPHERAL_ERROR_NONE);
+	retvm_if(ret != PERIPHERAL_ERROR_NONE, -1, "Cannot open PWM %d.%d : %d", chip, channel, ret);
+
+	g_pwm_led.pwm = pwm;
+	g_pwm_led.period_ns = period_ns;
+	g_pwm_led.duty = 0;
+	g_pwm_led.duty_known = 1;
+	resource_set_opened(RESOURCE_ID_PWM_LED, &resource_pwm_led_driver);
+
+	return 0;
+}
+
+static int __pwm_write_work(void *data)
+{
+	pwm_write_s *write = data;
+	unsigned long long start = resource_metrics_now();
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	TRACE_BEGIN("pwm_write");
+	ret = peripheral_pwm_set_duty_cycle(write->pwm, write->duty_ns);
+	TRACE_END();
+	resource_metrics_record(RESOURCE_ID_PWM_LED, RESOURCE_METRICS_WRITE, start, ret != PERIPHERAL_ERROR_NONE);
+
+	return ret == PERIPHERAL_ERROR_NONE ? 0 : -1;
+}
+
+static void __pwm_write_done(int result, void *data)
+{
+	if (result) {
+		g_pwm_led.duty_known = 0;
+		_E("PWM LED write failed");
+	}
+
+	free(data);
+}
+
+int resource_write_pwm_led(unsigned int duty)
+{
+	pwm_write_s *write = NULL;
+	int ret = 0;
+
+	retvm_if(!resource_get_info(RESOURCE_ID_PWM_LED)->opened, -1, "PWM LED is not open");
+	retvm_if(duty > RESOURCE_PWM_DUTY_MAX, -1, "Invalid duty cycle : %u", duty);
+
+	if (g_pwm_led.duty_known && g_pwm_led.duty == duty)
+		return 0;
+
+	write = calloc(1, sizeof(pwm_write_s));
+	retv_if(!write, -1);
+
+	/* A 32 by 32 bit multiply, no division on the soft-float build */
+	write->pwm = g_pwm_led.pwm;
+	write->duty_ns = (uint32_t) (((uint64_t) g_pwm_led.period_ns * duty) >> 16);
+	g_pwm_led.duty = duty;
+	g_pwm_led.duty_known = 1;
+
+	if (resource_io_submit(__pwm_write_work, __pwm_write_done, write) == 0)
+		return 0;
+
+	ret = __pwm_write_work(write);
+	__pwm_write_done(ret, write);
+
+	return ret;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2019 G.camp,
+ *
+ * Contact: Jin Seog Bang <seog814@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <Ecore.h>
+
+#include "log.h"
+#include "resource_internal.h"
+#include "resource/resource_sw_gesture.h"
+#include "tracing.h"
+
+#define DEFAULT_SETTLE_MS 20
+#define DEFAULT_LONG_PRESS_MS 1000
+#define DEFAULT_DOUBLE_CLICK_MS 300
+
+typedef struct {
+	int pin_num;
+	resource_sw_gesture_config_s config;
+	resource_sw_event_cb cb;
+	void *data;
+
+	uint32_t raw_level;
+	double edge_time; /* First edge of the bounces being settled */
+	int pressed;
+	double press_time;
+	double release_time;
+	int click_pending;
+
+	Ecore_Timer *settle_timer;
+	Ecore_Timer *long_press_timer;
+} sw_gesture_s;
+
+static sw_gesture_s *g_gesture[PIN_MAX] = { NULL, };
+
+static void __sw_gesture_emit(sw_gesture_s *gesture, resource_sw_event_e type, double timestamp, double duration)
+{
+	resource_sw_event_s event = { type, gesture->pin_num, timestamp, duration };
+
+	if (gesture->cb)
+		gesture->cb(&event, gesture->data);
+}
+
+static Eina_Bool __sw_gesture_long_press(void *data)
+{
+	sw_gesture_s *gesture = data;
+
+	TRACE_BEGIN("sw_long_press");
+	gesture->long_press_timer = NULL;
+	/* A long press never completes a double click */
+	gesture->click_pending = 0;
+
+	__sw_gesture_emit(gesture, RESOURCE_SW_EVENT_LONG_PRESS, gesture->press_time,
+			gesture->config.long_press_ms / 1000.0);
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void __sw_gesture_settled(sw_gesture_s *gesture)
+{
+	int pressed = (gesture->raw_level == gesture->config.active_level);
+	double now = gesture->edge_time;
+
+	if (pressed == gesture->pressed)
+		return;
+
+	gesture->pressed = pressed;
+
+	if (pressed) {
+		gesture->press_time = now;
+		__sw_gesture_emit(gesture, RESOURCE_SW_EVENT_PRESS, now, 0.0);
+
+		if (gesture->click_pending
+				&& (now - gesture->release_time) * 1000.0 <= gesture->config.double_click_ms) {
+			gesture->click_pending = 0;
+			__sw_gesture_emit(gesture, RESOURCE_SW_EVENT_DOUBLE_CLICK, now, 0.0);
+		} else {
+			gesture->click_pending = (gesture->config.double_click_ms > 0);
+		}
+
+		if (gesture->config.long_press_ms) {
+			if (gesture->long_press_timer)
+				ecore_timer_del(gesture->long_press_timer);
+			gesture->long_press_timer = ecore_timer_add(gesture->config.long_press_ms / 1000.0,
+					__sw_gesture_long_press, gesture);
+		}
+	} else {
+		if (gesture->long_press_timer) {
+			ecore_timer_del(gesture->long_press_timer);
+			gesture->long_press_timer = NULL;
+		}
+		gesture->release_time = now;
+		__sw_gesture_emit(gesture, RESOURCE_SW_EVENT_RELEASE, now, now - gesture->press_time);
+	}
+}
+
+static Eina_Bool __sw_gesture_settle_timeout(void *data)
+{
+	sw_gesture_s *gesture = data;
+
+	TRACE_BEGIN("sw_settle");
+	gesture->settle_timer = NULL;
+	__sw_gesture_settled(gesture);
+	TRACE_END();
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+int resource_sw_gesture_start(int pin_num, const resource_sw_gesture_config_s *config, resource_sw_event_cb cb, void *data)
+{
+	sw_gesture_s *gesture = NULL;
+
+	retvm_if(pin_num < 0 || pin_num >= PIN_MAX, -1, "Invalid pin number : %d", pin_num);
+	retv_if(!cb, -1);
+
+	resource_sw_gesture_stop(pin_num);
+
+	gesture = calloc(1, sizeof(sw_gesture_s));
+	retv_if(!gesture, -1);
+
+	if (config) {
+		gesture->config = *config;
+	} else {
+		gesture->config.settle_ms = DEFAULT_SETTLE_MS;
+		gesture->config.long_press_ms = DEFAULT_LONG_PRESS_MS;
+		gesture->config.double_click_ms = DEFAULT_DOUBLE_CLICK_MS;
+		gesture->config.active_level = 1;
+	}
+
+	gesture->config.active_level = !!gesture->config.active_level;
+	gesture->pin_num = pin_num;
+	gesture->cb = cb;
+	gesture->data = data;
+	gesture->raw_level = !gesture->config.active_level;
+
+	g_gesture[pin_num] = gesture;
+
+	return 0;
+}
+
+int resource_sw_gesture_feed(int pin_num, uint32_t level)
+{
+	sw_gesture_s *gesture = NULL;
+
+	retv_if(pin_num < 0 || pin_num >= PIN_MAX, -1);
+	gesture = g_gesture[pin_num];
+	retv_if(!gesture, -1);
+
+	level = !!level;
+	if (level == gesture->raw_level)
+		return 0;
+
+	gesture->raw_level = level;
+
+	/* The bounces that follow only push the settle deadline out, the event keeps the first edge */
+	if (gesture->settle_timer) {
+		ecore_timer_del(gesture->settle_timer);
+		gesture->settle_timer = NULL;
+	} else {
+		gesture->edge_time = ecore_time_get();
+	}
+
+	if (!gesture->config.settle_ms) {
+		__sw_gesture_settled(gesture);
+		return 0;
+	}
+
+	gesture->settle_timer = ecore_timer_add(gesture->config.settle_ms / 1000.0,
+			__sw_gesture_settle_timeout, gesture);
+	retv_if(!gesture->settle_timer, -1);
+
+	return 0;
+}
+
+void resource_sw_gesture_stop(int pin_num)
+{
+	sw_gesture_s *gesture = NULL;
+
+	ret_if(pin_num < 0 || pin_num >= PIN_MAX);
+	gesture = g_gesture[pin_num];
+	if (!gesture) return;
+
+	if (gesture->settle_timer)
+		ecore_timer_del(gesture->settle_timer);
+	if (gesture->long_press_timer)
+		ecore_timer_del(gesture->long_press_timer);
+
+	g_gesture[pin_num] = NULL;
+	free(gesture);
+}
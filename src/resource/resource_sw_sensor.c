@@ -19,53 +19,342 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
 #include <peripheral_io.h>
+#include <Ecore.h>
 
 #include "log.h"
+#include "resource_internal.h"
+#include "resource/resource_sw_sensor.h"
+#include "resource/resource_sw_gesture.h"
+#include "resource/resource_io_worker.h"
+#include "resource/resource_metrics.h"
+#include "tracing.h"
 
-static peripheral_gpio_h g_sensor_h = NULL;
-static int g_pin_num = -1;
+typedef struct {
+	int pin_num;
+	peripheral_gpio_h gpio;
+	uint32_t value;
+} sw_level_read_s;
 
-void resource_close_sw_sensor(void)
+/* Switches whose level still has to be read for their callback, the I/O queue was full */
+static struct {
+	uint64_t pin_mask;
+	Ecore_Idle_Enterer *retry;
+} g_pending = { 0, NULL };
+
+static int __driver_open(int id, int bus)
+{
+	return resource_open_sw_sensor(id);
+}
+
+const resource_driver_s resource_sw_sensor_driver = {
+	RESOURCE_TYPE_GPIO_IN, "Switch", __driver_open, resource_read_sw_sensor, NULL, resource_close_sw_sensor
+};
+
+void resource_close_sw_sensor(int pin_num)
 {
-	if (!g_sensor_h) return;
+	resource_s *info = NULL;
+
+	ret_if(pin_num < 0 || pin_num >= PIN_MAX);
+	info = resource_get_info(pin_num);
+	if (!info->opened) return;
+
+	/* Level reads queued on the worker still use the handle */
+	retm_if(resource_io_worker_running(), "Switch[%d] cannot close while the I/O worker runs", pin_num);
+
+	_I("Switch[%d] is finishing...", pin_num);
 
-	_I("Infrared Motion Sensor is finishing...");
+	/* Its timers would keep reporting a switch nobody reads any more */
+	resource_sw_gesture_stop(pin_num);
+	g_pending.pin_mask &= ~(1ULL << pin_num);
 
-	peripheral_gpio_close(g_sensor_h);
+	if (info->resource_read_info) {
+		peripheral_gpio_unset_interrupted_cb(info->sensor_h);
+		free(info->resource_read_info);
+		info->resource_read_info = NULL;
+	}
+
+	peripheral_gpio_close(info->sensor_h);
+
+	info->sensor_h = NULL;
+	resource_set_closed(pin_num);
+}
+
+static int __open_sw_sensor(int pin_num)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	peripheral_gpio_h temp = NULL;
+	resource_s *info = NULL;
+	unsigned long long start = 0;
 
-	g_sensor_h = NULL;
-	g_pin_num = -1;
+	retvm_if(pin_num < 0 || pin_num >= PIN_MAX, -1, "Invalid pin number : %d", pin_num);
+	info = resource_get_info(pin_num);
+
+	if (info->opened) {
+		retvm_if(info->driver != &resource_sw_sensor_driver, -1, "GPIO[%d] is not a switch", pin_num);
+		return 0;
+	}
+
+	start = resource_metrics_now();
+	TRACE_BEGIN("gpio_open");
+	ret = peripheral_gpio_open(pin_num, &temp);
+	TRACE_END();
+	if (ret) {
+		resource_metrics_record(pin_num, RESOURCE_METRICS_OPEN, start, 1);
+		_E("peripheral_gpio_open failed.");
+		return -1;
+	}
+
+	TRACE_BEGIN("gpio_set_direction");
+	ret = peripheral_gpio_set_direction(temp, PERIPHERAL_GPIO_DIRECTION_IN);
+	TRACE_END();
+	resource_metrics_record(pin_num, RESOURCE_METRICS_OPEN, start, ret != 0);
+	if (ret) {
+		peripheral_gpio_close(temp);
+		_E("peripheral_gpio_set_direction failed.");
+		return -1;
+	}
+
+	info->sensor_h = temp;
+	resource_set_opened(pin_num, &resource_sw_sensor_driver);
+
+	return 0;
+}
+
+int resource_open_sw_sensor(int pin_num)
+{
+	return __open_sw_sensor(pin_num);
 }
 
 int resource_read_sw_sensor(int pin_num, uint32_t *out_value)
 {
 	int ret = PERIPHERAL_ERROR_NONE;
+	unsigned long long start = 0;
 
-	if (!g_sensor_h) {
-		peripheral_gpio_h temp = NULL;
+	ret = __open_sw_sensor(pin_num);
+	retv_if(ret != 0, -1);
 
-		ret = peripheral_gpio_open(pin_num, &temp);
-		retv_if(ret, -1);
+	start = resource_metrics_now();
+	TRACE_BEGIN("gpio_read");
+	ret = peripheral_gpio_read(resource_get_info(pin_num)->sensor_h, out_value);
+	TRACE_END();
+	resource_metrics_record(pin_num, RESOURCE_METRICS_READ, start, ret < 0);
+	retv_if(ret < 0, -1);
+
+	return 0;
+}
+
+int resource_read_sw_sensors(uint64_t pin_mask, uint64_t *out_mask)
+{
+	uint64_t pending = 0;
+	uint64_t levels = 0;
+	uint32_t value = 0;
+	int pin_num = 0;
+	int ret = PERIPHERAL_ERROR_NONE;
+	unsigned long long start = 0;
 
-		ret = peripheral_gpio_set_direction(temp, PERIPHERAL_GPIO_DIRECTION_IN);
-		if (ret) {
-			peripheral_gpio_close(temp);
-			_E("peripheral_gpio_set_direction failed.");
-			return -1;
-		}
+	retv_if(!out_mask, -1);
+	retvm_if(pin_mask >> PIN_MAX, -1, "Invalid pin mask : 0x%llx", (unsigned long long) pin_mask);
 
-		g_sensor_h = temp;
-		g_pin_num = pin_num;
+	/* Open everything first so the reads below sit as close together as possible */
+	for (pending = pin_mask; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		ret = __open_sw_sensor(pin_num);
+		retv_if(ret != 0, -1);
 	}
 
-	if (g_pin_num != pin_num) {
-		_E("Invalid pin number.");
+	for (pending = pin_mask; pending; pending &= pending - 1) {
+		pin_num = __builtin_ctzll(pending);
+		start = resource_metrics_now();
+		TRACE_BEGIN("gpio_read");
+		ret = peripheral_gpio_read(resource_get_info(pin_num)->sensor_h, &value);
+		TRACE_END();
+		resource_metrics_record(pin_num, RESOURCE_METRICS_READ, start, ret < 0);
+		retvm_if(ret < 0, -1, "GPIO[%d] read failed", pin_num);
+		if (value)
+			levels |= 1ULL << pin_num;
+	}
+
+	*out_mask = levels;
+
+	return 0;
+}
+
+static int __level_read_work(void *data)
+{
+	sw_level_read_s *read = data;
+	int ret = PERIPHERAL_ERROR_NONE;
+	unsigned long long start = resource_metrics_now();
+
+	TRACE_BEGIN("gpio_read");
+	ret = peripheral_gpio_read(read->gpio, &read->value);
+	TRACE_END();
+	resource_metrics_record(read->pin_num, RESOURCE_METRICS_READ, start, ret < 0);
+
+	return ret < 0 ? -1 : 0;
+}
+
+/* Hands the level to the callback the switch has now, the one that asked may be gone */
+static void __level_read_done(int result, void *data)
+{
+	sw_level_read_s *read = data;
+	resource_s *info = resource_get_info(read->pin_num);
+	resource_read_s *read_info = info->resource_read_info;
+	uint32_t value = read->value;
+
+	free(read);
+
+	retm_if(result < 0, "peripheral_gpio_read failed.");
+	if (!info->opened || info->driver != &resource_sw_sensor_driver || !read_info || !read_info->cb)
+		return;
+
+	read_info->cb((double) value, read_info->data);
+}
+
+/* Reads on the I/O worker while it runs, so edges make no blocking call on the main loop */
+static int __level_read(int pin_num)
+{
+	sw_level_read_s *read = calloc(1, sizeof(sw_level_read_s));
+
+	retv_if(!read, -1);
+	read->pin_num = pin_num;
+	read->gpio = resource_get_info(pin_num)->sensor_h;
+
+	if (!resource_io_worker_running()) {
+		__level_read_done(__level_read_work(read), read);
+		return 0;
+	}
+
+	if (resource_io_submit(__level_read_work, __level_read_done, read)) {
+		free(read);
 		return -1;
 	}
 
-	ret = peripheral_gpio_read(g_sensor_h, out_value);
-	retv_if(ret < 0, -1);
+	return 0;
+}
+
+/* Runs after the completions that freed the queue slots were handed back */
+static Eina_Bool __level_pending_retry(void *data)
+{
+	int pin_num = 0;
+
+	while (g_pending.pin_mask) {
+		pin_num = __builtin_ctzll(g_pending.pin_mask);
+		if (__level_read(pin_num))
+			return ECORE_CALLBACK_RENEW;
+		g_pending.pin_mask &= ~(1ULL << pin_num);
+	}
+
+	g_pending.retry = NULL;
+
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void __level_request(int pin_num)
+{
+	/* A waiting read gets the level as it is by then, later edges need no read of their own */
+	if (g_pending.pin_mask & (1ULL << pin_num))
+		return;
+
+	if (__level_read(pin_num) == 0)
+		return;
+
+	g_pending.pin_mask |= 1ULL << pin_num;
+	if (!g_pending.retry) {
+		g_pending.retry = ecore_idle_enterer_add(__level_pending_retry, NULL);
+		if (!g_pending.retry)
+			_E("Failed to add the switch retry, the read waits for the next edge");
+	}
+}
+
+static void __sw_sensor_interrupted_cb(peripheral_gpio_h gpio, peripheral_error_e error, void *user_data)
+{
+	resource_read_s *read_info = user_data;
+
+	ret_if(!read_info);
+	ret_if(!read_info->cb);
+
+	if (error != PERIPHERAL_ERROR_NONE) {
+		_E("interrupt error : %s", get_error_message(error));
+		return;
+	}
+
+	__level_request(read_info->pin_num);
+}
+
+int resource_set_sw_sensor_interrupted_cb(int pin_num, resource_read_cb cb, void *data)
+{
+	int ret = PERIPHERAL_ERROR_NONE;
+	resource_s *info = NULL;
+	resource_read_s *read_info = NULL;
+
+	retv_if(!cb, -1);
+
+	ret = __open_sw_sensor(pin_num);
+	retv_if(ret != 0, -1);
+
+	resource_unset_sw_sensor_interrupted_cb(pin_num);
+	info = resource_get_info(pin_num);
+
+	read_info = calloc(1, sizeof(resource_read_s));
+	retv_if(!read_info, -1);
+
+	read_info->cb = cb;
+	read_info->data = data;
+	read_info->pin_num = pin_num;
+
+	ret = peripheral_gpio_set_edge_mode(info->sensor_h, PERIPHERAL_GPIO_EDGE_BOTH);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("peripheral_gpio_set_edge_mode failed : %s", get_error_message(ret));
+		free(read_info);
+		return -1;
+	}
+
+	ret = peripheral_gpio_set_interrupted_cb(info->sensor_h, __sw_sensor_interrupted_cb, read_info);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		_E("peripheral_gpio_set_interrupted_cb failed : %s", get_error_message(ret));
+		peripheral_gpio_set_edge_mode(info->sensor_h, PERIPHERAL_GPIO_EDGE_NONE);
+		free(read_info);
+		return -1;
+	}
+
+	info->resource_read_info = read_info;
+
+	return 0;
+}
+
+int resource_unset_sw_sensor_interrupted_cb(int pin_num)
+{
+	resource_s *info = NULL;
+
+	retv_if(pin_num < 0 || pin_num >= PIN_MAX, -1);
+	info = resource_get_info(pin_num);
+	retv_if(!info->opened, -1);
+
+	if (!info->resource_read_info)
+		return 0;
+
+	peripheral_gpio_unset_interrupted_cb(info->sensor_h);
+	peripheral_gpio_set_edge_mode(info->sensor_h, PERIPHERAL_GPIO_EDGE_NONE);
+
+	free(info->resource_read_info);
+	info->resource_read_info = NULL;
+	g_pending.pin_mask &= ~(1ULL << pin_num);
+
+	return 0;
+}
+
+int resource_refresh_sw_sensor(int pin_num)
+{
+	resource_s *info = NULL;
+
+	retv_if(pin_num < 0 || pin_num >= PIN_MAX, -1);
+	info = resource_get_info(pin_num);
+	retv_if(!info->opened || info->driver != &resource_sw_sensor_driver, -1);
+	retv_if(!info->resource_read_info, -1);
+
+	__level_request(pin_num);
 
 	return 0;
 }
@@ -14,20 +14,67 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <time.h>
 #include "log.h"
 #include "sensor-data.h"
 
+/*
+ * Scalars are published with atomics so readers never take a lock.
+ * A double is stored as its 64-bit pattern, through a seqlock on targets
+ * where 64-bit atomics are not lock-free.
+ *
+ * Strings live in a few preallocated snapshot slots guarded by the mutex.
+ * An update fills a slot nobody holds and makes it current, so updates
+ * only allocate to grow the slots, and a snapshot taken with
+ * sensor_data_acquire_string() stays untouched until it is released.
+ * Grown out buffers stay with the data until it is freed, the pointers
+ * handed out earlier still point into them.
+ */
+#define SENSOR_DATA_STR_SLOTS 4
+#define SENSOR_DATA_STR_CAPACITY_DEFAULT 64
+#ifndef SENSOR_DATA_ATOMIC_DOUBLE
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define SENSOR_DATA_ATOMIC_DOUBLE 1
+#else
+#define SENSOR_DATA_ATOMIC_DOUBLE 0
+#endif
+#endif
+
+typedef struct __sensor_data_str_buf_s sensor_data_str_buf_s;
+struct __sensor_data_str_buf_s {
+	sensor_data_str_buf_s *older; /* The buffer this one replaced */
+	unsigned int capacity;
+	unsigned int refcount[SENSOR_DATA_STR_SLOTS];
+	char slots[]; /* SENSOR_DATA_STR_SLOTS slots of capacity + 1 bytes */
+};
+
 struct __sensor_data_s {
 	sensor_data_type_e type;
 	union {
 		int int_val;
 		unsigned int uint_val;
 		bool b_val;
-		double d_val;
-		char *str_val;
+		uint64_t d_bits;
+		uint32_t d_words[2];
 	} value;
+	unsigned int seq;
+	unsigned int version;
 	pthread_mutex_t mutex;
+	struct {
+		sensor_data_str_buf_s *buf;
+		unsigned int current;
+	} str;
+	struct {
+		/* Structure of arrays sharing one allocation, newest sample at head - 1 */
+		double *timestamps;
+		double *values;
+		unsigned int capacity;
+		unsigned int head;
+		unsigned int count;
+	} history;
 };
 
 sensor_data *sensor_data_new(sensor_data_type_e type)
@@ -41,6 +88,11 @@ sensor_data *sensor_data_new(sensor_data_type_e type)
 	data->type = type;
 	pthread_mutex_init(&data->mutex, NULL);
 
+	if (type == SENSOR_DATA_TYPE_STR && sensor_data_string_reserve(data, SENSOR_DATA_STR_CAPACITY_DEFAULT)) {
+		sensor_data_free(data);
+		return NULL;
+	}
+
 	return data;
 }
 
@@ -48,25 +100,58 @@ void sensor_data_free(sensor_data *data)
 {
 	ret_if(!data);
 
-	if (data->type == SENSOR_DATA_TYPE_STR) {
-		pthread_mutex_lock(&data->mutex);
-		free(data->value.str_val);
-		data->value.str_val = NULL;
-		pthread_mutex_unlock(&data->mutex);
-	}
 	pthread_mutex_destroy(&data->mutex);
 
+	while (data->str.buf) {
+		sensor_data_str_buf_s *older = data->str.buf->older;
+		free(data->str.buf);
+		data->str.buf = older;
+	}
+	free(data->history.timestamps);
 	free(data);
 }
 
+static inline void __sensor_data_changed(sensor_data *data)
+{
+	__atomic_add_fetch(&data->version, 1, __ATOMIC_RELEASE);
+}
+
+static double __sensor_data_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static inline void __sensor_data_record(sensor_data *data, double value)
+{
+	double now = 0.0;
+
+	/* The capacity only changes in sensor_data_history_enable(), before sampling starts */
+	if (!data->history.capacity)
+		return;
+
+	now = __sensor_data_now();
+
+	pthread_mutex_lock(&data->mutex);
+	data->history.timestamps[data->history.head] = now;
+	data->history.values[data->history.head] = value;
+	data->history.head = (data->history.head + 1) % data->history.capacity;
+	if (data->history.count < data->history.capacity)
+		data->history.count++;
+	pthread_mutex_unlock(&data->mutex);
+}
+
 int sensor_data_set_int(sensor_data *data, int value)
 {
 	retv_if(!data, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_INT, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	data->value.int_val = value;
-	pthread_mutex_unlock(&data->mutex);
+	if (__atomic_exchange_n(&data->value.int_val, value, __ATOMIC_RELEASE) != value)
+		__sensor_data_changed(data);
+
+	__sensor_data_record(data, (double) value);
 
 	return 0;
 }
@@ -76,9 +161,10 @@ int sensor_data_set_uint(sensor_data *data, unsigned int value)
 	retv_if(!data, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_UINT, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	data->value.uint_val = value;
-	pthread_mutex_unlock(&data->mutex);
+	if (__atomic_exchange_n(&data->value.uint_val, value, __ATOMIC_RELEASE) != value)
+		__sensor_data_changed(data);
+
+	__sensor_data_record(data, (double) value);
 
 	return 0;
 }
@@ -88,41 +174,139 @@ int sensor_data_set_bool(sensor_data *data, bool value)
 	retv_if(!data, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_BOOL, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	data->value.b_val = value;
-	pthread_mutex_unlock(&data->mutex);
+	if (__atomic_exchange_n(&data->value.b_val, value, __ATOMIC_RELEASE) != value)
+		__sensor_data_changed(data);
+
+	__sensor_data_record(data, (double) value);
 
 	return 0;
 }
 
 int sensor_data_set_double(sensor_data *data, double value)
 {
+	uint64_t bits = 0;
+	uint64_t old = 0;
+
 	retv_if(!data, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_DOUBLE, -1);
 
+	memcpy(&bits, &value, sizeof(bits));
+
+#if SENSOR_DATA_ATOMIC_DOUBLE
+	old = __atomic_exchange_n(&data->value.d_bits, bits, __ATOMIC_RELEASE);
+#else
+	{
+		unsigned int seq = __atomic_load_n(&data->seq, __ATOMIC_RELAXED);
+
+		/* Writers take the sequence from even to odd, which also keeps them apart */
+		while ((seq & 1) || !__atomic_compare_exchange_n(&data->seq, &seq, seq + 1, false,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			seq = __atomic_load_n(&data->seq, __ATOMIC_RELAXED);
+
+		old = (uint64_t) __atomic_load_n(&data->value.d_words[1], __ATOMIC_RELAXED) << 32
+			| __atomic_load_n(&data->value.d_words[0], __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		__atomic_store_n(&data->value.d_words[0], (uint32_t) bits, __ATOMIC_RELAXED);
+		__atomic_store_n(&data->value.d_words[1], (uint32_t) (bits >> 32), __ATOMIC_RELAXED);
+		__atomic_store_n(&data->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+#endif
+
+	if (old != bits)
+		__sensor_data_changed(data);
+
+	__sensor_data_record(data, value);
+
+	return 0;
+}
+
+static inline char *__sensor_data_str_slot(sensor_data_str_buf_s *buf, unsigned int slot)
+{
+	return buf->slots + slot * (buf->capacity + 1);
+}
+
+/* Called with the mutex held, the current value moves to the new buffer */
+static int __sensor_data_str_resize(sensor_data *data, unsigned int capacity)
+{
+	sensor_data_str_buf_s *buf = NULL;
+
+	buf = calloc(1, sizeof(sensor_data_str_buf_s) + SENSOR_DATA_STR_SLOTS * (capacity + 1));
+	retv_if(!buf, -1);
+
+	buf->capacity = capacity;
+	if (data->str.buf)
+		strncpy(buf->slots, __sensor_data_str_slot(data->str.buf, data->str.current), capacity);
+
+	buf->older = data->str.buf;
+	data->str.buf = buf;
+	data->str.current = 0;
+
+	return 0;
+}
+
+int sensor_data_string_reserve(sensor_data *data, unsigned int capacity)
+{
+	int ret = 0;
+
+	retv_if(!data, -1);
+	retv_if(data->type != SENSOR_DATA_TYPE_STR, -1);
+	retv_if(capacity == 0, -1);
+
 	pthread_mutex_lock(&data->mutex);
-	data->value.d_val = value;
+	if (!data->str.buf || data->str.buf->capacity != capacity)
+		ret = __sensor_data_str_resize(data, capacity);
 	pthread_mutex_unlock(&data->mutex);
 
-	return 0;
+	return ret;
 }
 
 int sensor_data_set_string(sensor_data *data, const char *value, unsigned int size)
 {
-	char *temp = NULL;
+	unsigned int len = 0;
+	unsigned int slot = 0;
+	char *dst = NULL;
+	int changed = 0;
+
 	retv_if(!data, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_STR, -1);
 	retv_if(!value, -1);
 	retv_if(size == 0, -1);
 
-	temp = strndup(value, size);
-	retv_if(!temp, -1);
+	len = strnlen(value, size);
 
 	pthread_mutex_lock(&data->mutex);
-	free(data->value.str_val);
-	data->value.str_val = temp;
+	if (len > data->str.buf->capacity) {
+		unsigned int capacity = data->str.buf->capacity * 2;
+
+		if (__sensor_data_str_resize(data, capacity > len ? capacity : len)) {
+			pthread_mutex_unlock(&data->mutex);
+			return -1;
+		}
+	}
+
+	if (strncmp(__sensor_data_str_slot(data->str.buf, data->str.current), value, len)
+			|| __sensor_data_str_slot(data->str.buf, data->str.current)[len] != '\0') {
+		for (slot = 0; slot < SENSOR_DATA_STR_SLOTS; slot++) {
+			if (slot != data->str.current && !data->str.buf->refcount[slot])
+				break;
+		}
+		if (slot == SENSOR_DATA_STR_SLOTS) {
+			pthread_mutex_unlock(&data->mutex);
+			_E("Every string snapshot is held");
+			return -1;
+		}
+
+		dst = __sensor_data_str_slot(data->str.buf, slot);
+		memcpy(dst, value, len);
+		dst[len] = '\0';
+		data->str.current = slot;
+		changed = 1;
+	}
 	pthread_mutex_unlock(&data->mutex);
 
+	if (changed)
+		__sensor_data_changed(data);
+
 	return 0;
 }
 
@@ -132,9 +316,7 @@ int sensor_data_get_int(sensor_data *data, int *value)
 	retv_if(!value, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_INT, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	*value = data->value.int_val;
-	pthread_mutex_unlock(&data->mutex);
+	*value = __atomic_load_n(&data->value.int_val, __ATOMIC_ACQUIRE);
 
 	return 0;
 }
@@ -145,9 +327,7 @@ int sensor_data_get_uint(sensor_data *data, unsigned int *value)
 	retv_if(!value, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_UINT, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	*value = data->value.uint_val;
-	pthread_mutex_unlock(&data->mutex);
+	*value = __atomic_load_n(&data->value.uint_val, __ATOMIC_ACQUIRE);
 
 	return 0;
 }
@@ -158,35 +338,190 @@ int sensor_data_get_bool(sensor_data *data, bool *value)
 	retv_if(!value, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_BOOL, -1);
 
-	pthread_mutex_lock(&data->mutex);
-	*value = data->value.b_val;
-	pthread_mutex_unlock(&data->mutex);
+	*value = __atomic_load_n(&data->value.b_val, __ATOMIC_ACQUIRE);
 
 	return 0;
 }
 
 int sensor_data_get_double(sensor_data *data, double *value)
 {
+	uint64_t bits = 0;
+
 	retv_if(!data, -1);
 	retv_if(!value, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_DOUBLE, -1);
 
+#if SENSOR_DATA_ATOMIC_DOUBLE
+	bits = __atomic_load_n(&data->value.d_bits, __ATOMIC_ACQUIRE);
+#else
+	{
+		unsigned int seq = 0;
+
+		/* Retry while a writer is inside or got in between */
+		do {
+			seq = __atomic_load_n(&data->seq, __ATOMIC_ACQUIRE);
+			bits = (uint64_t) __atomic_load_n(&data->value.d_words[1], __ATOMIC_RELAXED) << 32
+				| __atomic_load_n(&data->value.d_words[0], __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		} while ((seq & 1) || seq != __atomic_load_n(&data->seq, __ATOMIC_RELAXED));
+	}
+#endif
+
+	memcpy(value, &bits, sizeof(bits));
+
+	return 0;
+}
+
+int sensor_data_get_string(sensor_data *data, const char **value)
+{
+	retv_if(!data, -1);
+	retv_if(!value, -1);
+	retv_if(data->type != SENSOR_DATA_TYPE_STR, -1);
+
 	pthread_mutex_lock(&data->mutex);
-	*value = data->value.d_val;
+	*value = __sensor_data_str_slot(data->str.buf, data->str.current);
 	pthread_mutex_unlock(&data->mutex);
 
 	return 0;
 }
 
-int sensor_data_get_string(sensor_data *data, const char **value)
+int sensor_data_acquire_string(sensor_data *data, const char **value)
 {
 	retv_if(!data, -1);
 	retv_if(!value, -1);
 	retv_if(data->type != SENSOR_DATA_TYPE_STR, -1);
 
 	pthread_mutex_lock(&data->mutex);
-	*value = data->value.str_val;
+	data->str.buf->refcount[data->str.current]++;
+	*value = __sensor_data_str_slot(data->str.buf, data->str.current);
+	pthread_mutex_unlock(&data->mutex);
+
+	return 0;
+}
+
+int sensor_data_release_string(sensor_data *data, const char *value)
+{
+	sensor_data_str_buf_s *buf = NULL;
+	unsigned int slot = SENSOR_DATA_STR_SLOTS;
+
+	retv_if(!data, -1);
+	retv_if(!value, -1);
+	retv_if(data->type != SENSOR_DATA_TYPE_STR, -1);
+
+	pthread_mutex_lock(&data->mutex);
+	/* The snapshot may sit in a buffer the string has grown out of since */
+	for (buf = data->str.buf; buf; buf = buf->older) {
+		if (value >= buf->slots && value < __sensor_data_str_slot(buf, SENSOR_DATA_STR_SLOTS)) {
+			slot = (unsigned int) (value - buf->slots) / (buf->capacity + 1);
+			break;
+		}
+	}
+	if (!buf || !buf->refcount[slot]) {
+		pthread_mutex_unlock(&data->mutex);
+		_E("Not an acquired string snapshot");
+		return -1;
+	}
+	buf->refcount[slot]--;
+	pthread_mutex_unlock(&data->mutex);
+
+	return 0;
+}
+
+unsigned int sensor_data_get_version(sensor_data *data)
+{
+	retv_if(!data, 0);
+
+	return __atomic_load_n(&data->version, __ATOMIC_ACQUIRE);
+}
+
+int sensor_data_history_enable(sensor_data *data, unsigned int capacity)
+{
+	double *buf = NULL;
+
+	retv_if(!data, -1);
+	retv_if(data->type == SENSOR_DATA_TYPE_STR, -1);
+	retv_if(capacity == 0, -1);
+
+	buf = calloc(capacity * 2, sizeof(double));
+	retv_if(!buf, -1);
+
+	pthread_mutex_lock(&data->mutex);
+	free(data->history.timestamps);
+	data->history.timestamps = buf;
+	data->history.values = buf + capacity;
+	data->history.head = 0;
+	data->history.count = 0;
+	data->history.capacity = capacity;
 	pthread_mutex_unlock(&data->mutex);
 
 	return 0;
 }
+
+int sensor_data_history_window(sensor_data *data, double since, sensor_data_window_s *window)
+{
+	unsigned int i = 0;
+	unsigned int index = 0;
+	double sum = 0.0;
+
+	retv_if(!data, -1);
+	retv_if(!window, -1);
+	retv_if(!data->history.capacity, -1);
+
+	window->count = 0;
+	window->min = 0.0;
+	window->max = 0.0;
+	window->mean = 0.0;
+
+	pthread_mutex_lock(&data->mutex);
+	/* Walk back from the newest sample until one is older than the window */
+	for (i = 0; i < data->history.count; i++) {
+		double value = 0.0;
+
+		index = (data->history.head + data->history.capacity - 1 - i) % data->history.capacity;
+		if (data->history.timestamps[index] < since)
+			break;
+
+		value = data->history.values[index];
+		if (!window->count || value < window->min)
+			window->min = value;
+		if (!window->count || value > window->max)
+			window->max = value;
+		sum += value;
+		window->count++;
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	if (window->count)
+		window->mean = sum / window->count;
+
+	return 0;
+}
+
+int sensor_data_history_last(sensor_data *data, unsigned int n, double *timestamps, double *values, unsigned int *count)
+{
+	unsigned int i = 0;
+	unsigned int index = 0;
+
+	retv_if(!data, -1);
+	retv_if(!count, -1);
+	retv_if(!data->history.capacity, -1);
+
+	pthread_mutex_lock(&data->mutex);
+	if (n > data->history.count)
+		n = data->history.count;
+
+	/* Oldest of the n first, so the output reads in time order */
+	index = (data->history.head + data->history.capacity - n) % data->history.capacity;
+	for (i = 0; i < n; i++) {
+		if (timestamps)
+			timestamps[i] = data->history.timestamps[index];
+		if (values)
+			values[i] = data->history.values[index];
+		index = (index + 1) % data->history.capacity;
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	*count = n;
+
+	return 0;
+}
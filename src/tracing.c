@@ -0,0 +1,193 @@
+/*
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <service_app.h>
+
+#include "log.h"
+#include "tracing.h"
+
+#ifndef TRACING_TTRACE
+#if defined(__has_include)
+#if __has_include(<trace.h>)
+#define TRACING_TTRACE 1
+#endif
+#endif
+#endif
+
+#ifdef TRACING_TTRACE
+#include <trace.h>
+#endif
+
+#define TRACING_DEPTH_MAX 64 /* Bits in g_recorded, deeper spans are never recorded */
+
+int tracing_enabled = 0;
+__thread int tracing_depth = 0;
+/* Bit n is set while the span at depth n is recorded, so a toggle never mismatches begins and ends */
+static __thread unsigned long long g_recorded = 0;
+
+static struct {
+	char *path;
+	FILE *fp; /* Chrome trace file, every event is one stdio call so threads do not interleave */
+	int pid;
+} g_trace = { NULL, NULL, 0 };
+
+#ifndef TRACING_TTRACE
+static __thread int g_tid = 0;
+
+static double __now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int __get_tid(void)
+{
+	if (!g_tid)
+		g_tid = (int) syscall(SYS_gettid);
+
+	return g_tid;
+}
+
+static int __trace_file_open(void)
+{
+	FILE *fp = NULL;
+
+	if (g_trace.fp)
+		return 0;
+
+	retvm_if(!g_trace.path, -1, "No trace file path");
+	fp = fopen(g_trace.path, "w");
+	retvm_if(!fp, -1, "Cannot open the trace file %s", g_trace.path);
+
+	g_trace.pid = (int) getpid();
+	fputs("[\n", fp);
+	__atomic_store_n(&g_trace.fp, fp, __ATOMIC_RELEASE);
+
+	return 0;
+}
+#endif
+
+void tracing_begin(const char *name)
+{
+	int depth = tracing_depth++;
+
+	/* Begun while tracing is off, counted so its end does not close the enclosing span */
+	if (!__atomic_load_n(&tracing_enabled, __ATOMIC_RELAXED) || depth >= TRACING_DEPTH_MAX)
+		return;
+	g_recorded |= 1ULL << depth;
+
+#ifdef TRACING_TTRACE
+	trace_begin("%s", name);
+#else
+	FILE *fp = __atomic_load_n(&g_trace.fp, __ATOMIC_ACQUIRE);
+
+	if (fp)
+		fprintf(fp, "{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+				name, __now_usec(), g_trace.pid, __get_tid());
+#endif
+}
+
+void tracing_end(void)
+{
+	int depth = 0;
+
+	if (tracing_depth <= 0)
+		return;
+
+	depth = --tracing_depth;
+	if (depth >= TRACING_DEPTH_MAX || !(g_recorded & (1ULL << depth)))
+		return;
+	g_recorded &= ~(1ULL << depth);
+
+#ifdef TRACING_TTRACE
+	trace_end();
+#else
+	FILE *fp = __atomic_load_n(&g_trace.fp, __ATOMIC_ACQUIRE);
+
+	if (fp)
+		fprintf(fp, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+				__now_usec(), g_trace.pid, __get_tid());
+#endif
+}
+
+int tracing_set_enabled(int enabled)
+{
+	enabled = !!enabled;
+	if (enabled == __atomic_load_n(&tracing_enabled, __ATOMIC_RELAXED))
+		return 0;
+
+#ifndef TRACING_TTRACE
+	/* Stays open once tracing was on, spans still open on other threads write their ends */
+	if (enabled && __trace_file_open())
+		return -1;
+#endif
+
+	__atomic_store_n(&tracing_enabled, enabled, __ATOMIC_RELAXED);
+	_I("Tracing %s", enabled ? "on" : "off");
+
+	return 0;
+}
+
+int tracing_init(void)
+{
+	const char *env = NULL;
+	char *data_path = NULL;
+	char path[PATH_MAX];
+
+	free(g_trace.path);
+	g_trace.path = NULL;
+
+	if ((env = getenv("LEDSW_TRACE_FILE"))) {
+		g_trace.path = strdup(env);
+	} else if ((data_path = app_get_data_path())) {
+		/* The working directory of a service app is not writable */
+		snprintf(path, sizeof(path), "%s%s", data_path, TRACING_FILE_DEFAULT);
+		free(data_path);
+		g_trace.path = strdup(path);
+	}
+
+	env = getenv("LEDSW_TRACE");
+	if (env && atoi(env))
+		return tracing_set_enabled(1);
+
+	return 0;
+}
+
+void tracing_fini(void)
+{
+	FILE *fp = NULL;
+
+	tracing_set_enabled(0);
+
+	fp = __atomic_exchange_n(&g_trace.fp, NULL, __ATOMIC_ACQ_REL);
+	if (fp) {
+		/* The metadata event ends the array without a trailing comma */
+		fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ledsw\"}}\n]\n",
+				g_trace.pid);
+		fclose(fp);
+	}
+
+	free(g_trace.path);
+	g_trace.path = NULL;
+}